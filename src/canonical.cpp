@@ -0,0 +1,165 @@
+#include "canonical.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <string.h>
+
+namespace cbor {
+
+int compare_canonical(const uint8_t *a, size_t a_size, const uint8_t *b,
+                      size_t b_size) {
+  size_t size = a_size < b_size ? a_size : b_size;
+  int order = size == 0 ? 0 : memcmp(a, b, size);
+  if (order != 0) {
+    return order;
+  }
+  return a_size < b_size ? -1 : a_size > b_size;
+}
+
+namespace detail {
+
+struct canonical_encoder {
+  // A key's encoding within the key buffer of its map;
+  struct key {
+    size_t offset;
+    size_t size;
+    const DataItem *value;
+  };
+
+  // Buffers of the maps being written, one per level of nesting, which
+  // are kept to be reused by the next map at that level;
+  struct level {
+    std::vector<uint8_t> keys;
+    std::vector<key> order;
+  };
+
+  struct key_less {
+    const uint8_t *keys;
+
+    bool operator()(const key &a, const key &b) const {
+      return compare_canonical(keys + a.offset, a.size, keys + b.offset,
+                               b.size) < 0;
+    }
+  };
+
+  std::vector<uint8_t> *out;
+  // a deque, so that levels stay put while deeper ones are added;
+  std::deque<level> levels;
+  size_t depth;
+  bool duplicate_keys;
+
+  explicit canonical_encoder(std::vector<uint8_t> &out)
+      : out(&out), depth(0), duplicate_keys(false) {}
+
+  void head(int major, uint64_t value) {
+    uint8_t buffer[9];
+    out->insert(out->end(), buffer, write_head(buffer, major, value));
+  }
+
+  void encode_float(double value) {
+    uint8_t buffer[9];
+    // every NaN becomes the quiet NaN with no payload;
+    if (value != value) {
+      buffer[0] = major::Simple << 5 | 25;
+      store_be(buffer + 1, uint16_t(0x7e00));
+      out->insert(out->end(), buffer, buffer + 3);
+      return;
+    }
+    out->insert(out->end(), buffer, write_float(buffer, value));
+  }
+
+  // Keys are encoded once, into the level's buffer, and sorted as
+  // offsets into it;
+  void encode_map(const Map &entries) {
+    if (levels.size() == depth) {
+      levels.emplace_back();
+    }
+    level &l = levels[depth++];
+    l.keys.clear();
+    l.order.clear();
+    std::vector<uint8_t> *target = out;
+    out = &l.keys;
+    for (Map::const_iterator it = entries.begin(); it != entries.end();
+         ++it) {
+      size_t offset = l.keys.size();
+      encode(it->first);
+      key k = {offset, l.keys.size() - offset, &it->second};
+      l.order.push_back(k);
+    }
+    out = target;
+    key_less less = {l.keys.data()};
+    if (!std::is_sorted(l.order.begin(), l.order.end(), less)) {
+      std::sort(l.order.begin(), l.order.end(), less);
+    }
+    head(major::Map, entries.size());
+    for (size_t i = 0; i < l.order.size(); ++i) {
+      // distinct keys can meet once their NaNs are canonical;
+      if (i != 0 && !less(l.order[i - 1], l.order[i])) {
+        duplicate_keys = true;
+      }
+      const uint8_t *bytes = l.keys.data() + l.order[i].offset;
+      out->insert(out->end(), bytes, bytes + l.order[i].size);
+      encode(*l.order[i].value);
+    }
+    --depth;
+  }
+
+  void encode(const DataItem &item) {
+    switch (item.type_) {
+    case type_t::Binary:
+    case type_t::String: {
+      bytes_view bytes = item.as_bytes_view();
+      head(item.type_ == type_t::Binary ? major::ByteString
+                                        : major::TextString,
+           bytes.size());
+      out->insert(out->end(), bytes.begin(), bytes.end());
+      return;
+    }
+    case type_t::Array:
+      head(major::Array, item.array_->size());
+      for (size_t i = 0; i < item.array_->size(); ++i) {
+        encode((*item.array_)[i]);
+      }
+      return;
+    case type_t::Map:
+      encode_map(item.map_->entries);
+      return;
+    case type_t::Tagged:
+      head(major::Tag, item.tagged_->tag);
+      encode(item.tagged_->item);
+      return;
+    case type_t::Float:
+      encode_float(item.float_);
+      return;
+    default: {
+      uint8_t buffer[9];
+      out->insert(out->end(), buffer, item.write_to(buffer));
+      return;
+    }
+    }
+  }
+};
+
+} // namespace detail
+
+bool encode_canonical(const DataItem &item, std::vector<uint8_t> &out) {
+  size_t size = out.size();
+  detail::canonical_encoder encoder(out);
+  encoder.encode(item);
+  if (encoder.duplicate_keys) {
+    out.resize(size);
+    return false;
+  }
+  return true;
+}
+
+std::vector<uint8_t> encode_canonical(const DataItem &item) {
+  std::vector<uint8_t> out;
+  if (!encode_canonical(item, out)) {
+    out.clear();
+  }
+  return out;
+}
+
+} // namespace cbor
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Append the deterministic encoding of `item` (RFC 8949 section
+ * 4.2.1) to `out`: map entries sorted by the bytes of their encoded keys,
+ * and heads and floats in their shortest form, down to half precision.
+ * NaN is written as 0xf97e00. Equal items give equal bytes however their
+ * maps were built or decoded, so the output can serve as a content
+ * address.
+ *
+ * write() and encode() keep maps in insertion order and NaN payloads.
+ * @return false, leaving `out` as it was, when a map has two keys with
+ * the same encoding, such as NaNs that differ only in their payload.
+ */
+bool encode_canonical(const DataItem &item, std::vector<uint8_t> &out);
+/**
+ * @brief encode_canonical() into a new vector, empty on failure.
+ */
+std::vector<uint8_t> encode_canonical(const DataItem &item);
+
+/**
+ * @brief Order of two deterministic encodings: bytewise lexicographic,
+ * which is how RFC 8949 sorts map keys.
+ * @return less than, equal to or greater than 0 as `a` sorts before, the
+ * same as or after `b`.
+ */
+int compare_canonical(const uint8_t *a, size_t a_size, const uint8_t *b,
+                      size_t b_size);
+
+/**
+ * @brief compare_canonical() as a strict weak order, for sorted containers
+ * and algorithms over encoded items.
+ */
+struct canonical_less {
+  bool operator()(bytes_view a, bytes_view b) const {
+    return compare_canonical(a.data(), a.size(), b.data(), b.size()) < 0;
+  }
+  bool operator()(const std::vector<uint8_t> &a,
+                  const std::vector<uint8_t> &b) const {
+    return compare_canonical(a.data(), a.size(), b.data(), b.size()) < 0;
+  }
+};
+
+} // namespace cbor
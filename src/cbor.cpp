@@ -1,43 +1,40 @@
 #include "cbor.hpp"
+#include "detail.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <sstream>
+#include <stdexcept>
 
 namespace cbor {
 
-namespace major {
-const int Unsigned = 0;
-const int Negative = 1;
-const int ByteString = 2;
-const int TextString = 3;
-const int Array = 4;
-const int Map = 5;
-const int Tag = 6;
-const int Simple = 7; // float and simple;
-} // namespace major
-
-DataItem decode(const std::vector<uint8_t> &in) {
-  std::istringstream iss(std::string(in.begin(), in.end()));
+DataItem decode(const uint8_t *data, size_t size,
+                const decode_options &options) {
   DataItem item;
-  if (item.read(iss) && iss.peek() == EOF) {
+  if (size != 0 && item.read(data, size, options) == size) {
     return item;
   }
   return DataItem();
 }
 
+DataItem decode(const std::vector<uint8_t> &in) {
+  return decode(in.data(), in.size());
+}
+
 std::vector<uint8_t> encode(const DataItem &in) {
-  std::ostringstream oss;
-  in.write(oss);
-  std::string buffer = oss.str();
-  return std::vector<uint8_t>(buffer.begin(), buffer.end());
+  std::vector<uint8_t> out;
+  in.write(out);
+  return out;
 }
 
+void encode(const DataItem &in, std::vector<uint8_t> &out) { in.write(out); }
+
 DataItem array(std::initializer_list<DataItem> items) {
   return DataItem(std::vector<DataItem>(items));
 }
 
 DataItem map(std::initializer_list<std::pair<DataItem, DataItem>> items) {
-  DataItem item = DataItem(std::map<DataItem, DataItem>());
+  DataItem item = DataItem(Map());
   for (auto it = items.begin(); it < items.end(); it++) {
     item[it->first] = it->second;
   }
@@ -90,6 +87,9 @@ bool operator!=(const iterator &a, const iterator &b) {
   return !(operator==(a, b));
 };
 
+static const std::vector<DataItem> empty_array;
+static const Map empty_map;
+
 DataItem::DataItem(std::nullptr_t)
     : type_(type_t::Simple), value_(simple::Null) {}
 
@@ -123,30 +123,76 @@ DataItem::DataItem(int64_t value)
 DataItem::DataItem(float value) : type_(type_t::Float), float_(value) {}
 DataItem::DataItem(double value) : type_(type_t::Float), float_(value) {}
 
-DataItem::DataItem(const std::vector<uint8_t> &value)
-    : type_(type_t::Binary), binary_(value) {}
+DataItem::DataItem(const std::vector<uint8_t> &value) : value_(0) {
+  set_bytes(type_t::Binary, reinterpret_cast<const char *>(value.data()),
+            value.size());
+}
 
-DataItem::DataItem(const std::string &value)
-    : type_(type_t::String), string_(value) {}
+DataItem::DataItem(const std::string &value) : value_(0) {
+  set_bytes(type_t::String, value.data(), value.size());
+}
 
-DataItem::DataItem(const char *value) : type_(type_t::String), string_(value) {}
+DataItem::DataItem(const char *value) : value_(0) {
+  set_bytes(type_t::String, value, strlen(value));
+}
 
 DataItem::DataItem(const std::vector<DataItem> &value)
-    : type_(type_t::Array), array_(value) {}
+    : type_(type_t::Array), array_(new std::vector<DataItem>(value)) {}
 
 DataItem::DataItem(const std::map<DataItem, DataItem> &value)
-    : type_(type_t::Map), map_(value) {}
+    : type_(type_t::Map), map_(new Table()) {
+  map_->entries.assign(value.begin(), value.end());
+}
+
+DataItem::DataItem(const Map &value) : type_(type_t::Map), map_(new Table()) {
+  map_->entries.reserve(value.size());
+  for (Map::const_iterator it = value.begin(); it != value.end(); ++it) {
+    map_->insert(DataItem(it->first), DataItem(it->second));
+  }
+}
 
 DataItem DataItem::tagged(unsigned long long tag, const DataItem &value) {
   DataItem result;
   result.type_ = type_t::Tagged;
-  result.value_ = tag;
-  result.array_ = std::vector<DataItem>(1, value);
+  result.tagged_ = new Tagged{tag, value};
+  return result;
+}
+DataItem DataItem::negative(uint64_t value) {
+  DataItem result;
+  result.type_ = type_t::Negative;
+  result.value_ = value;
   return result;
 }
 DataItem::DataItem(cbor::simple value)
     : type_(type_t::Simple), value_(value & 255) {}
 
+DataItem::DataItem(const DataItem &other) : value_(0) { copy_from(other); }
+
+DataItem::DataItem(DataItem &&other) noexcept : value_(0) {
+  move_from(other);
+}
+
+DataItem &DataItem::operator=(const DataItem &other) {
+  if (this != &other) {
+    DataItem copy(other);
+    release();
+    move_from(copy);
+  }
+  return *this;
+}
+
+DataItem &DataItem::operator=(DataItem &&other) noexcept {
+  if (this != &other) {
+    // `other` may live inside the payload about to be released;
+    DataItem tmp(std::move(other));
+    release();
+    move_from(tmp);
+  }
+  return *this;
+}
+
+DataItem::~DataItem() { release(); }
+
 bool DataItem::is_unsigned() const { return this->type_ == type_t::Unsigned; }
 bool DataItem::is_signed() const {
   return (this->type_ == type_t::Unsigned || this->type_ == type_t::Negative) &&
@@ -172,20 +218,32 @@ bool DataItem::is_undefined() const {
   return this->type_ == type_t::Simple && this->value_ == simple::Undefined;
 }
 bool DataItem::is_float() const { return this->type_ == type_t::Float; }
+bool DataItem::is_borrowed() const {
+  return (this->type_ == type_t::String || this->type_ == type_t::Binary) &&
+         this->storage_ == storage::Borrowed;
+}
 bool DataItem::is_number() const {
   return this->type_ == type_t::Unsigned || this->type_ == type_t::Negative ||
          this->type_ == type_t::Float;
 }
 
-DataItem &DataItem::at(size_t index) { return array_.at(index); }
+DataItem &DataItem::at(size_t index) {
+  // unlike operator[], at() never turns the item into an array;
+  if (type_ != type_t::Array) {
+    throw std::out_of_range("cbor::DataItem::at");
+  }
+  return make_array().at(index);
+}
 
-const DataItem &DataItem::at(size_t index) const { return array_.at(index); }
+const DataItem &DataItem::at(size_t index) const {
+  return (type_ == type_t::Array ? *array_ : empty_array).at(index);
+}
 
 cbor::type_t DataItem::type() const { return this->type_; }
 uint64_t DataItem::tag() const {
   switch (this->type_) {
   case type_t::Tagged:
-    return this->value_;
+    return this->tagged_->tag;
   default:
     return 0;
   }
@@ -193,20 +251,16 @@ uint64_t DataItem::tag() const {
 DataItem DataItem::child() const {
   switch (this->type_) {
   case type_t::Tagged:
-    return this->array_.front();
+    return this->tagged_->item;
   default:
     return DataItem();
   }
 }
 
-void DataItem::push_back(const DataItem &item) {
-  type_ = type_t::Array;
-  array_.push_back(item);
-}
+void DataItem::push_back(const DataItem &item) { make_array().push_back(item); }
 
 void DataItem::push_back(DataItem &&item) {
-  type_ = type_t::Array;
-  array_.push_back(item);
+  make_array().push_back(std::move(item));
 }
 
 // template< class... Args >
@@ -218,9 +272,9 @@ void DataItem::push_back(DataItem &&item) {
 bool DataItem::is_empty() const {
   switch (type_) {
   case type_t::Array:
-    return array_.empty();
+    return array_->empty();
   case type_t::Map:
-    return map_.empty();
+    return map_->entries.empty();
   // TODO tagged?
   case type_t::Simple:
     return this->value_ == simple::Null;
@@ -234,33 +288,43 @@ bool DataItem::empty() const { return is_empty(); }
 size_t DataItem::size() const {
   switch (type_) {
   case type_t::Array:
-    return array_.size();
+    return array_->size();
   // TODO tagged?
   case type_t::Map:
-    return map_.size();
+    return map_->entries.size();
   default:
     return 0; // TODO
   }
 }
 
 void DataItem::clear() {
-  array_.clear();
-  map_.clear();
+  hash_.store(0, std::memory_order_relaxed);
+  if (type_ == type_t::Array) {
+    array_->clear();
+  }
+  if (type_ == type_t::Map) {
+    map_->entries.clear();
+    map_->drop_index();
+  }
 }
 
 iterator DataItem::begin() const noexcept {
   iterator::detail detail;
   detail.type_ = type_;
-  detail.array_iterator_ = array_.begin();
-  detail.map_iterator_ = map_.begin();
+  detail.array_iterator_ =
+      (type_ == type_t::Array ? *array_ : empty_array).begin();
+  detail.map_iterator_ =
+      (type_ == type_t::Map ? map_->entries : empty_map).begin();
   return iterator(detail);
 }
 
 iterator DataItem::end() const noexcept {
   iterator::detail detail;
   detail.type_ = type_;
-  detail.array_iterator_ = array_.end();
-  detail.map_iterator_ = map_.end();
+  detail.array_iterator_ =
+      (type_ == type_t::Array ? *array_ : empty_array).end();
+  detail.map_iterator_ =
+      (type_ == type_t::Map ? map_->entries : empty_map).end();
   return iterator(detail);
 }
 
@@ -286,6 +350,142 @@ std::ostream &operator<<(std::ostream &os, const DataItem &item) {
 }
 
 /** ----------------- private -------------------- */
+void DataItem::release() {
+  switch (type_) {
+  case type_t::Binary:
+  case type_t::String:
+    if (storage_ == storage::Heap) {
+      delete bytes_;
+    }
+    break;
+  case type_t::Array:
+    delete array_;
+    break;
+  case type_t::Map:
+    delete map_;
+    break;
+  case type_t::Tagged:
+    delete tagged_;
+    break;
+  default:
+    break;
+  }
+  type_ = type_t::Simple;
+  storage_ = storage::Inline;
+  small_size_ = 0;
+  hash_.store(0, std::memory_order_relaxed);
+  value_ = simple::Undefined;
+}
+
+void DataItem::copy_from(const DataItem &other) {
+  switch (other.type_) {
+  case type_t::Binary:
+  case type_t::String:
+    if (other.storage_ == storage::Borrowed) {
+      storage_ = storage::Borrowed;
+      view_ = other.view_;
+    } else {
+      set_bytes(other.type_, other.bytes_data(), other.bytes_size());
+    }
+    break;
+  case type_t::Array:
+    array_ = new std::vector<DataItem>(*other.array_);
+    break;
+  case type_t::Map:
+    map_ = new Table(*other.map_);
+    break;
+  case type_t::Tagged:
+    tagged_ = new Tagged(*other.tagged_);
+    break;
+  default:
+    value_ = other.value_;
+    break;
+  }
+  type_ = other.type_;
+  output_mode_ = other.output_mode_;
+  hash_.store(0, std::memory_order_relaxed);
+}
+
+// Takes over the payload of `other`, which must not own anything that this
+// item still refers to, and leaves it undefined.
+void DataItem::move_from(DataItem &other) {
+  type_ = other.type_;
+  output_mode_ = other.output_mode_;
+  storage_ = other.storage_;
+  small_size_ = other.small_size_;
+  hash_.store(other.hash_.load(std::memory_order_relaxed),
+              std::memory_order_relaxed);
+  memcpy(small_, other.small_, small_capacity);
+  other.type_ = type_t::Simple;
+  other.storage_ = storage::Inline;
+  other.small_size_ = 0;
+  other.hash_.store(0, std::memory_order_relaxed);
+  other.value_ = simple::Undefined;
+}
+
+// Replaces the payload with a copy of [data, data + size), stored inline when
+// it fits. Callers release any previous payload first.
+void DataItem::set_bytes(type_t type, const char *data, size_t size) {
+  type_ = type;
+  hash_.store(0, std::memory_order_relaxed);
+  if (size <= small_capacity) {
+    storage_ = storage::Inline;
+    small_size_ = uint8_t(size);
+    if (size != 0) {
+      memcpy(small_, data, size);
+    }
+  } else {
+    storage_ = storage::Heap;
+    small_size_ = 0;
+    bytes_ = new std::string(data, size);
+  }
+}
+
+const char *DataItem::bytes_data() const {
+  switch (storage_) {
+  case storage::Heap:
+    return bytes_->data();
+  case storage::Borrowed:
+    return view_.data;
+  default:
+    return small_;
+  }
+}
+
+size_t DataItem::bytes_size() const {
+  switch (storage_) {
+  case storage::Heap:
+    return bytes_->size();
+  case storage::Borrowed:
+    return view_.size;
+  default:
+    return small_size_;
+  }
+}
+
+// Mutable access to the payload, which may change what hash() returns;
+std::vector<DataItem> &DataItem::make_array() {
+  hash_.store(0, std::memory_order_relaxed);
+  if (type_ != type_t::Array) {
+    std::vector<DataItem> *array = new std::vector<DataItem>();
+    release();
+    type_ = type_t::Array;
+    array_ = array;
+  }
+  return *array_;
+}
+
+DataItem::Table &DataItem::make_map() {
+  hash_.store(0, std::memory_order_relaxed);
+  if (type_ != type_t::Map) {
+    Table *map = new Table();
+    release();
+    type_ = type_t::Map;
+    map_ = map;
+  }
+  return *map_;
+}
+
 uint64_t DataItem::to_unsigned() const {
   switch (this->type_) {
   case type_t::Unsigned:
@@ -293,7 +493,7 @@ uint64_t DataItem::to_unsigned() const {
   case type_t::Negative:
     return ~this->value_;
   case type_t::Tagged:
-    return this->array_.front().to_unsigned();
+    return this->tagged_->item.to_unsigned();
   case type_t::Float:
     return this->float_;
   default:
@@ -307,7 +507,7 @@ int64_t DataItem::to_signed() const {
   case type_t::Negative:
     return -1 - int64_t(this->value_);
   case type_t::Tagged:
-    return this->array_.front().to_signed();
+    return this->tagged_->item.to_signed();
   case type_t::Float:
     return this->float_;
   default:
@@ -316,10 +516,12 @@ int64_t DataItem::to_signed() const {
 }
 std::vector<uint8_t> DataItem::to_binary() const {
   switch (this->type_) {
-  case type_t::Binary:
-    return this->binary_;
+  case type_t::Binary: {
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes_data());
+    return std::vector<uint8_t>(data, data + bytes_size());
+  }
   case type_t::Tagged:
-    return this->array_.front().to_binary();
+    return this->tagged_->item.to_binary();
   default:
     return std::vector<uint8_t>();
   }
@@ -327,9 +529,9 @@ std::vector<uint8_t> DataItem::to_binary() const {
 std::string DataItem::to_string() const {
   switch (this->type_) {
   case type_t::String:
-    return this->string_;
+    return std::string(bytes_data(), bytes_size());
   case type_t::Tagged:
-    return this->array_.front().to_string();
+    return this->tagged_->item.to_string();
   default:
     return std::string();
   }
@@ -337,9 +539,9 @@ std::string DataItem::to_string() const {
 std::vector<DataItem> DataItem::to_array() const {
   switch (this->type_) {
   case type_t::Array:
-    return this->array_;
+    return *this->array_;
   case type_t::Tagged:
-    return this->array_.front().to_array();
+    return this->tagged_->item.to_array();
   default:
     return std::vector<DataItem>();
   }
@@ -347,9 +549,10 @@ std::vector<DataItem> DataItem::to_array() const {
 std::map<DataItem, DataItem> DataItem::to_map() const {
   switch (this->type_) {
   case type_t::Map:
-    return this->map_;
+    return std::map<DataItem, DataItem>(this->map_->entries.begin(),
+                                        this->map_->entries.end());
   case type_t::Tagged:
-    return this->array_.front().to_map();
+    return this->tagged_->item.to_map();
   default:
     return std::map<DataItem, DataItem>();
   }
@@ -357,7 +560,7 @@ std::map<DataItem, DataItem> DataItem::to_map() const {
 simple DataItem::to_simple() const {
   switch (this->type_) {
   case type_t::Tagged:
-    return this->array_.front().to_simple();
+    return this->tagged_->item.to_simple();
   case type_t::Simple:
     return simple(this->value_);
   default:
@@ -370,10 +573,11 @@ double DataItem::to_float() const {
   case type_t::Unsigned:
     return double(this->value_);
   case type_t::Negative:
-    return ldexp(-1 - int64_t(this->value_ >> 32), 32) +
-           (-1 - int64_t(this->value_ << 32 >> 32));
+    // -1 - value, from halves that convert exactly;
+    return -ldexp(double(this->value_ >> 32), 32) -
+           (double(this->value_ & 0xffffffffu) + 1);
   case type_t::Tagged:
-    return this->array_.front().to_float();
+    return this->tagged_->item.to_float();
   case type_t::Float:
     return this->float_;
   default:
@@ -384,7 +588,7 @@ double DataItem::to_float() const {
 DataItem::operator bool() const {
   switch (this->type_) {
   case type_t::Tagged:
-    return (bool)this->array_.front();
+    return (bool)this->tagged_->item;
   case type_t::Simple:
     return this->value_ == simple::True;
   default:
@@ -410,29 +614,64 @@ DataItem::operator std::map<DataItem, DataItem>() const {
 }
 DataItem::operator cbor::simple() const { return this->to_simple(); }
 
+string_view DataItem::as_string_view() const {
+  if (type_ != type_t::String && type_ != type_t::Binary) {
+    return string_view();
+  }
+  return string_view(bytes_data(), bytes_size());
+}
+
+bytes_view DataItem::as_bytes_view() const {
+  if (type_ != type_t::String && type_ != type_t::Binary) {
+    return bytes_view();
+  }
+  return bytes_view(reinterpret_cast<const uint8_t *>(bytes_data()),
+                    bytes_size());
+}
+
 DataItem &DataItem::operator[](const DataItem &key) {
-  type_ = type_t::Map; // TODO type is null?
-  return map_[key];
+  Table &table = make_map(); // TODO type is null?
+  size_t position = table.find(key);
+  if (position == table.entries.size()) {
+    position = table.append(DataItem(key), DataItem());
+  }
+  return table.entries[position].second;
 }
 
 DataItem &DataItem::operator[](const DataItem &&key) {
-  type_ = type_t::Map;
-  return map_[key];
+  return (*this)[static_cast<const DataItem &>(key)];
 }
 
 DataItem &DataItem::operator[](const char *key) {
-  type_ = type_t::Map;
-  return map_[key];
+  return (*this)[DataItem(key)];
+}
+
+const DataItem *DataItem::find(const DataItem &key) const {
+  if (type_ != type_t::Map) {
+    return nullptr;
+  }
+  size_t position = map_->find(key);
+  return position == map_->entries.size() ? nullptr
+                                          : &map_->entries[position].second;
 }
 
 void DataItem::operator=(const std::string &str) {
-  this->string_ = str;
-  this->type_ = type_t::String;
+  release();
+  set_bytes(type_t::String, str.data(), str.size());
 }
 
 void DataItem::operator=(const char *str) {
-  this->string_ = str;
-  this->type_ = type_t::String;
+  release();
+  set_bytes(type_t::String, str, strlen(str));
+}
+
+static int compare_bytes(const char *a, size_t a_size, const char *b,
+                         size_t b_size) {
+  int result = memcmp(a, b, a_size < b_size ? a_size : b_size);
+  if (result != 0) {
+    return result;
+  }
+  return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
 }
 
 bool DataItem::operator<(const DataItem &other) const {
@@ -444,21 +683,21 @@ bool DataItem::operator<(const DataItem &other) const {
   }
   switch (this->type_) {
   case type_t::Binary:
-    return this->binary_ < other.binary_;
   case type_t::String:
-    return this->string_ < other.string_;
+    return compare_bytes(bytes_data(), bytes_size(), other.bytes_data(),
+                         other.bytes_size()) < 0;
   case type_t::Array:
-    return this->array_ < other.array_;
+    return *this->array_ < *other.array_;
   case type_t::Map:
-    return this->map_ < other.map_;
+    return this->map_->less(*other.map_);
   case type_t::Tagged:
-    if (this->value_ < other.value_) {
+    if (this->tagged_->tag < other.tagged_->tag) {
       return true;
     }
-    if (this->value_ > other.value_) {
+    if (this->tagged_->tag > other.tagged_->tag) {
       return false;
     }
-    return this->array_.front() < other.array_.front();
+    return this->tagged_->item < other.tagged_->item;
   default:
     return this->value_ < other.value_;
   }
@@ -469,18 +708,18 @@ bool DataItem::operator==(const DataItem &other) const {
   }
   switch (this->type_) {
   case type_t::Binary:
-    return this->binary_ == other.binary_;
   case type_t::String:
-    return this->string_ == other.string_;
+    return bytes_size() == other.bytes_size() &&
+           memcmp(bytes_data(), other.bytes_data(), bytes_size()) == 0;
   case type_t::Array:
-    return this->array_ == other.array_;
+    return *this->array_ == *other.array_;
   case type_t::Map:
-    return this->map_ == other.map_;
+    return this->map_->equals(*other.map_);
   case type_t::Tagged:
-    if (this->value_ != other.value_) {
+    if (this->tagged_->tag != other.tagged_->tag) {
       return false;
     }
-    return this->array_ == other.array_;
+    return this->tagged_->item == other.tagged_->item;
   default:
     return this->value_ == other.value_;
   }
@@ -489,332 +728,765 @@ bool DataItem::operator!=(const DataItem &other) const {
   return !(*this == other);
 }
 
-/* ----------------------- decoder ----------------------- */
-void read_uint(std::istream &in, int &major, int &minor, uint64_t &value) {
-  major = (in.peek() >> 5) & 7;
-  minor = in.get() & 31;
-  value = 0;
-  switch (minor) {
-  case 27:
-    value |= (uint64_t)in.get() << 56;
-    value |= (uint64_t)in.get() << 48;
-    value |= (uint64_t)in.get() << 40;
-    value |= (uint64_t)in.get() << 32;
-  case 26:
-    value |= in.get() << 24;
-    value |= in.get() << 16;
-  case 25:
-    value |= in.get() << 8;
-  case 24:
-    value |= in.get();
+/* ----------------------- hashing ----------------------- */
+static const uint64_t hash_prime1 = 0x9e3779b185ebca87ULL;
+static const uint64_t hash_prime2 = 0xc2b2ae3d27d4eb4fULL;
+
+static inline uint64_t hash_round(uint64_t h, uint64_t word) {
+  h += word * hash_prime2;
+  h = (h << 31) | (h >> 33);
+  return h * hash_prime1;
+}
+
+// Final avalanche of MurmurHash3, folded to the 32 bits that are cached;
+static inline uint32_t hash_finish(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  uint32_t folded = uint32_t(h ^ (h >> 32));
+  // 0 marks a hash that is not computed yet;
+  return folded != 0 ? folded : 1;
+}
+
+static uint64_t hash_bytes(uint64_t h, const char *data, size_t size) {
+  h = hash_round(h, size);
+  for (; size >= 8; data += 8, size -= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    h = hash_round(h, word);
+  }
+  if (size != 0) {
+    uint64_t word = 0;
+    memcpy(&word, data, size);
+    h = hash_round(h, word);
+  }
+  return h;
+}
+
+size_t DataItem::hash() const {
+  switch (type_) {
+  case type_t::Binary:
+  case type_t::String: {
+    // strings change only through set_bytes(), which resets the cache;
+    uint32_t hash = hash_.load(std::memory_order_relaxed);
+    if (hash == 0) {
+      hash = compute_hash();
+      hash_.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+  }
+  case type_t::Array:
+  case type_t::Map:
+  case type_t::Tagged:
+    // elements can change through references the container does not see,
+    // so containers hash their current content every time;
+    return compute_hash();
+  default:
+    // floats compare by their bits, which value_ holds;
+    return hash_finish(hash_round(uint64_t(type_), value_));
+  }
+}
+
+uint32_t DataItem::compute_hash() const {
+  uint64_t h = uint64_t(type_);
+  switch (type_) {
+  case type_t::Binary:
+  case type_t::String:
+    h = hash_bytes(h, bytes_data(), bytes_size());
+    break;
+  case type_t::Array:
+    h = hash_round(h, array_->size());
+    for (std::vector<DataItem>::const_iterator it = array_->begin();
+         it != array_->end(); ++it) {
+      h = hash_round(h, it->hash());
+    }
+    break;
+  case type_t::Map: {
+    // entries are summed so that their order does not matter;
+    uint64_t sum = 0;
+    for (Map::const_iterator it = map_->entries.begin();
+         it != map_->entries.end(); ++it) {
+      sum += hash_round(it->first.hash(), it->second.hash());
+    }
+    h = hash_round(hash_round(h, map_->entries.size()), sum);
+    break;
+  }
+  case type_t::Tagged:
+    h = hash_round(hash_round(h, tagged_->tag), tagged_->item.hash());
     break;
   default:
-    value = minor;
+    h = hash_round(h, value_);
     break;
   }
+  return hash_finish(h);
 }
 
-/* ----------------------- encoder ----------------------- */
-void write_uint8(std::ostream &out, int major, uint64_t value) {
-  if (value < 24) {
-    out.put(major << 5 | value); // simple;
-  } else {
-    out.put(major << 5 | 24);
-    out.put(value);
-  }
-}
-void write_uint16(std::ostream &out, int major, uint64_t value) {
-  out.put(major << 5 | 25);
-  out.put(value >> 8);
-  out.put(value);
-}
-void write_uint32(std::ostream &out, int major, uint64_t value) {
-  out.put(major << 5 | 26);
-  out.put(value >> 24);
-  out.put(value >> 16);
-  out.put(value >> 8);
-  out.put(value);
-}
-void write_uint64(std::ostream &out, int major, uint64_t value) {
-  out.put(major << 5 | 27);
-  out.put(value >> 56);
-  out.put(value >> 48);
-  out.put(value >> 40);
-  out.put(value >> 32);
-  out.put(value >> 24);
-  out.put(value >> 16);
-  out.put(value >> 8);
-  out.put(value);
-}
-void write_uint(std::ostream &out, int major, uint64_t value) {
-  if ((value >> 8) == 0) {
-    write_uint8(out, major, value);
-  } else if ((value >> 16) == 0) {
-    write_uint16(out, major, value);
-  } else if (value >> 32 == 0) {
-    write_uint32(out, major, value);
-  } else {
-    write_uint64(out, major, value);
+namespace detail {
+
+map_index::map_index(const Map &entries) : count(0) {
+  size_t capacity = 16;
+  while (capacity < entries.size() * 2) {
+    capacity *= 2;
+  }
+  slot empty = {0, 0};
+  slots.assign(capacity, empty);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    slot s = {uint32_t(entries[i].first.hash()), uint32_t(i + 1)};
+    place(s);
+  }
+  count = entries.size();
+}
+
+size_t map_index::find(const Map &entries, const DataItem &key,
+                       uint32_t hash) const {
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const slot &s = slots[i];
+    if (s.position == 0) {
+      return entries.size();
+    }
+    if (s.hash == hash && entries[s.position - 1].first == key) {
+      return s.position - 1;
+    }
+  }
+}
+
+void map_index::insert(size_t position, uint32_t hash) {
+  if ((count + 1) * 2 > slots.size()) {
+    std::vector<slot> old(slots.size() * 2, slot{0, 0});
+    old.swap(slots);
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i].position != 0) {
+        place(old[i]);
+      }
+    }
+  }
+  slot s = {hash, uint32_t(position + 1)};
+  place(s);
+  ++count;
+}
+
+void map_index::place(const slot &s) {
+  size_t mask = slots.size() - 1;
+  size_t i = s.hash & mask;
+  while (slots[i].position != 0) {
+    i = (i + 1) & mask;
+  }
+  slots[i] = s;
+}
+
+} // namespace detail
+
+/* ----------------------- maps ----------------------- */
+size_t DataItem::Table::find(const DataItem &key) const {
+  if (entries.size() < detail::index_threshold) {
+    size_t i = 0;
+    while (i < entries.size() && !(entries[i].first == key)) {
+      ++i;
+    }
+    return i;
+  }
+  return indexed().find(entries, key, uint32_t(key.hash()));
+}
+
+size_t DataItem::Table::append(DataItem &&key, DataItem &&value) {
+  entries.emplace_back(std::move(key), std::move(value));
+  detail::map_index *current = index.load(std::memory_order_relaxed);
+  if (current != nullptr) {
+    // hashed from the key the map now owns;
+    current->insert(entries.size() - 1, uint32_t(entries.back().first.hash()));
+  }
+  return entries.size() - 1;
+}
+
+bool DataItem::Table::insert(DataItem &&key, DataItem &&value) {
+  if (find(key) != entries.size()) {
+    return false;
   }
+  append(std::move(key), std::move(value));
+  return true;
+}
+
+// Keys are unique on both sides, so finding every entry of one map in the
+// other with the same value is enough;
+bool DataItem::Table::equals(const Table &other) const {
+  if (entries.size() != other.entries.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Map::value_type &entry = entries[i];
+    // both maps usually list their keys in the same order;
+    size_t position = entry.first == other.entries[i].first
+                          ? i
+                          : other.find(entry.first);
+    if (position == other.entries.size() ||
+        !(entry.second == other.entries[position].second)) {
+      return false;
+    }
+  }
+  return true;
 }
-void write_float(std::ostream &out, double value) {
-  if (double(float(value)) == value) {
-    union {
-      float f;
-      uint32_t i;
-    };
-    f = value;
-    write_uint32(out, 7, i);
+
+static bool entry_less(const Map::value_type *a, const Map::value_type *b) {
+  return *a < *b;
+}
+
+// Maps order as their entries sorted by key, whatever order they are in;
+bool DataItem::Table::less(const Table &other) const {
+  std::vector<const Map::value_type *> a, b;
+  a.reserve(entries.size());
+  b.reserve(other.entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    a.push_back(&entries[i]);
+  }
+  for (size_t i = 0; i < other.entries.size(); ++i) {
+    b.push_back(&other.entries[i]);
+  }
+  std::sort(a.begin(), a.end(), entry_less);
+  std::sort(b.begin(), b.end(), entry_less);
+  return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+                                      entry_less);
+}
+
+detail::map_index &DataItem::Table::indexed() const {
+  detail::map_index *current = index.load(std::memory_order_acquire);
+  if (current == nullptr) {
+    detail::map_index *built = new detail::map_index(entries);
+    if (index.compare_exchange_strong(current, built,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      current = built;
+    } else {
+      delete built;
+    }
+  }
+  return *current;
+}
+
+/* ----------------------- scanner ----------------------- */
+namespace detail {
+
+namespace {
+struct skip_visitor {
+  bool item(int, int, uint64_t, const uint8_t *) { return true; }
+  bool end_indefinite() { return true; }
+};
+} // namespace
+
+const uint8_t *skip_item(const uint8_t *p, const uint8_t *end) {
+  skip_visitor visitor;
+  return walk(p, end, visitor);
+}
+
+} // namespace detail
+
+const char *error_message(error reason) {
+  switch (reason) {
+  case error::None:
+    return "no error";
+  case error::Truncated:
+    return "unexpected end of input";
+  case error::ReservedInfo:
+    return "reserved additional information";
+  case error::UnexpectedBreak:
+    return "unexpected break";
+  case error::ChunkType:
+    return "invalid chunk in indefinite-length string";
+  case error::InvalidIndefinite:
+    return "indefinite length not allowed";
+  case error::InvalidSimple:
+    return "invalid two-byte simple value";
+  case error::CountTooLarge:
+    return "element count exceeds input";
+  case error::TooDeep:
+    return "indefinite-length items nested too deeply";
+  case error::InvalidUtf8:
+    return "invalid UTF-8 in text string";
+  case error::TrailingBytes:
+    return "trailing bytes";
+  case error::Aborted:
+    return "aborted";
+  }
+  return "unknown error";
+}
+
+namespace {
+struct utf8_visitor {
+  bool item(int major, int minor, uint64_t value, const uint8_t *payload) {
+    return major != major::TextString || minor == 31 ||
+           is_utf8(reinterpret_cast<const char *>(payload), size_t(value));
+  }
+  bool end_indefinite() { return true; }
+};
+} // namespace
+
+validate_result validate(const uint8_t *data, size_t size,
+                         const decode_options &options) {
+  detail::failure failed = {error::None, data};
+  const uint8_t *end = nullptr;
+  if (options.strict_utf8) {
+    utf8_visitor visitor;
+    end = detail::walk(data, data + size, visitor, &failed);
+    if (failed.reason == error::Aborted) {
+      failed.reason = error::InvalidUtf8;
+    }
   } else {
-    union {
-      double f;
-      uint64_t i;
-    };
-    f = value;
-    write_uint64(out, 7, i);
+    detail::skip_visitor visitor;
+    end = detail::walk(data, data + size, visitor, &failed);
+  }
+  validate_result result = {failed.reason, size_t(failed.at - data)};
+  if (end != nullptr) {
+    result.reason = end == data + size ? error::None : error::TrailingBytes;
+    result.offset = end - data;
+  }
+  return result;
+}
+
+/* ----------------------- decoder ----------------------- */
+// Copies the encoded bytes of exactly one data item from the stream, so that
+// the stream overload of read() can hand them to the contiguous decoder.
+// Only the framing is checked here, the decoder does the rest.
+static bool read_item_bytes(std::istream &in, std::vector<uint8_t> &out) {
+  const uint64_t indefinite = UINT64_MAX;
+  std::vector<uint64_t> pending(1, 1);
+  while (!pending.empty()) {
+    if (pending.back() == 0) {
+      pending.pop_back();
+      continue;
+    }
+    int initial = in.get();
+    if (initial == EOF) {
+      return false;
+    }
+    out.push_back(initial);
+    if (initial == 0xff) {
+      if (pending.back() != indefinite) {
+        return false;
+      }
+      pending.pop_back();
+      continue;
+    }
+    if (pending.back() != indefinite) {
+      pending.back()--;
+    }
+    int major = initial >> 5;
+    int minor = initial & 31;
+    uint64_t value = minor;
+    if (minor >= 24 && minor <= 27) {
+      uint8_t head[8];
+      size_t n = size_t(1) << (minor - 24);
+      if (!in.read(reinterpret_cast<char *>(head), n)) {
+        return false;
+      }
+      out.insert(out.end(), head, head + n);
+      value = 0;
+      for (size_t i = 0; i < n; ++i) {
+        value = value << 8 | head[i];
+      }
+    } else if (minor > 27 && minor < 31) {
+      return false;
+    }
+    switch (major) {
+    case major::ByteString:
+    case major::TextString:
+      if (minor == 31) {
+        pending.push_back(indefinite);
+        break;
+      }
+      while (value != 0) {
+        size_t chunk = value < 65536 ? size_t(value) : 65536;
+        size_t offset = out.size();
+        out.resize(offset + chunk);
+        if (!in.read(reinterpret_cast<char *>(&out[offset]), chunk)) {
+          return false;
+        }
+        value -= chunk;
+      }
+      break;
+    case major::Array:
+      pending.push_back(minor == 31 ? indefinite : value);
+      break;
+    case major::Map:
+      if (minor != 31 && value > indefinite / 2 - 1) {
+        return false;
+      }
+      pending.push_back(minor == 31 ? indefinite : value * 2);
+      break;
+    case major::Tag:
+      if (minor == 31) {
+        return false;
+      }
+      pending.push_back(1);
+      break;
+    default:
+      if (minor == 31) {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+// Decodes a definite or chunked string payload whose head has already been
+// consumed. Definite strings are returned in place, chunks are gathered into
+// `scratch`.
+static bool read_string(const uint8_t *&pos, const uint8_t *end, int major,
+                        int minor, uint64_t value, bool strict_utf8,
+                        const char *&data, size_t &size,
+                        std::string &scratch) {
+  const uint8_t *p = pos;
+  // every chunk of a text string must be valid UTF-8 by itself;
+  bool check = strict_utf8 && major == major::TextString;
+  if (minor != 31) {
+    if (value > uint64_t(end - p) ||
+        (check && !is_utf8(reinterpret_cast<const char *>(p), value))) {
+      return false;
+    }
+    data = reinterpret_cast<const char *>(p);
+    size = value;
+    pos = p + value;
+    return true;
+  }
+  for (;;) {
+    if (p == end) {
+      return false;
+    }
+    if (*p == 0xff) {
+      data = scratch.data();
+      size = scratch.size();
+      pos = p + 1;
+      return true;
+    }
+    int chunk_major = 0;
+    int chunk_minor = 0;
+    size_t n = detail::read_head(p, end, chunk_major, chunk_minor, value);
+    if (n == 0 || chunk_major != major || chunk_minor > 27) {
+      return false;
+    }
+    p += n;
+    if (value > uint64_t(end - p) ||
+        (check && !is_utf8(reinterpret_cast<const char *>(p), value))) {
+      return false;
+    }
+    scratch.append(reinterpret_cast<const char *>(p), value);
+    p += value;
   }
 }
 
+/* ----------------------- encoder ----------------------- */
 void DataItem::set_os_mode(stream_mode mode) { output_mode_ = mode; }
 
 bool DataItem::validate(const std::vector<uint8_t> &in) {
-  std::istringstream buf1(std::string(in.begin(), in.end()));
-  DataItem buf2;
-  return buf2.read(buf1) && buf1.peek() == EOF;
+  return bool(cbor::validate(in.data(), in.size()));
 }
 
 bool DataItem::read(std::istream &in) {
+  std::vector<uint8_t> buffer;
+  if (!read_item_bytes(in, buffer) || read(buffer.data(), buffer.size()) == 0) {
+    in.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
+size_t DataItem::read(const uint8_t *data, size_t size,
+                      const decode_options &options) {
+  const uint8_t *pos = data;
   DataItem item;
+  if (!item.read_from(pos, data + size, options, nullptr, 0)) {
+    return 0;
+  }
+  *this = std::move(item);
+  return pos - data;
+}
+
+bool DataItem::read_from(const uint8_t *&pos, const uint8_t *end,
+                         const decode_options &options,
+                         detail::string_table *strings, size_t depth) {
   int major = 0;
   int minor = 0;
   uint64_t value = 0;
-  read_uint(in, major, minor, value);
+  size_t head = detail::read_head(pos, end, major, minor, value);
+  if (head == 0) {
+    return false;
+  }
+  const uint8_t *p = pos + head;
+  // indefinite-length nesting is limited as in validate();
+  if (minor == 31) {
+    if (depth == detail::max_indefinite_depth) {
+      return false;
+    }
+    ++depth;
+  }
   switch (major) {
   case major::Unsigned:
     if (minor > 27) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    item.type_ = type_t::Unsigned;
-    item.value_ = value;
+    type_ = type_t::Unsigned;
+    value_ = value;
     break;
   case major::Negative:
     if (minor > 27) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    item.type_ = type_t::Negative;
-    item.value_ = value;
+    type_ = type_t::Negative;
+    value_ = value;
     break;
   case major::ByteString:
+  case major::TextString: {
     if (minor > 27 && minor < 31) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    item.type_ = type_t::Binary;
-    if (minor == 31) {
-      while (in.good() && in.peek() != 255) {
-        read_uint(in, major, minor, value);
-        if (major != 2 || minor > 27) {
-          in.setstate(std::ios_base::failbit);
-          return false;
-        }
-        for (uint64_t i = 0; in.good() && i != value; ++i) {
-          item.binary_.push_back(in.get());
-        }
-      }
-      in.get();
+    const char *data = nullptr;
+    size_t size = 0;
+    std::string scratch;
+    if (!read_string(p, end, major, minor, value, options.strict_utf8, data,
+                     size, scratch)) {
+      return false;
+    }
+    type_t type = major == major::ByteString ? type_t::Binary : type_t::String;
+    // chunked strings never get an index;
+    if (strings != nullptr && minor != 31 &&
+        size >= detail::stringref_min_length(strings->strings.size())) {
+      detail::string_table::entry entry = {data, size, type};
+      strings->strings.push_back(entry);
+    }
+    if (options.borrow && minor != 31) {
+      type_ = type;
+      storage_ = storage::Borrowed;
+      view_.data = data;
+      view_.size = size;
     } else {
-      for (uint64_t i = 0; in.good() && i != value; ++i) {
-        item.binary_.push_back(in.get());
-      }
+      set_bytes(type, data, size);
     }
     break;
-  case major::TextString:
+  }
+  case major::Array: {
     if (minor > 27 && minor < 31) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    item.type_ = type_t::String;
+    std::vector<DataItem> &array = make_array();
     if (minor == 31) {
-      while (in.good() && in.peek() != 255) {
-        read_uint(in, major, minor, value);
-        if (major != 3 || minor > 27) {
-          in.setstate(std::ios_base::failbit);
+      while (p != end && *p != 0xff) {
+        array.emplace_back();
+        if (!array.back().read_from(p, end, options, strings, depth)) {
           return false;
         }
-        for (uint64_t i = 0; in.good() && i != value; ++i) {
-          item.string_.push_back(in.get());
-        }
       }
-      in.get();
+      if (p == end) {
+        return false;
+      }
+      ++p;
     } else {
-      for (uint64_t i = 0; in.good() && i != value; ++i) {
-        item.string_.push_back(in.get());
+      // every element takes at least one byte, so never trust a count that
+      // the remaining input cannot hold;
+      if (value > uint64_t(end - p)) {
+        return false;
+      }
+      array.resize(value);
+      for (uint64_t i = 0; i != value; ++i) {
+        if (!array[i].read_from(p, end, options, strings, depth)) {
+          return false;
+        }
       }
     }
     break;
-  case major::Array:
+  }
+  case major::Map: {
     if (minor > 27 && minor < 31) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    item.type_ = type_t::Array;
-    if (minor == 31) {
-      while (in.good() && in.peek() != 255) {
-        DataItem child;
-        child.read(in);
-        item.array_.push_back(child);
+    Table &map = make_map();
+    if (minor != 31) {
+      // every entry takes at least two bytes;
+      if (value > uint64_t(end - p) / 2) {
+        return false;
       }
-      in.get();
-    } else {
-      for (uint64_t i = 0; in.good() && i != value; ++i) {
-        DataItem child;
-        child.read(in);
-        item.array_.push_back(child);
+      map.entries.reserve(value);
+    }
+    for (uint64_t i = 0; minor == 31 || i != value; ++i) {
+      if (minor == 31) {
+        if (p == end) {
+          return false;
+        }
+        if (*p == 0xff) {
+          ++p;
+          break;
+        }
       }
+      DataItem key, val;
+      if (!key.read_from(p, end, options, strings, depth) ||
+          !val.read_from(p, end, options, strings, depth)) {
+        return false;
+      }
+      // of repeated keys the first one is kept;
+      map.insert(std::move(key), std::move(val));
     }
     break;
-  case major::Map:
-    if (minor > 27 && minor < 31) {
-      in.setstate(std::ios_base::failbit);
+  }
+  case major::Tag: {
+    if (minor > 27) {
       return false;
     }
-    item.type_ = type_t::Map;
-    if (minor == 31) {
-      while (in.good() && in.peek() != 255) {
-        DataItem key, value;
-        key.read(in);
-        value.read(in);
-        item.map_.insert(std::make_pair(key, value));
+    if (options.stringref && value == 256) {
+      // a namespace, decoded in place of the tag with a table of its own;
+      detail::string_table scope;
+      if (!read_from(p, end, options, &scope, depth)) {
+        return false;
       }
-      in.get();
-    } else {
-      for (uint64_t i = 0; in.good() && i != value; ++i) {
-        DataItem key, value;
-        key.read(in);
-        value.read(in);
-        item.map_.insert(std::make_pair(key, value));
+      break;
+    }
+    if (strings != nullptr && value == 25) {
+      int index_major = 0;
+      int index_minor = 0;
+      uint64_t index = 0;
+      size_t index_head = detail::read_head(p, end, index_major, index_minor,
+                                            index);
+      if (index_head == 0 || index_major != major::Unsigned ||
+          index_minor > 27 || index >= strings->strings.size()) {
+        return false;
+      }
+      p += index_head;
+      const detail::string_table::entry &entry = strings->strings[index];
+      if (options.borrow) {
+        type_ = entry.type;
+        storage_ = storage::Borrowed;
+        view_.data = entry.data;
+        view_.size = entry.size;
+      } else {
+        set_bytes(entry.type, entry.data, entry.size);
       }
+      break;
     }
-    break;
-  case major::Tag: {
-    if (minor > 27) {
-      in.setstate(std::ios_base::failbit);
+    Tagged *tagged = new Tagged{value, DataItem()};
+    type_ = type_t::Tagged;
+    tagged_ = tagged;
+    if (!tagged->item.read_from(p, end, options, strings, depth)) {
       return false;
     }
-    item.type_ = type_t::Tagged;
-    item.value_ = value;
-    DataItem child;
-    child.read(in);
-    item.array_.push_back(child);
     break;
   }
   case major::Simple:
     if (minor > 27) {
-      in.setstate(std::ios_base::failbit);
       return false;
     }
-    switch (minor) {
-    case 25: {
-      item.type_ = type_t::Float;
-      int sign = value >> 15;
-      int exponent = value >> 10 & 31;
-      int significand = value & 1023;
-      if (exponent == 31) {
-        if (significand) {
-          item.float_ = NAN;
-        } else if (sign) {
-          item.float_ = -INFINITY;
-        } else {
-          item.float_ = INFINITY;
-        }
-      } else if (exponent == 0) {
-        if (sign) {
-          item.float_ = -ldexp(significand, -24);
-        } else {
-          item.float_ = ldexp(significand, -24);
-        }
-      } else {
-        if (sign) {
-          item.float_ = -ldexp(1024 | significand, exponent - 25);
-        } else {
-          item.float_ = ldexp(1024 | significand, exponent - 25);
-        }
-      }
-      break;
-    }
-    case 26: {
-      union {
-        float f;
-        uint32_t i;
-      };
-      i = value;
-      item.type_ = type_t::Float;
-      item.float_ = f;
-      break;
+    // two-byte simple values below 32 are not well-formed, RFC 8949 3.3;
+    if (minor == 24 && value < 32) {
+      return false;
     }
+    switch (minor) {
+    case 25:
+    case 26:
     case 27:
-      item.type_ = type_t::Float;
-      item.value_ = value;
+      type_ = type_t::Float;
+      float_ = detail::decode_float(minor, value);
       break;
     default:
-      item.type_ = type_t::Simple;
-      item.value_ = value;
+      type_ = type_t::Simple;
+      value_ = value;
     }
     break;
   }
-  if (!in.good()) {
-    in.setstate(std::ios_base::failbit);
-    return false;
-  }
-  *this = item;
+  pos = p;
   return true;
 }
 
 void DataItem::write(std::ostream &out) const {
+  std::vector<uint8_t> buffer;
+  write(buffer);
+  out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+}
+
+void DataItem::write(std::vector<uint8_t> &out) const {
+  size_t offset = out.size();
+  out.resize(offset + encoded_size());
+  write_to(out.data() + offset);
+}
+
+size_t DataItem::write(uint8_t *out, size_t capacity) const {
+  size_t size = encoded_size();
+  if (size > capacity) {
+    return 0;
+  }
+  write_to(out);
+  return size;
+}
+
+size_t DataItem::encoded_size() const {
+  size_t size = 0;
   switch (this->type_) {
   case type_t::Unsigned:
-    write_uint(out, 0, this->value_);
-    break;
   case type_t::Negative:
-    write_uint(out, 1, this->value_);
-    break;
+  case type_t::Simple:
+    return detail::head_size(this->value_);
   case type_t::Binary:
-    write_uint(out, 2, this->binary_.size());
-    out.write(reinterpret_cast<const char *>(this->binary_.data()),
-              this->binary_.size());
-    break;
   case type_t::String:
-    write_uint(out, 3, this->string_.size());
-    out.write(this->string_.data(), this->string_.size());
-    break;
+    return detail::head_size(bytes_size()) + bytes_size();
   case type_t::Array:
-    write_uint(out, 4, this->array_.size());
-    for (std::vector<DataItem>::const_iterator it = this->array_.begin();
-         it != this->array_.end(); ++it) {
-      it->write(out);
+    size = detail::head_size(this->array_->size());
+    for (std::vector<DataItem>::const_iterator it = this->array_->begin();
+         it != this->array_->end(); ++it) {
+      size += it->encoded_size();
     }
-    break;
+    return size;
   case type_t::Map:
-    write_uint(out, 5, this->map_.size());
-    for (std::map<DataItem, DataItem>::const_iterator it = this->map_.begin();
-         it != this->map_.end(); ++it) {
-      it->first.write(out);
-      it->second.write(out);
+    size = detail::head_size(this->map_->entries.size());
+    for (Map::const_iterator it = this->map_->entries.begin();
+         it != this->map_->entries.end(); ++it) {
+      size += it->first.encoded_size() + it->second.encoded_size();
     }
-    break;
+    return size;
   case type_t::Tagged:
-    write_uint(out, 6, this->value_);
-    this->array_.front().write(out);
-    break;
+    return detail::head_size(this->tagged_->tag) +
+           this->tagged_->item.encoded_size();
+  case type_t::Float:
+    return detail::float_size(this->float_);
+  }
+  return size;
+}
+
+uint8_t *DataItem::write_to(uint8_t *p) const {
+  switch (this->type_) {
+  case type_t::Unsigned:
+    return detail::write_head(p, major::Unsigned, this->value_);
+  case type_t::Negative:
+    return detail::write_head(p, major::Negative, this->value_);
+  case type_t::Binary:
+  case type_t::String:
+    p = detail::write_head(p,
+                           this->type_ == type_t::Binary ? major::ByteString
+                                                         : major::TextString,
+                           bytes_size());
+    memcpy(p, bytes_data(), bytes_size());
+    return p + bytes_size();
+  case type_t::Array:
+    p = detail::write_head(p, major::Array, this->array_->size());
+    for (std::vector<DataItem>::const_iterator it = this->array_->begin();
+         it != this->array_->end(); ++it) {
+      p = it->write_to(p);
+    }
+    return p;
+  case type_t::Map:
+    p = detail::write_head(p, major::Map, this->map_->entries.size());
+    for (Map::const_iterator it = this->map_->entries.begin();
+         it != this->map_->entries.end(); ++it) {
+      p = it->first.write_to(p);
+      p = it->second.write_to(p);
+    }
+    return p;
+  case type_t::Tagged:
+    p = detail::write_head(p, major::Tag, this->tagged_->tag);
+    return this->tagged_->item.write_to(p);
   case type_t::Simple:
-    write_uint8(out, 7, this->value_);
-    break;
+    return detail::write_head(p, major::Simple, this->value_);
   case type_t::Float:
-    write_float(out, this->float_);
-    break;
+    return detail::write_float(p, this->float_);
   }
+  return p;
 }
 
 // TODO honor the indentation;
@@ -835,10 +1507,10 @@ std::string DataItem::dump(int indent) const {
     out << "h'";
     out << std::hex;
     out.fill('0');
-    for (std::vector<uint8_t>::const_iterator it = binary_.begin();
-         it != binary_.end(); ++it) {
+    for (const char *it = bytes_data(), *end = it + bytes_size(); it != end;
+         ++it) {
       out.width(2);
-      out << int(*it);
+      out << int((unsigned char)*it);
     }
     out << "'";
     break;
@@ -846,7 +1518,7 @@ std::string DataItem::dump(int indent) const {
     out << "\"";
     out << std::hex;
     out.fill('0');
-    for (std::string::const_iterator it = string_.begin(); it != string_.end();
+    for (const char *it = bytes_data(), *end = it + bytes_size(); it != end;
          ++it) {
       switch (*it) {
       case '\n':
@@ -876,9 +1548,9 @@ std::string DataItem::dump(int indent) const {
     break;
   case type_t::Array:
     out << "[";
-    for (std::vector<DataItem>::const_iterator it = array_.begin();
-         it != array_.end(); ++it) {
-      if (it != array_.begin()) {
+    for (std::vector<DataItem>::const_iterator it = array_->begin();
+         it != array_->end(); ++it) {
+      if (it != array_->begin()) {
         out << ", ";
       }
       out << it->dump(indent);
@@ -887,9 +1559,9 @@ std::string DataItem::dump(int indent) const {
     break;
   case type_t::Map:
     out << "{";
-    for (std::map<DataItem, DataItem>::const_iterator it = map_.begin();
-         it != map_.end(); ++it) {
-      if (it != map_.begin()) {
+    for (Map::const_iterator it = map_->entries.begin();
+         it != map_->entries.end(); ++it) {
+      if (it != map_->entries.begin()) {
         out << ", ";
       }
       out << it->first.dump(indent) << ": " << it->second.dump(indent);
@@ -897,7 +1569,7 @@ std::string DataItem::dump(int indent) const {
     out << "}";
     break;
   case type_t::Tagged:
-    out << value_ << "(" << array_.front().dump(indent) << ")";
+    out << tagged_->tag << "(" << tagged_->item.dump(indent) << ")";
     break;
   case type_t::Simple:
     switch (value_) {
@@ -1,16 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <map>
 #include <stdint.h>
+#include <string.h>
+#include <string>
 #include <vector>
 
 namespace cbor {
 
 class DataItem;
+namespace detail {
+struct canonical_encoder;
+struct parallel_encoder;
+struct string_table;
+struct stringref_encoder;
+} // namespace detail
 using Array = std::vector<DataItem>;
-using Map = std::vector<DataItem, DataItem>;
+/**
+ * @brief Entries of a map, in the order they were decoded or inserted, which
+ * is also the order they are encoded in.
+ */
+using Map = std::vector<std::pair<DataItem, DataItem>>;
 
 enum simple { // TODO
   False = 20,
@@ -34,7 +48,7 @@ enum class type_t : uint8_t {
 };
 
 using array_iterator = std::vector<DataItem>::const_iterator;
-using map_iterator = std::map<DataItem, DataItem>::const_iterator;
+using map_iterator = Map::const_iterator;
 
 class iterator {
 public:
@@ -117,6 +131,165 @@ enum class stream_mode : uint8_t {
   Binary,
 };
 
+/**
+ * @brief Non-owning reference to a run of characters or bytes, a stand-in
+ * for std::string_view which C++11 does not have.
+ */
+template <typename T> class basic_view {
+public:
+  using value_type = T;
+  using const_iterator = const T *;
+
+  basic_view() : data_(nullptr), size_(0) {}
+  basic_view(const T *data, size_t size) : data_(data), size_(size) {}
+
+  const T *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T &operator[](size_t index) const { return data_[index]; }
+
+  friend bool operator==(const basic_view &a, const basic_view &b) {
+    return a.size_ == b.size_ &&
+           (a.size_ == 0 || memcmp(a.data_, b.data_, a.size_ * sizeof(T)) == 0);
+  }
+  friend bool operator!=(const basic_view &a, const basic_view &b) {
+    return !(a == b);
+  }
+
+private:
+  const T *data_;
+  size_t size_;
+};
+
+using string_view = basic_view<char>;
+using bytes_view = basic_view<uint8_t>;
+
+/**
+ * @brief Elements of a typed array as T, see DataItem::as_typed(). They are
+ * read in place when the item's bytes already are an aligned array of T in
+ * the host's byte order, and are converted into a buffer the view owns
+ * otherwise. In-place views are valid until the item is modified or
+ * destroyed.
+ */
+template <typename T> class typed_view {
+public:
+  using value_type = T;
+  using const_iterator = const T *;
+
+  typed_view() : data_(nullptr), size_(0) {}
+  typed_view(const T *data, size_t size) : data_(data), size_(size) {}
+  explicit typed_view(std::vector<T> &&values)
+      : values_(std::move(values)), data_(values_.data()),
+        size_(values_.size()) {}
+
+  typed_view(const typed_view &other)
+      : values_(other.values_),
+        data_(other.values_.empty() ? other.data_ : values_.data()),
+        size_(other.size_) {}
+  typed_view(typed_view &&other) noexcept
+      : values_(std::move(other.values_)),
+        data_(values_.empty() ? other.data_ : values_.data()),
+        size_(other.size_) {}
+  typed_view &operator=(const typed_view &other) {
+    typed_view copy(other);
+    values_.swap(copy.values_);
+    data_ = values_.empty() ? copy.data_ : values_.data();
+    size_ = copy.size_;
+    return *this;
+  }
+
+  const T *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  const T &operator[](size_t index) const { return data_[index]; }
+  /**
+   * @brief Whether the elements are read straight from the item's bytes.
+   */
+  bool in_place() const { return values_.empty() && size_ != 0; }
+
+private:
+  std::vector<T> values_;
+  const T *data_;
+  size_t size_;
+};
+
+/**
+ * @brief Options for the buffer decoders.
+ */
+struct decode_options {
+  /**
+   * @brief Definite-length strings and byte strings reference the input
+   * instead of copying it. The caller must keep the buffer alive and
+   * unchanged while the decoded items are in use. Chunked strings are
+   * still copied.
+   */
+  bool borrow = false;
+  /**
+   * @brief Reject text strings, and each chunk of a chunked one, that are
+   * not well-formed UTF-8, checked with is_utf8().
+   */
+  bool strict_utf8 = false;
+  /**
+   * @brief Resolve the stringref extension: the content of a tag 256 is
+   * decoded in place of the tag, with every tag 25 in it replaced by the
+   * string it refers to. With `borrow` such strings share the bytes of
+   * their first occurrence in the input. Tag 25 outside a tag 256 is kept
+   * as a tag.
+   */
+  bool stringref = false;
+};
+
+/**
+ * @brief Whether [data, data + size) is well-formed UTF-8: no overlong
+ * forms, surrogates or code points above U+10FFFF. Uses the widest of
+ * AVX2, SSE4.2 or NEON the CPU supports, picked on first use.
+ */
+bool is_utf8(const char *data, size_t size);
+
+/**
+ * @brief Why validate() rejected its input.
+ */
+enum class error : uint8_t {
+  None,
+  Truncated,         // the input ends inside an item;
+  ReservedInfo,      // additional information 28 to 30;
+  UnexpectedBreak,   // break outside an indefinite-length item or map value;
+  ChunkType,         // chunk that is not a definite string of the same type;
+  InvalidIndefinite, // indefinite length on an integer or tag;
+  InvalidSimple,     // two-byte simple value below 32;
+  CountTooLarge,     // more elements than the remaining bytes can hold;
+  TooDeep,           // more than 1024 nested indefinite-length items;
+  InvalidUtf8,       // text that is not UTF-8, with strict_utf8 only;
+  TrailingBytes,     // bytes after the item;
+  Aborted            // a walker callback stopped;
+};
+
+const char *error_message(error reason);
+
+/**
+ * @brief Outcome of validate(): the first error and the offset of the head
+ * it was found at, or error::None and the size of the input.
+ */
+struct validate_result {
+  error reason;
+  size_t offset;
+
+  explicit operator bool() const { return reason == error::None; }
+};
+
+/**
+ * @brief Check that [data, data + size) holds exactly one well-formed item
+ * without decoding it, as DataItem::read() would. Only a fixed-size stack
+ * is used, no heap memory, which limits nesting of indefinite-length items
+ * to 1024. Of the options only strict_utf8 applies.
+ */
+validate_result validate(const uint8_t *data, size_t size,
+                         const decode_options &options = decode_options());
+
 class DataItem {
 public:
   DataItem(std::nullptr_t);
@@ -142,8 +315,19 @@ public:
 
   DataItem(const std::vector<DataItem> &value);
   DataItem(const std::map<DataItem, DataItem> &value);
+  /**
+   * @brief Map with the entries of `value` in order; of repeated keys the
+   * first one is kept.
+   */
+  DataItem(const Map &value);
   DataItem(simple value = simple::Undefined);
 
+  DataItem(const DataItem &other);
+  DataItem(DataItem &&other) noexcept;
+  DataItem &operator=(const DataItem &other);
+  DataItem &operator=(DataItem &&other) noexcept;
+  ~DataItem();
+
   type_t type() const;
 
   bool is_unsigned() const;
@@ -160,9 +344,27 @@ public:
   bool is_undefined() const;
   bool is_float() const;
   bool is_number() const;
+  /**
+   * @brief Whether this string or byte string references a buffer it was
+   * decoded from with decode_options::borrow.
+   */
+  bool is_borrowed() const;
+  /**
+   * @brief Whether this is an RFC 8746 typed array: a byte string tagged 64
+   * to 87 whose size is a multiple of the element size. 128-bit floats
+   * are not supported.
+   */
+  bool is_typed_array() const;
 
   DataItem& at(size_t index);
   const DataItem& at(size_t index) const; 
+  /**
+   * @brief Value stored under `key` in this map, nullptr if there is none
+   * or this is not a map. Maps of 16 entries or more are searched through a
+   * hash index, built on the first lookup and kept up to date by
+   * operator[], so a hit costs one hash and usually one key comparison.
+   */
+  const DataItem *find(const DataItem &key) const;
 
   template <typename T> T as() { return (T) * this; }
   template <typename T> T get() { return (T) * this; }
@@ -175,7 +377,30 @@ public:
   DataItem child() const;
 
   bool read(std::istream &in);
+  /**
+   * @brief Decode one data item from a contiguous buffer. It accepts what
+   * validate() accepts, including its limit of 1024 nested
+   * indefinite-length items.
+   * @return number of bytes consumed, 0 if the input is malformed or
+   * truncated, in which case the item is left untouched.
+   */
+  size_t read(const uint8_t *data, size_t size,
+              const decode_options &options = decode_options());
   void write(std::ostream &out) const;
+  /**
+   * @brief Append the encoding to `out`, growing it exactly once.
+   */
+  void write(std::vector<uint8_t> &out) const;
+  /**
+   * @brief Encode into a caller-supplied buffer.
+   * @return number of bytes written, 0 if `capacity` is less than
+   * encoded_size(), in which case nothing is written.
+   */
+  size_t write(uint8_t *out, size_t capacity) const;
+  /**
+   * @brief Exact number of bytes write() produces for this item.
+   */
+  size_t encoded_size() const;
 
   /**
    * @brief Set output stream mode, Text mode can be useful when
@@ -188,8 +413,7 @@ public:
   void push_back(DataItem &&item);
 
   template <class... Args> void emplace_back(Args &&...args) {
-    type_ = type_t::Array;
-    array_.emplace_back(std::forward<Args>(args)...);
+    make_array().emplace_back(std::forward<Args>(args)...);
   }
   // TODO at append, emplace ;
 
@@ -228,31 +452,121 @@ public:
   operator std::map<DataItem, DataItem>() const;
   operator cbor::simple() const;
 
+  /**
+   * @brief View the bytes of a text or byte string without copying, empty
+   * for other types. Valid until the item is modified or destroyed.
+   */
+  string_view as_string_view() const;
+  bytes_view as_bytes_view() const;
+  /**
+   * @brief Elements of a typed array, or of an array of numbers, converted
+   * to T, without creating an item per element. A typed array of T in the
+   * host's byte order is viewed in place when its bytes are aligned, one in
+   * the other byte order is swapped with the widest vector unit the CPU
+   * has. Empty for other items. T is one of the fixed-width integers,
+   * float or double.
+   */
+  template <typename T> typed_view<T> as_typed() const;
+
   bool operator==(const DataItem &other) const;
   bool operator!=(const DataItem &other) const;
 
   bool operator<(const DataItem &other) const;
 
+  /**
+   * @brief Structural hash, equal for items that compare equal; maps hash
+   * the same whatever the order of their entries. Strings keep it once
+   * computed; containers and tags hash their current content on every call,
+   * since their elements may change through references.
+   */
+  size_t hash() const;
+
   std::string dump(int indent = 2) const;
 
   static DataItem tagged(unsigned long long tag, const DataItem &value);
+  /**
+   * @brief Negative integer -1 - value, covering the whole major type 1
+   * range down to -2^64.
+   */
+  static DataItem negative(uint64_t value);
+  /**
+   * @brief RFC 8746 typed array of `count` values: their bytes in the
+   * host's byte order, tagged with the matching tag. T is as for
+   * as_typed().
+   */
+  template <typename T>
+  static DataItem typed_array(const T *values, size_t count);
+  template <typename T>
+  static DataItem typed_array(const std::vector<T> &values) {
+    return typed_array(values.data(), values.size());
+  }
+  /**
+   * @brief RFC 8746 typed array of `count` half-precision floats (tag 80 or
+   * 84), from `values` rounded to nearest even, converted with F16C or
+   * NEON when the CPU has them. Half the size of typed_array() of floats.
+   */
+  static DataItem half_array(const float *values, size_t count);
+  static DataItem half_array(const std::vector<float> &values) {
+    return half_array(values.data(), values.size());
+  }
+  /**
+   * @brief Whether `in` is exactly one well-formed item, see cbor::validate().
+   */
   static bool validate(const std::vector<uint8_t> &in);
 
   friend std::istream& operator>> (std::istream& is, DataItem& item);
   friend std::ostream& operator<<(std::ostream& os, const DataItem& item);
 
   friend iterator;
+  friend detail::canonical_encoder;
+  friend detail::parallel_encoder;
+  friend detail::stringref_encoder;
 private:
+  struct Tagged;
+  struct Table;
+  enum class storage : uint8_t {
+    Inline,
+    Heap,
+    Borrowed,
+  };
+  struct view {
+    const char *data;
+    size_t size;
+  };
+  static const size_t small_capacity = 16;
+
+  // Only the payload of the active type exists: scalars live in value_ or
+  // float_, strings and byte strings of up to small_capacity bytes live in
+  // small_, borrowed strings keep a view_ into the input, everything else
+  // is a single out-of-line allocation. The hash of a string is cached in
+  // what would otherwise be padding. This keeps sizeof(DataItem) at 24
+  // bytes on 64-bit targets.
   cbor::type_t type_ = type_t::Simple; // TODO null;
+  stream_mode output_mode_ = stream_mode::Text;
+  storage storage_ = storage::Inline;
+  uint8_t small_size_ = 0;
+  // 0 until hash() has run on a string;
+  mutable std::atomic<uint32_t> hash_{0};
   union {
     uint64_t value_;
     double float_;
+    char small_[small_capacity];
+    view view_;
+    std::string *bytes_;
+    std::vector<DataItem> *array_;
+    Table *map_;
+    Tagged *tagged_;
   };
-  std::vector<uint8_t> binary_;
-  std::string string_;
-  std::vector<DataItem> array_;
-  std::map<DataItem, DataItem> map_;
-  stream_mode output_mode_ = stream_mode::Text;
+
+  void release();
+  void copy_from(const DataItem &other);
+  void move_from(DataItem &other);
+  void set_bytes(type_t type, const char *data, size_t size);
+  const char *bytes_data() const;
+  size_t bytes_size() const;
+  std::vector<DataItem> &make_array();
+  Table &make_map();
+  uint32_t compute_hash() const;
 
   uint64_t to_unsigned() const;
   int64_t to_signed() const;
@@ -263,12 +577,27 @@ private:
   std::vector<DataItem> to_array() const;
   std::map<DataItem, DataItem> to_map() const;
   simple to_simple() const;
+
+  // `depth` counts the indefinite-length items around this one;
+  bool read_from(const uint8_t *&pos, const uint8_t *end,
+                 const decode_options &options,
+                 detail::string_table *strings, size_t depth);
+  uint8_t *write_to(uint8_t *p) const;
 };
 
-DataItem decode(std::vector<uint8_t> &binary);
-void encode(DataItem &item, std::vector<uint8_t> &binary);
+DataItem decode(const uint8_t *data, size_t size,
+                const decode_options &options = decode_options());
+DataItem decode(const std::vector<uint8_t> &binary);
+std::vector<uint8_t> encode(const DataItem &item);
+void encode(const DataItem &item, std::vector<uint8_t> &binary);
 
 DataItem array(std::initializer_list<DataItem> items = {});
 DataItem map(std::initializer_list<std::pair<DataItem, DataItem>> items = {});
 
 } // namespace cbor
+
+namespace std {
+template <> struct hash<cbor::DataItem> {
+  size_t operator()(const cbor::DataItem &item) const { return item.hash(); }
+};
+} // namespace std
@@ -0,0 +1,669 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+#if defined(_MSC_VER) ||                                                       \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CBOR_LITTLE_ENDIAN 1
+#endif
+
+// Vector kernels are compiled for the widest instruction set with a target
+// attribute and picked at run time, so the baseline build stays portable;
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||          \
+    defined(_M_IX86)
+#define CBOR_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CBOR_NEON 1
+#endif
+
+// Single conversions between half and single precision use F16C when the
+// build targets it, and NEON, which always has them;
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define CBOR_F16C 1
+#include <immintrin.h>
+#elif defined(CBOR_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CBOR_TARGET(x)
+#else
+#define CBOR_TARGET(x) __attribute__((target(x)))
+#endif
+
+namespace cbor {
+
+namespace major {
+const int Unsigned = 0;
+const int Negative = 1;
+const int ByteString = 2;
+const int TextString = 3;
+const int Array = 4;
+const int Map = 5;
+const int Tag = 6;
+const int Simple = 7; // float and simple;
+} // namespace major
+
+namespace detail {
+
+inline uint16_t byteswap(uint16_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_ushort(v);
+#else
+  return __builtin_bswap16(v);
+#endif
+}
+inline uint32_t byteswap(uint32_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_ulong(v);
+#else
+  return __builtin_bswap32(v);
+#endif
+}
+inline uint64_t byteswap(uint64_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_uint64(v);
+#else
+  return __builtin_bswap64(v);
+#endif
+}
+
+template <typename T> inline T load_be(const uint8_t *p) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+#ifdef CBOR_LITTLE_ENDIAN
+  v = byteswap(v);
+#endif
+  return v;
+}
+
+template <typename T> inline void store_be(uint8_t *p, T v) {
+#ifdef CBOR_LITTLE_ENDIAN
+  v = byteswap(v);
+#endif
+  memcpy(p, &v, sizeof(T));
+}
+
+/**
+ * @brief Size of the shortest head encoding `value` as its argument.
+ */
+inline size_t head_size(uint64_t value) {
+  if (value < 24) {
+    return 1;
+  } else if ((value >> 8) == 0) {
+    return 2;
+  } else if ((value >> 16) == 0) {
+    return 3;
+  } else if ((value >> 32) == 0) {
+    return 5;
+  }
+  return 9;
+}
+
+/**
+ * @brief Write the shortest head for `major` and `value` at `p`, which must
+ * have room for head_size(value) bytes.
+ * @return one past the last byte written.
+ */
+inline uint8_t *write_head(uint8_t *p, int major, uint64_t value) {
+  uint8_t initial = uint8_t(major << 5);
+  if (value < 24) {
+    *p = initial | uint8_t(value);
+    return p + 1;
+  } else if ((value >> 8) == 0) {
+    p[0] = initial | 24;
+    p[1] = uint8_t(value);
+    return p + 2;
+  } else if ((value >> 16) == 0) {
+    p[0] = initial | 25;
+    store_be(p + 1, uint16_t(value));
+    return p + 3;
+  } else if ((value >> 32) == 0) {
+    p[0] = initial | 26;
+    store_be(p + 1, uint32_t(value));
+    return p + 5;
+  }
+  p[0] = initial | 27;
+  store_be(p + 1, value);
+  return p + 9;
+}
+
+/**
+ * @brief Tables for converting half to single precision where the build
+ * targets no instruction for it, see half_to_float().
+ */
+struct half_tables {
+  uint32_t mantissa[2048];
+  uint32_t exponent[64];
+  uint16_t offset[64];
+};
+const half_tables &half_table();
+
+/**
+ * @brief Single precision value of the half-precision bits `half`, exact.
+ */
+inline float half_to_float(uint16_t half) {
+#if defined(CBOR_F16C)
+  return _cvtsh_ss(half);
+#elif defined(CBOR_NEON)
+  float16x4_t h = vreinterpret_f16_u16(vdup_n_u16(half));
+  return vget_lane_f32(vget_low_f32(vcvt_f32_f16(h)), 0);
+#else
+  const half_tables &t = half_table();
+  unsigned high = half >> 10;
+  uint32_t bits = t.mantissa[t.offset[high] + (half & 0x3ff)];
+  bits += t.exponent[high];
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+#endif
+}
+
+/**
+ * @brief Half-precision bits of `value`, rounded to nearest even.
+ */
+inline uint16_t float_to_half(float value) {
+#if defined(CBOR_F16C)
+  return uint16_t(_cvtss_sh(value, 0));
+#elif defined(CBOR_NEON)
+  float16x4_t h = vcvt_f16_f32(vdupq_n_f32(value));
+  return vget_lane_u16(vreinterpret_u16_f16(h), 0);
+#else
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint16_t half;
+  if (bits >= 143u << 23) {
+    // too large, infinite or NaN, which is quieted and keeps the top of
+    // its payload as the instructions do;
+    half = bits > 255u << 23 ? uint16_t(0x7e00 | (bits >> 13 & 0x3ff))
+                             : uint16_t(0x7c00);
+  } else if (bits < 113u << 23) {
+    // subnormal or zero: adding 0.5 lets the FPU round the significand;
+    const uint32_t magic_bits = 126u << 23;
+    float f, magic;
+    memcpy(&f, &bits, sizeof(f));
+    memcpy(&magic, &magic_bits, sizeof(magic));
+    f += magic;
+    memcpy(&bits, &f, sizeof(bits));
+    half = uint16_t(bits - magic_bits);
+  } else {
+    uint32_t odd = bits >> 13 & 1;
+    bits += (uint32_t(15 - 127) << 23) + 0xfff + odd;
+    half = uint16_t(bits >> 13);
+  }
+  return uint16_t(half | sign >> 16);
+#endif
+}
+
+/**
+ * @brief Convert `count` values between half and single precision, with
+ * F16C or NEON instructions where the CPU has them.
+ */
+void halves_to_floats(float *out, const uint16_t *in, size_t count);
+void floats_to_halves(uint16_t *out, const float *in, size_t count);
+
+/**
+ * @brief Bytes of the shortest float that holds `value` exactly, 2, 4 or
+ * 8, with its bits in `bits`. NaN payloads count as part of the value.
+ */
+inline size_t float_width(double value, uint64_t &bits) {
+  if (value != value) {
+    uint64_t d;
+    memcpy(&d, &value, sizeof(d));
+    uint64_t sign = d >> 63;
+    uint64_t payload = d & 0xfffffffffffffu;
+    if ((payload & ((uint64_t(1) << 42) - 1)) == 0) {
+      bits = sign << 15 | 0x7c00 | payload >> 42;
+      return 2;
+    }
+    if ((payload & ((uint64_t(1) << 29) - 1)) == 0) {
+      bits = sign << 31 | 0x7f800000 | payload >> 29;
+      return 4;
+    }
+    bits = d;
+    return 8;
+  }
+  float f = float(value);
+  if (double(f) != value) {
+    memcpy(&bits, &value, sizeof(bits));
+    return 8;
+  }
+  uint16_t half = float_to_half(f);
+  if (half_to_float(half) == f) {
+    bits = half;
+    return 2;
+  }
+  uint32_t single;
+  memcpy(&single, &f, sizeof(single));
+  bits = single;
+  return 4;
+}
+
+/**
+ * @brief Size of the shortest float encoding that keeps `value` exact.
+ */
+inline size_t float_size(double value) {
+  uint64_t bits;
+  return 1 + float_width(value, bits);
+}
+
+/**
+ * @brief Write `value` as the shortest exact float, float_size(value) bytes.
+ * @return one past the last byte written.
+ */
+inline uint8_t *write_float(uint8_t *p, double value) {
+  uint64_t bits;
+  switch (float_width(value, bits)) {
+  case 2:
+    p[0] = major::Simple << 5 | 25;
+    store_be(p + 1, uint16_t(bits));
+    return p + 3;
+  case 4:
+    p[0] = major::Simple << 5 | 26;
+    store_be(p + 1, uint32_t(bits));
+    return p + 5;
+  default:
+    p[0] = major::Simple << 5 | 27;
+    store_be(p + 1, bits);
+    return p + 9;
+  }
+}
+
+/**
+ * @brief Value of a float head with additional info 25, 26 or 27.
+ */
+inline double decode_float(int minor, uint64_t value) {
+  switch (minor) {
+  case 25:
+    return half_to_float(uint16_t(value));
+  case 26: {
+    uint32_t bits = uint32_t(value);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+  default: {
+    double d;
+    memcpy(&d, &value, sizeof(d));
+    return d;
+  }
+  }
+}
+
+/**
+ * @brief Parse the initial byte and argument of a data item.
+ * @return bytes consumed, or 0 when [p, end) is too short to hold the head.
+ * For additional info 28..31 the argument is the additional info itself,
+ * callers decide whether it is reserved or an indefinite length.
+ */
+inline size_t read_head(const uint8_t *p, const uint8_t *end, int &major,
+                        int &minor, uint64_t &value) {
+  if (p == end) {
+    return 0;
+  }
+  major = *p >> 5;
+  minor = *p & 31;
+  size_t avail = end - p;
+  switch (minor) {
+  case 24:
+    if (avail < 2) {
+      return 0;
+    }
+    value = p[1];
+    return 2;
+  case 25:
+    if (avail < 3) {
+      return 0;
+    }
+    value = load_be<uint16_t>(p + 1);
+    return 3;
+  case 26:
+    if (avail < 5) {
+      return 0;
+    }
+    value = load_be<uint32_t>(p + 1);
+    return 5;
+  case 27:
+    if (avail < 9) {
+      return 0;
+    }
+    value = load_be<uint64_t>(p + 1);
+    return 9;
+  default:
+    value = minor;
+    return 1;
+  }
+}
+
+/**
+ * @brief Deepest nesting of indefinite-length items that walk() follows;
+ * definite-length nesting is not limited.
+ */
+const size_t max_indefinite_depth = 1024;
+
+// what the innermost open indefinite-length item accepts next;
+enum indefinite_kind {
+  IndefiniteArray,
+  IndefiniteMapKey,
+  IndefiniteMapValue,
+  IndefiniteBytes,
+  IndefiniteText,
+};
+
+#if defined(CBOR_X86)
+/**
+ * @brief CPU features the x86 kernels need, the OS saving the registers
+ * included.
+ */
+bool has_sse42();
+bool has_avx2();
+bool has_f16c();
+#endif
+
+/**
+ * @brief Portable UTF-8 check behind is_utf8(), for inputs too short for the
+ * vector kernels and CPUs without them.
+ */
+bool is_utf8_scalar(const uint8_t *p, size_t size);
+
+/**
+ * @brief Where and why walk() stopped.
+ */
+struct failure {
+  error reason;
+  const uint8_t *at;
+};
+
+inline const uint8_t *fail(failure *failed, error reason, const uint8_t *at) {
+  if (failed != nullptr) {
+    failed->reason = reason;
+    failed->at = at;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Check the structure of the data item starting at `p` by scanning
+ * its heads, without recursion or allocation, and report every head to
+ * `visitor` in encoding order:
+ *
+ *   bool item(int major, int minor, uint64_t value, const uint8_t *payload)
+ *     for every head, including string chunks; `payload` follows the head
+ *     and holds `value` bytes for definite-length strings;
+ *   bool end_indefinite()
+ *     for the break closing an indefinite-length item.
+ *
+ * Returning false from the visitor stops the walk.
+ * @return one past the last byte of the item, or nullptr if it is malformed,
+ * extends past `end` or the visitor stopped, which is then described in
+ * `failed` if given.
+ */
+template <typename Visitor>
+const uint8_t *walk(const uint8_t *p, const uint8_t *end, Visitor &visitor,
+                    failure *failed = nullptr) {
+  // Items still to be started. Definite-length containers simply add their
+  // children, so only indefinite-length items need a stack entry, which
+  // keeps the outer count and the kind shifted into the low 3 bits.
+  uint64_t pending = 1;
+  uint64_t stack[max_indefinite_depth];
+  size_t depth = 0;
+  while (pending != 0 || depth != 0) {
+    if (p == end) {
+      return fail(failed, error::Truncated, p);
+    }
+    const uint8_t *start = p;
+    int kind = -1;
+    if (pending == 0) {
+      kind = int(stack[depth - 1] & 7);
+      if (*p == 0xff) {
+        if (kind == IndefiniteMapValue) {
+          return fail(failed, error::UnexpectedBreak, p);
+        }
+        if (!visitor.end_indefinite()) {
+          return fail(failed, error::Aborted, p);
+        }
+        pending = stack[--depth] >> 3;
+        ++p;
+        continue;
+      }
+      if (kind == IndefiniteMapKey || kind == IndefiniteMapValue) {
+        stack[depth - 1] ^= IndefiniteMapKey ^ IndefiniteMapValue;
+      }
+    } else {
+      --pending;
+    }
+    int major = 0;
+    int minor = 0;
+    uint64_t value = 0;
+    size_t head = read_head(p, end, major, minor, value);
+    if (head == 0) {
+      return fail(failed, error::Truncated, start);
+    }
+    if (minor > 27 && minor < 31) {
+      return fail(failed, error::ReservedInfo, start);
+    }
+    p += head;
+    uint64_t avail = uint64_t(end - p);
+    if (kind == IndefiniteBytes || kind == IndefiniteText) {
+      int chunk_major =
+          kind == IndefiniteBytes ? major::ByteString : major::TextString;
+      if (major != chunk_major || minor == 31) {
+        return fail(failed, error::ChunkType, start);
+      }
+      if (value > avail) {
+        return fail(failed, error::Truncated, start);
+      }
+      if (!visitor.item(major, minor, value, p)) {
+        return fail(failed, error::Aborted, start);
+      }
+      p += value;
+      continue;
+    }
+    switch (major) {
+    case major::ByteString:
+    case major::TextString:
+      if (minor != 31 && value > avail) {
+        return fail(failed, error::Truncated, start);
+      }
+      if (minor == 31 && depth == max_indefinite_depth) {
+        return fail(failed, error::TooDeep, start);
+      }
+      if (!visitor.item(major, minor, value, p)) {
+        return fail(failed, error::Aborted, start);
+      }
+      if (minor != 31) {
+        p += value;
+        break;
+      }
+      stack[depth++] = pending << 3 | (major == major::ByteString
+                                            ? IndefiniteBytes
+                                            : IndefiniteText);
+      pending = 0;
+      break;
+    case major::Array:
+    case major::Map:
+      if (minor == 31) {
+        if (depth == max_indefinite_depth) {
+          return fail(failed, error::TooDeep, start);
+        }
+        if (!visitor.item(major, minor, value, p)) {
+          return fail(failed, error::Aborted, start);
+        }
+        stack[depth++] = pending << 3 | (major == major::Array
+                                              ? IndefiniteArray
+                                              : IndefiniteMapKey);
+        pending = 0;
+        break;
+      }
+      if (major == major::Map) {
+        if (value > avail / 2) {
+          return fail(failed, error::CountTooLarge, start);
+        }
+        value *= 2;
+      }
+      // every pending item needs at least one more byte;
+      if (value > avail || pending + value > avail) {
+        return fail(failed, error::CountTooLarge, start);
+      }
+      if (!visitor.item(major, minor, major == major::Map ? value / 2 : value,
+                        p)) {
+        return fail(failed, error::Aborted, start);
+      }
+      pending += value;
+      break;
+    case major::Tag:
+      if (minor == 31) {
+        return fail(failed, error::InvalidIndefinite, start);
+      }
+      if (!visitor.item(major, minor, value, p)) {
+        return fail(failed, error::Aborted, start);
+      }
+      ++pending;
+      break;
+    default:
+      if (minor == 31) {
+        return fail(failed, major == major::Simple ? error::UnexpectedBreak
+                                                   : error::InvalidIndefinite,
+                    start);
+      }
+      if (major == major::Simple && minor == 24 && value < 32) {
+        return fail(failed, error::InvalidSimple, start);
+      }
+      if (!visitor.item(major, minor, value, p)) {
+        return fail(failed, error::Aborted, start);
+      }
+      break;
+    }
+  }
+  return p;
+}
+
+/**
+ * @brief Find the end of the data item starting at `p` by scanning heads
+ * only, without decoding or allocating anything.
+ * @return one past the last byte of the item, or nullptr if it is malformed
+ * or extends past `end`.
+ */
+const uint8_t *skip_item(const uint8_t *p, const uint8_t *end);
+
+/**
+ * @brief Maps with fewer entries than this are searched without an index.
+ */
+const size_t index_threshold = 16;
+
+/**
+ * @brief Open-addressing hash index over the entries of a map. Slots keep
+ * the key hash next to the entry's position, so probing compares keys only
+ * when the hashes match. Probing is linear and the table at most half full.
+ */
+struct map_index {
+  struct slot {
+    uint32_t hash;
+    uint32_t position; // one past the entry, 0 for an empty slot;
+  };
+
+  std::vector<slot> slots;
+  size_t count;
+
+  explicit map_index(const Map &entries);
+
+  /**
+   * @return position of `key` in `entries`, or entries.size().
+   */
+  size_t find(const Map &entries, const DataItem &key, uint32_t hash) const;
+  void insert(size_t position, uint32_t hash);
+
+private:
+  void place(const slot &s);
+};
+
+/**
+ * @brief Shortest string that gets an index in a stringref namespace which
+ * already holds `count` strings: the first length at which a reference is
+ * shorter than the string itself.
+ */
+inline size_t stringref_min_length(size_t count) {
+  if (count < 24) {
+    return 3;
+  }
+  if (count < 256) {
+    return 4;
+  }
+  if (count < 65536) {
+    return 5;
+  }
+  return uint64_t(count) < (uint64_t(1) << 32) ? 7 : 11;
+}
+
+/**
+ * @brief Strings of the innermost stringref namespace being decoded, in
+ * the order they got their index. They point into the input.
+ */
+struct string_table {
+  struct entry {
+    const char *data;
+    size_t size;
+    type_t type;
+  };
+  std::vector<entry> strings;
+};
+
+} // namespace detail
+
+struct DataItem::Tagged {
+  uint64_t tag;
+  DataItem item;
+};
+
+/**
+ * @brief Payload of a map item: the entries in the order they were decoded
+ * or inserted, every key once.
+ */
+struct DataItem::Table {
+  Map entries;
+  // built by the first lookup that needs it and published atomically, so
+  // that concurrent const lookups are safe;
+  mutable std::atomic<detail::map_index *> index;
+
+  Table() : index(nullptr) {}
+  Table(const Table &other) : entries(other.entries), index(nullptr) {}
+  Table &operator=(const Table &) = delete;
+  ~Table() { delete index.load(std::memory_order_relaxed); }
+
+  /**
+   * @return position of `key`, or entries.size(). Small maps are scanned,
+   * larger ones go through the index.
+   */
+  size_t find(const DataItem &key) const;
+  /**
+   * @brief Add an entry for a key that is not in the map yet.
+   * @return its position.
+   */
+  size_t append(DataItem &&key, DataItem &&value);
+  /**
+   * @brief Set `key` to `value` unless the key is already there.
+   * @return whether the entry was added.
+   */
+  bool insert(DataItem &&key, DataItem &&value);
+
+  bool equals(const Table &other) const;
+  bool less(const Table &other) const;
+
+  detail::map_index &indexed() const;
+  void drop_index() {
+    delete index.exchange(nullptr, std::memory_order_relaxed);
+  }
+};
+
+} // namespace cbor
@@ -0,0 +1,514 @@
+#include "document.hpp"
+#include "detail.hpp"
+
+#include <new>
+#include <stdexcept>
+
+namespace cbor {
+
+static const Node undefined_node;
+
+/* ----------------------- arena ----------------------- */
+Arena::Arena(size_t block_size) : block_size_(block_size ? block_size : 1) {}
+
+Arena::~Arena() {
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    delete[] blocks_[i].data;
+  }
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+  for (; current_ < blocks_.size(); ++current_, used_ = 0) {
+    Block &block = blocks_[current_];
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+    uintptr_t start = (base + used_ + align - 1) & ~uintptr_t(align - 1);
+    if (start + size <= base + block.size) {
+      used_ = start + size - base;
+      return reinterpret_cast<void *>(start);
+    }
+  }
+  // grow geometrically so that a large message needs few blocks;
+  size_t block_size = blocks_.empty() ? block_size_ : blocks_.back().size * 2;
+  if (block_size < size + align) {
+    block_size = size + align;
+  }
+  Block block = {new char[block_size], block_size};
+  blocks_.push_back(block);
+  current_ = blocks_.size() - 1;
+  used_ = 0;
+  return allocate(size, align);
+}
+
+void Arena::reset() {
+  current_ = 0;
+  used_ = 0;
+}
+
+size_t Arena::capacity() const {
+  size_t total = 0;
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    total += blocks_[i].size;
+  }
+  return total;
+}
+
+/* ----------------------- node ----------------------- */
+bool Node::is_bool() const {
+  return type_ == type_t::Simple &&
+         (value_ == simple::False || value_ == simple::True);
+}
+bool Node::is_null() const {
+  return type_ == type_t::Simple && value_ == simple::Null;
+}
+bool Node::is_undefined() const {
+  return type_ == type_t::Simple && value_ == simple::Undefined;
+}
+
+size_t Node::size() const {
+  switch (type_) {
+  case type_t::Array:
+  case type_t::Map:
+    return size_t(value_);
+  default:
+    return 0;
+  }
+}
+
+const Node &Node::at(size_t index) const {
+  if (type_ != type_t::Array || index >= value_) {
+    throw std::out_of_range("cbor::Node::at");
+  }
+  return items_[index];
+}
+
+static const Node &find(const Node &map, const char *key, size_t length) {
+  for (Node::iterator it = map.begin(); it != map.end(); ++it) {
+    const Node &k = it.key();
+    if (k.is_string() && k.length() == length &&
+        memcmp(k.data(), key, length) == 0) {
+      return it.value();
+    }
+  }
+  return undefined_node;
+}
+
+const Node &Node::operator[](const char *key) const {
+  if (type_ != type_t::Map) {
+    return undefined_node;
+  }
+  return find(*this, key, strlen(key));
+}
+
+const Node &Node::operator[](const std::string &key) const {
+  if (type_ != type_t::Map) {
+    return undefined_node;
+  }
+  return find(*this, key.data(), key.size());
+}
+
+const Node &Node::operator[](const DataItem &key) const {
+  if (type_ != type_t::Map) {
+    return undefined_node;
+  }
+  if (key.is_string()) {
+    std::string k = key;
+    return find(*this, k.data(), k.size());
+  }
+  for (iterator it = begin(); it != end(); ++it) {
+    if (it.key() == key) {
+      return it.value();
+    }
+  }
+  return undefined_node;
+}
+
+Node::iterator Node::begin() const {
+  switch (type_) {
+  case type_t::Array:
+    return iterator(items_, 1);
+  case type_t::Map:
+    return iterator(items_, 2);
+  default:
+    return iterator(nullptr, 0);
+  }
+}
+
+Node::iterator Node::end() const {
+  switch (type_) {
+  case type_t::Array:
+    return iterator(items_ + value_, 1);
+  case type_t::Map:
+    return iterator(items_ + 2 * value_, 2);
+  default:
+    return iterator(nullptr, 0);
+  }
+}
+
+uint64_t Node::tag() const { return type_ == type_t::Tagged ? value_ : 0; }
+
+const Node &Node::child() const {
+  return type_ == type_t::Tagged ? *items_ : undefined_node;
+}
+
+const char *Node::data() const {
+  return type_ == type_t::String || type_ == type_t::Binary ? data_ : nullptr;
+}
+
+size_t Node::length() const {
+  return type_ == type_t::String || type_ == type_t::Binary ? size_t(value_)
+                                                            : 0;
+}
+
+uint64_t Node::to_unsigned() const {
+  switch (type_) {
+  case type_t::Unsigned:
+    return value_;
+  case type_t::Negative:
+    return ~value_;
+  case type_t::Tagged:
+    return items_->to_unsigned();
+  case type_t::Float:
+    return float_;
+  default:
+    return 0;
+  }
+}
+
+int64_t Node::to_signed() const {
+  switch (type_) {
+  case type_t::Unsigned:
+    return int64_t(value_);
+  case type_t::Negative:
+    return -1 - int64_t(value_);
+  case type_t::Tagged:
+    return items_->to_signed();
+  case type_t::Float:
+    return float_;
+  default:
+    return 0;
+  }
+}
+
+double Node::to_float() const {
+  switch (type_) {
+  case type_t::Unsigned:
+    return double(value_);
+  case type_t::Negative:
+    return -1.0 - double(value_);
+  case type_t::Tagged:
+    return items_->to_float();
+  case type_t::Float:
+    return float_;
+  default:
+    return 0.0;
+  }
+}
+
+Node::operator bool() const {
+  switch (type_) {
+  case type_t::Tagged:
+    return bool(*items_);
+  case type_t::Simple:
+    return value_ == simple::True;
+  default:
+    return false;
+  }
+}
+
+Node::operator std::vector<uint8_t>() const {
+  switch (type_) {
+  case type_t::Binary:
+    return std::vector<uint8_t>(reinterpret_cast<const uint8_t *>(data_),
+                                reinterpret_cast<const uint8_t *>(data_) +
+                                    value_);
+  case type_t::Tagged:
+    return items_->operator std::vector<uint8_t>();
+  default:
+    return std::vector<uint8_t>();
+  }
+}
+
+Node::operator std::string() const {
+  switch (type_) {
+  case type_t::String:
+    return std::string(data_, size_t(value_));
+  case type_t::Tagged:
+    return items_->operator std::string();
+  default:
+    return std::string();
+  }
+}
+
+Node::operator cbor::simple() const {
+  switch (type_) {
+  case type_t::Tagged:
+    return items_->operator cbor::simple();
+  case type_t::Simple:
+    return simple(value_);
+  default:
+    return simple::Undefined;
+  }
+}
+
+bool Node::operator==(const DataItem &other) const {
+  if (type_ != other.type()) {
+    return false;
+  }
+  switch (type_) {
+  case type_t::Unsigned:
+    return value_ == uint64_t(other);
+  case type_t::Negative:
+    return value_ == ~uint64_t(other);
+  case type_t::Float: {
+    double d = other;
+    return memcmp(&d, &float_, sizeof(d)) == 0;
+  }
+  case type_t::Simple:
+    return value_ == uint64_t(simple(other));
+  case type_t::String: {
+    std::string s = other;
+    return s.size() == value_ && memcmp(s.data(), data_, s.size()) == 0;
+  }
+  case type_t::Binary: {
+    std::vector<uint8_t> b = other.operator std::vector<uint8_t>();
+    return b.size() == value_ &&
+           (b.empty() || memcmp(b.data(), data_, b.size()) == 0);
+  }
+  default:
+    return to_item() == other;
+  }
+}
+
+DataItem Node::to_item() const {
+  switch (type_) {
+  case type_t::Unsigned:
+    return DataItem(value_);
+  case type_t::Negative:
+    return DataItem::negative(value_);
+  case type_t::Binary:
+    return DataItem(operator std::vector<uint8_t>());
+  case type_t::String:
+    return DataItem(operator std::string());
+  case type_t::Array: {
+    std::vector<DataItem> array;
+    array.reserve(size_t(value_));
+    for (iterator it = begin(); it != end(); ++it) {
+      array.push_back(it->to_item());
+    }
+    return DataItem(array);
+  }
+  case type_t::Map: {
+    DataItem map = cbor::map();
+    for (iterator it = begin(); it != end(); ++it) {
+      // the first of repeated keys wins, as in find() and decode();
+      DataItem key = it.key().to_item();
+      if (map.find(key) == nullptr) {
+        map[key] = it.value().to_item();
+      }
+    }
+    return map;
+  }
+  case type_t::Tagged:
+    return DataItem::tagged(value_, items_->to_item());
+  case type_t::Float:
+    return DataItem(float_);
+  case type_t::Simple:
+    return DataItem(simple(value_));
+  }
+  return DataItem();
+}
+
+/* ----------------------- document ----------------------- */
+Document::Document(size_t block_size)
+    : arena_(block_size), root_(&undefined_node) {}
+
+bool Document::parse(const uint8_t *data, size_t size,
+                     const decode_options &options) {
+  reset();
+  options_ = options;
+  Node *root = new (arena_.allocate_array<Node>(1)) Node();
+  const uint8_t *pos = data;
+  if (size == 0 || !parse_node(pos, data + size, *root) ||
+      pos != data + size) {
+    reset();
+    return false;
+  }
+  root_ = root;
+  return true;
+}
+
+bool Document::parse(const std::vector<uint8_t> &data,
+                     const decode_options &options) {
+  return parse(data.data(), data.size(), options);
+}
+
+void Document::reset() {
+  arena_.reset();
+  scratch_.clear();
+  root_ = &undefined_node;
+}
+
+bool Document::parse_node(const uint8_t *&pos, const uint8_t *end,
+                          Node &node) {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  size_t head = detail::read_head(pos, end, major, minor, value);
+  if (head == 0 || (minor > 27 && minor < 31)) {
+    return false;
+  }
+  const uint8_t *p = pos + head;
+  switch (major) {
+  case major::Unsigned:
+  case major::Negative:
+    if (minor == 31) {
+      return false;
+    }
+    node.type_ = major == major::Unsigned ? type_t::Unsigned : type_t::Negative;
+    node.value_ = value;
+    break;
+  case major::ByteString:
+  case major::TextString: {
+    node.type_ = major == major::ByteString ? type_t::Binary : type_t::String;
+    // every chunk of a text string must be valid UTF-8 by itself;
+    bool check = options_.strict_utf8 && major == major::TextString;
+    if (minor != 31) {
+      if (value > uint64_t(end - p) ||
+          (check && !is_utf8(reinterpret_cast<const char *>(p), value))) {
+        return false;
+      }
+      if (options_.borrow) {
+        node.data_ = reinterpret_cast<const char *>(p);
+      } else {
+        char *data = arena_.allocate_array<char>(size_t(value));
+        memcpy(data, p, size_t(value));
+        node.data_ = data;
+      }
+      node.value_ = value;
+      p += value;
+      break;
+    }
+    // size the chunks first so the string takes one arena allocation;
+    uint64_t total = 0;
+    const uint8_t *q = p;
+    while (q != end && *q != 0xff) {
+      int chunk_major = 0;
+      int chunk_minor = 0;
+      size_t n = detail::read_head(q, end, chunk_major, chunk_minor, value);
+      if (n == 0 || chunk_major != major || chunk_minor > 27 ||
+          value > uint64_t(end - q - n) ||
+          (check &&
+           !is_utf8(reinterpret_cast<const char *>(q + n), size_t(value)))) {
+        return false;
+      }
+      q += n + value;
+      total += value;
+    }
+    if (q == end) {
+      return false;
+    }
+    char *data = arena_.allocate_array<char>(size_t(total));
+    node.data_ = data;
+    node.value_ = total;
+    while (p != q) {
+      int chunk_major = 0;
+      int chunk_minor = 0;
+      p += detail::read_head(p, end, chunk_major, chunk_minor, value);
+      memcpy(data, p, size_t(value));
+      data += value;
+      p += value;
+    }
+    ++p;
+    break;
+  }
+  case major::Array:
+  case major::Map:
+    node.type_ = major == major::Array ? type_t::Array : type_t::Map;
+    if (!parse_children(p, end, node, value, minor == 31,
+                        major == major::Array ? 1 : 2)) {
+      return false;
+    }
+    break;
+  case major::Tag: {
+    if (minor == 31) {
+      return false;
+    }
+    Node *child = new (arena_.allocate_array<Node>(1)) Node();
+    node.type_ = type_t::Tagged;
+    node.value_ = value;
+    node.items_ = child;
+    if (!parse_node(p, end, *child)) {
+      return false;
+    }
+    break;
+  }
+  case major::Simple:
+    if (minor == 31) {
+      return false;
+    }
+    if (minor >= 25) {
+      node.type_ = type_t::Float;
+      node.float_ = detail::decode_float(minor, value);
+    } else {
+      node.type_ = type_t::Simple;
+      node.value_ = value;
+    }
+    break;
+  }
+  pos = p;
+  return true;
+}
+
+bool Document::parse_children(const uint8_t *&pos, const uint8_t *end,
+                              Node &node, uint64_t count, bool indefinite,
+                              size_t width) {
+  const uint8_t *p = pos;
+  if (!indefinite) {
+    // every element takes at least one byte;
+    if (count > uint64_t(end - p) / width) {
+      return false;
+    }
+    size_t n = size_t(count) * width;
+    Node *items = arena_.allocate_array<Node>(n);
+    for (size_t i = 0; i < n; ++i) {
+      new (&items[i]) Node();
+      if (!parse_node(p, end, items[i])) {
+        return false;
+      }
+    }
+    node.items_ = items;
+    node.value_ = count;
+    pos = p;
+    return true;
+  }
+  size_t mark = scratch_.size();
+  for (;;) {
+    if (p == end) {
+      return false;
+    }
+    if (*p == 0xff) {
+      if ((scratch_.size() - mark) % width != 0) {
+        return false;
+      }
+      ++p;
+      break;
+    }
+    Node child;
+    if (!parse_node(p, end, child)) {
+      return false;
+    }
+    scratch_.push_back(child);
+  }
+  size_t n = scratch_.size() - mark;
+  Node *items = arena_.allocate_array<Node>(n);
+  if (n != 0) {
+    memcpy(static_cast<void *>(items), &scratch_[mark], n * sizeof(Node));
+  }
+  scratch_.resize(mark);
+  node.items_ = items;
+  node.value_ = n / width;
+  pos = p;
+  return true;
+}
+
+} // namespace cbor
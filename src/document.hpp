@@ -0,0 +1,252 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Monotonic allocator: hands out memory by bumping a pointer and only
+ * gives it back all at once through reset() or destruction.
+ */
+class Arena {
+public:
+  explicit Arena(size_t block_size = 4096);
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size, size_t align = alignof(uint64_t));
+
+  template <typename T> T *allocate_array(size_t count) {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  /**
+   * @brief Forget every allocation but keep the blocks for reuse.
+   */
+  void reset();
+
+  /**
+   * @brief Total bytes reserved from the system.
+   */
+  size_t capacity() const;
+
+private:
+  struct Block {
+    char *data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  size_t current_ = 0;
+  size_t used_ = 0;
+  size_t block_size_;
+};
+
+/**
+ * @brief Read-only data item whose payload lives in a Document's arena.
+ * Nodes are trivially destructible and are only valid while the owning
+ * Document is neither reset nor destroyed.
+ */
+class Node {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = Node;
+    using pointer = const Node *;
+    using reference = const Node &;
+
+    iterator(const Node *pos, size_t stride) : pos_(pos), stride_(stride) {}
+
+    // for map iteration;
+    reference key() const { return pos_[0]; }
+    reference value() const { return pos_[1]; }
+
+    reference operator*() const { return *pos_; }
+    pointer operator->() const { return pos_; }
+
+    iterator &operator++() {
+      pos_ += stride_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      pos_ += stride_;
+      return tmp;
+    }
+
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a.pos_ == b.pos_;
+    }
+    friend bool operator!=(const iterator &a, const iterator &b) {
+      return a.pos_ != b.pos_;
+    }
+
+  private:
+    const Node *pos_;
+    size_t stride_;
+  };
+
+  Node() : type_(type_t::Simple), value_(simple::Undefined), items_(nullptr) {}
+
+  type_t type() const { return type_; }
+
+  bool is_unsigned() const { return type_ == type_t::Unsigned; }
+  bool is_int() const {
+    return type_ == type_t::Unsigned || type_ == type_t::Negative;
+  }
+  bool is_binary() const { return type_ == type_t::Binary; }
+  bool is_string() const { return type_ == type_t::String; }
+  bool is_array() const { return type_ == type_t::Array; }
+  bool is_map() const { return type_ == type_t::Map; }
+  bool is_tagged() const { return type_ == type_t::Tagged; }
+  bool is_simple() const { return type_ == type_t::Simple; }
+  bool is_bool() const;
+  bool is_null() const;
+  bool is_undefined() const;
+  bool is_float() const { return type_ == type_t::Float; }
+  bool is_number() const { return is_int() || is_float(); }
+
+  /**
+   * @brief Number of elements of an array or pairs of a map, 0 otherwise.
+   */
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  const Node &at(size_t index) const;
+
+  /**
+   * @brief Look up a map entry, an undefined node is returned when the key
+   * is missing or this is not a map.
+   */
+  const Node &operator[](const char *key) const;
+  const Node &operator[](const std::string &key) const;
+  const Node &operator[](const DataItem &key) const;
+
+  iterator begin() const;
+  iterator end() const;
+
+  uint64_t tag() const;
+  const Node &child() const;
+
+  /**
+   * @brief Bytes of a text or byte string, not NUL terminated.
+   */
+  const char *data() const;
+  size_t length() const;
+  string_view as_string_view() const { return string_view(data(), length()); }
+  bytes_view as_bytes_view() const {
+    return bytes_view(reinterpret_cast<const uint8_t *>(data()), length());
+  }
+
+  operator uint8_t() const { return to_unsigned(); }
+  operator uint16_t() const { return to_unsigned(); }
+  operator uint32_t() const { return to_unsigned(); }
+  operator uint64_t() const { return to_unsigned(); }
+
+  operator bool() const;
+  operator int8_t() const { return to_signed(); }
+  operator int16_t() const { return to_signed(); }
+  operator int32_t() const { return to_signed(); }
+  operator int64_t() const { return to_signed(); }
+
+  operator float() const { return to_float(); }
+  operator double() const { return to_float(); }
+
+  operator std::vector<uint8_t>() const;
+  operator std::string() const;
+  operator cbor::simple() const;
+
+  bool operator==(const DataItem &other) const;
+  bool operator!=(const DataItem &other) const { return !(*this == other); }
+
+  /**
+   * @brief Deep copy into a self-contained DataItem.
+   */
+  DataItem to_item() const;
+  std::string dump(int indent = 2) const { return to_item().dump(indent); }
+
+  friend class Document;
+
+private:
+  type_t type_;
+  // integer, simple value, tag, string length or element count;
+  union {
+    uint64_t value_;
+    double float_;
+  };
+  union {
+    const char *data_;
+    const Node *items_;
+  };
+
+  uint64_t to_unsigned() const;
+  int64_t to_signed() const;
+  double to_float() const;
+};
+
+/**
+ * @brief Owns the nodes, strings and containers of one decoded message in a
+ * single arena, so that destroying or resetting it is O(1) regardless of the
+ * size of the tree.
+ */
+class Document {
+public:
+  explicit Document(size_t block_size = 4096);
+
+  Document(const Document &) = delete;
+  Document &operator=(const Document &) = delete;
+
+  /**
+   * @brief Decode exactly one data item, replacing the current tree.
+   * @return false if the input is malformed, truncated or has trailing
+   * bytes, the document is then empty.
+   * With decode_options::borrow, definite-length strings point into `data`
+   * instead of the arena.
+   */
+  bool parse(const uint8_t *data, size_t size,
+             const decode_options &options = decode_options());
+  bool parse(const std::vector<uint8_t> &data,
+             const decode_options &options = decode_options());
+
+  /**
+   * @brief Drop the tree and recycle the arena for the next message.
+   */
+  void reset();
+
+  const Node &root() const { return *root_; }
+  const Arena &arena() const { return arena_; }
+
+  type_t type() const { return root_->type(); }
+  size_t size() const { return root_->size(); }
+  const Node &at(size_t index) const { return root_->at(index); }
+  const Node &operator[](const char *key) const { return (*root_)[key]; }
+  const Node &operator[](const std::string &key) const {
+    return (*root_)[key];
+  }
+  const Node &operator[](const DataItem &key) const { return (*root_)[key]; }
+  Node::iterator begin() const { return root_->begin(); }
+  Node::iterator end() const { return root_->end(); }
+
+private:
+  Arena arena_;
+  const Node *root_;
+  // children of indefinite-length containers are staged here until their
+  // count is known; kept across parses so it stops allocating;
+  std::vector<Node> scratch_;
+  decode_options options_;
+
+  bool parse_node(const uint8_t *&pos, const uint8_t *end, Node &node);
+  bool parse_children(const uint8_t *&pos, const uint8_t *end, Node &node,
+                      uint64_t count, bool indefinite, size_t width);
+};
+
+} // namespace cbor
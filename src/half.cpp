@@ -0,0 +1,160 @@
+#include "detail.hpp"
+
+#if defined(CBOR_X86)
+#include <immintrin.h>
+#elif defined(CBOR_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cbor {
+
+namespace detail {
+
+namespace {
+
+/* ----------------------- tables ----------------------- */
+// Single precision bits of the half-precision significand `i`, which for
+// subnormals is normalized here;
+uint32_t subnormal_bits(uint32_t i) {
+  uint32_t mantissa = i << 13;
+  uint32_t exponent = 0;
+  while ((mantissa & 0x800000) == 0) {
+    exponent -= 0x800000;
+    mantissa <<= 1;
+  }
+  return (mantissa & ~0x800000u) | (exponent + 0x38800000);
+}
+
+// The bits of a half are mantissa[offset[h >> 10] + (h & 0x3ff)] plus
+// exponent[h >> 10], with no branch on the kind of value;
+half_tables make_half_tables() {
+  half_tables t;
+  t.mantissa[0] = 0;
+  for (uint32_t i = 1; i < 1024; ++i) {
+    t.mantissa[i] = subnormal_bits(i);
+  }
+  for (uint32_t i = 1024; i < 2048; ++i) {
+    t.mantissa[i] = 0x38000000 + ((i - 1024) << 13);
+  }
+  for (uint32_t i = 0; i < 64; ++i) {
+    uint32_t sign = i < 32 ? 0 : 0x80000000u;
+    uint32_t e = i & 31;
+    t.exponent[i] = sign | (e == 31 ? 0x47800000 : e << 23);
+    t.offset[i] = e == 0 ? 0 : 1024;
+  }
+  return t;
+}
+
+/* ----------------------- kernels ----------------------- */
+typedef void (*halves_kernel)(float *out, const uint16_t *in, size_t count);
+typedef void (*floats_kernel)(uint16_t *out, const float *in, size_t count);
+
+void halves_scalar(float *out, const uint16_t *in, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = half_to_float(in[i]);
+  }
+}
+
+void floats_scalar(uint16_t *out, const float *in, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = float_to_half(in[i]);
+  }
+}
+
+#if defined(CBOR_X86)
+CBOR_TARGET("avx,f16c")
+void halves_f16c(float *out, const uint16_t *in, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+  // the tail goes through a padded block as well;
+  if (i != count) {
+    uint16_t h[8] = {0};
+    float f[8];
+    memcpy(h, in + i, (count - i) * sizeof(h[0]));
+    _mm256_storeu_ps(f, _mm256_cvtph_ps(_mm_loadu_si128(
+                            reinterpret_cast<const __m128i *>(h))));
+    memcpy(out + i, f, (count - i) * sizeof(f[0]));
+  }
+}
+
+CBOR_TARGET("avx,f16c")
+void floats_f16c(uint16_t *out, const float *in, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), 0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), h);
+  }
+  if (i != count) {
+    float f[8] = {0};
+    uint16_t h[8];
+    memcpy(f, in + i, (count - i) * sizeof(f[0]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(h),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(f), 0));
+    memcpy(out + i, h, (count - i) * sizeof(h[0]));
+  }
+}
+#endif // CBOR_X86
+
+#if defined(CBOR_NEON)
+void halves_neon(float *out, const uint16_t *in, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+  }
+  halves_scalar(out + i, in + i, count - i);
+}
+
+void floats_neon(uint16_t *out, const float *in, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+  }
+  floats_scalar(out + i, in + i, count - i);
+}
+#endif // CBOR_NEON
+
+halves_kernel select_halves_kernel() {
+#if defined(CBOR_X86)
+  if (has_f16c()) {
+    return halves_f16c;
+  }
+#elif defined(CBOR_NEON)
+  return halves_neon;
+#endif
+  return halves_scalar;
+}
+
+floats_kernel select_floats_kernel() {
+#if defined(CBOR_X86)
+  if (has_f16c()) {
+    return floats_f16c;
+  }
+#elif defined(CBOR_NEON)
+  return floats_neon;
+#endif
+  return floats_scalar;
+}
+
+} // namespace
+
+const half_tables &half_table() {
+  static const half_tables tables = make_half_tables();
+  return tables;
+}
+
+void halves_to_floats(float *out, const uint16_t *in, size_t count) {
+  static const halves_kernel kernel = select_halves_kernel();
+  kernel(out, in, count);
+}
+
+void floats_to_halves(uint16_t *out, const float *in, size_t count) {
+  static const floats_kernel kernel = select_floats_kernel();
+  kernel(out, in, count);
+}
+
+} // namespace detail
+
+} // namespace cbor
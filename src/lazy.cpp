@@ -0,0 +1,270 @@
+#include "lazy.hpp"
+#include "detail.hpp"
+
+#include <stdexcept>
+
+namespace cbor {
+
+static const LazyItem undefined_item;
+
+LazyItem::LazyItem()
+    : data_(nullptr), end_(nullptr), next_(nullptr), remaining_(0),
+      started_(false), indefinite_(false) {}
+
+LazyItem::LazyItem(const uint8_t *data, size_t size)
+    : data_(data), end_(data + size), next_(nullptr), remaining_(0),
+      started_(false), indefinite_(false) {}
+
+LazyItem::LazyItem(const std::vector<uint8_t> &data)
+    : LazyItem(data.data(), data.size()) {}
+
+bool LazyItem::head(int &major, int &minor, uint64_t &value) const {
+  return data_ != nullptr &&
+         detail::read_head(data_, end_, major, minor, value) != 0 &&
+         !(minor > 27 && minor < 31);
+}
+
+type_t LazyItem::type() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  if (!head(major, minor, value)) {
+    return type_t::Simple;
+  }
+  switch (major) {
+  case major::Unsigned:
+    return type_t::Unsigned;
+  case major::Negative:
+    return type_t::Negative;
+  case major::ByteString:
+    return type_t::Binary;
+  case major::TextString:
+    return type_t::String;
+  case major::Array:
+    return type_t::Array;
+  case major::Map:
+    return type_t::Map;
+  case major::Tag:
+    return type_t::Tagged;
+  default:
+    return minor >= 25 && minor <= 27 ? type_t::Float : type_t::Simple;
+  }
+}
+
+bool LazyItem::is_null() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  return head(major, minor, value) && major == major::Simple &&
+         minor == simple::Null;
+}
+
+bool LazyItem::is_undefined() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  return !head(major, minor, value) ||
+         (major == major::Simple && minor == simple::Undefined);
+}
+
+// Makes sure children_[index] exists, locating the children in front of it
+// by their heads, and returns false if there is no such child.
+bool LazyItem::locate(size_t index) const {
+  if (index < children_.size()) {
+    return true;
+  }
+  if (!started_) {
+    started_ = true;
+    int major = 0;
+    int minor = 0;
+    uint64_t value = 0;
+    size_t n = data_ == nullptr
+                   ? 0
+                   : detail::read_head(data_, end_, major, minor, value);
+    if (n == 0 || (minor > 27 && minor != 31)) {
+      return false;
+    }
+    switch (major) {
+    case major::Array:
+      remaining_ = value;
+      break;
+    case major::Map:
+      remaining_ = value * 2;
+      break;
+    case major::Tag:
+      if (minor == 31) {
+        return false;
+      }
+      remaining_ = 1;
+      break;
+    default:
+      return false;
+    }
+    indefinite_ = minor == 31;
+    next_ = data_ + n;
+  }
+  while (index >= children_.size()) {
+    if (next_ == nullptr || next_ == end_) {
+      return false;
+    }
+    if (indefinite_ ? *next_ == 0xff : remaining_ == 0) {
+      return false;
+    }
+    const uint8_t *after = detail::skip_item(next_, end_);
+    if (after == nullptr) {
+      next_ = nullptr;
+      return false;
+    }
+    children_.push_back(LazyItem(next_, after - next_));
+    next_ = after;
+    --remaining_;
+  }
+  return true;
+}
+
+const LazyItem &LazyItem::child_at(size_t index) const {
+  return locate(index) ? children_[index] : undefined_item;
+}
+
+size_t LazyItem::size() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  if (!head(major, minor, value) ||
+      (major != major::Array && major != major::Map)) {
+    return 0;
+  }
+  if (minor != 31) {
+    return size_t(value);
+  }
+  size_t count = children_.size();
+  while (locate(count)) {
+    ++count;
+  }
+  return major == major::Map ? count / 2 : count;
+}
+
+const LazyItem &LazyItem::at(size_t index) const {
+  if (!is_array() || !locate(index)) {
+    throw std::out_of_range("cbor::LazyItem::at");
+  }
+  return children_[index];
+}
+
+bool LazyItem::key_equals(const char *key, size_t size) const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  if (!head(major, minor, value) || major != major::TextString) {
+    return false;
+  }
+  if (minor == 31) {
+    std::string s = *this;
+    return s.size() == size && memcmp(s.data(), key, size) == 0;
+  }
+  string_view view = as_string_view();
+  return view.size() == size && memcmp(view.data(), key, size) == 0;
+}
+
+const LazyItem &LazyItem::find(const char *key, size_t size) const {
+  if (!is_map()) {
+    return undefined_item;
+  }
+  for (size_t i = 0; locate(i + 1); i += 2) {
+    if (children_[i].key_equals(key, size)) {
+      return children_[i + 1];
+    }
+  }
+  return undefined_item;
+}
+
+const LazyItem &LazyItem::operator[](const char *key) const {
+  return find(key, strlen(key));
+}
+
+const LazyItem &LazyItem::operator[](const std::string &key) const {
+  return find(key.data(), key.size());
+}
+
+const LazyItem &LazyItem::operator[](const DataItem &key) const {
+  if (key.is_string()) {
+    string_view view = key.as_string_view();
+    return find(view.data(), view.size());
+  }
+  if (!is_map()) {
+    return undefined_item;
+  }
+  for (size_t i = 0; locate(i + 1); i += 2) {
+    if (children_[i].to_item() == key) {
+      return children_[i + 1];
+    }
+  }
+  return undefined_item;
+}
+
+LazyItem::iterator LazyItem::begin() const {
+  switch (type()) {
+  case type_t::Array:
+    return iterator(this, 0, 1);
+  case type_t::Map:
+    return iterator(this, 0, 2);
+  default:
+    return end();
+  }
+}
+
+LazyItem::iterator LazyItem::end() const { return iterator(nullptr, 0, 1); }
+
+uint64_t LazyItem::tag() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  return head(major, minor, value) && major == major::Tag ? value : 0;
+}
+
+const LazyItem &LazyItem::child() const {
+  return is_tagged() ? child_at(0) : undefined_item;
+}
+
+bytes_view LazyItem::encoded() const {
+  const uint8_t *after =
+      data_ == nullptr ? nullptr : detail::skip_item(data_, end_);
+  return after == nullptr ? bytes_view() : bytes_view(data_, after - data_);
+}
+
+string_view LazyItem::as_string_view() const {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  size_t n = data_ == nullptr
+                 ? 0
+                 : detail::read_head(data_, end_, major, minor, value);
+  if (n == 0 || minor > 27 ||
+      (major != major::TextString && major != major::ByteString) ||
+      value > uint64_t(end_ - data_ - n)) {
+    return string_view();
+  }
+  return string_view(reinterpret_cast<const char *>(data_ + n), size_t(value));
+}
+
+bytes_view LazyItem::as_bytes_view() const {
+  string_view view = as_string_view();
+  return bytes_view(reinterpret_cast<const uint8_t *>(view.data()),
+                    view.size());
+}
+
+LazyItem::operator std::vector<uint8_t>() const {
+  return to_item().operator std::vector<uint8_t>();
+}
+
+LazyItem::operator std::string() const { return to_item(); }
+
+DataItem LazyItem::to_item(const decode_options &options) const {
+  DataItem item;
+  if (data_ != nullptr) {
+    item.read(data_, end_ - data_, options);
+  }
+  return item;
+}
+
+} // namespace cbor
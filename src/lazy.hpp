@@ -0,0 +1,174 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Data item that is decoded on demand from an encoded buffer.
+ *
+ * A LazyItem only records where its encoding starts. The children of an
+ * array, map or tag are located the first time they are reached through
+ * at(), operator[] or iteration, by scanning the heads of the siblings in
+ * front of them; subtrees that are never visited are skipped without being
+ * decoded. Located children are cached, so every child is found once.
+ *
+ * The buffer must stay alive and unchanged while the item is in use.
+ * Malformed regions read as undefined items; run cbor::validate() first
+ * when the input is untrusted and errors must be told apart.
+ */
+class LazyItem {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = LazyItem;
+    using pointer = const LazyItem *;
+    using reference = const LazyItem &;
+
+    iterator(const LazyItem *parent, size_t index, size_t stride)
+        : parent_(parent), index_(index), stride_(stride) {}
+
+    // for map iteration;
+    reference key() const { return parent_->child_at(index_); }
+    reference value() const { return parent_->child_at(index_ + 1); }
+
+    reference operator*() const { return parent_->child_at(index_); }
+    pointer operator->() const { return &parent_->child_at(index_); }
+
+    iterator &operator++() {
+      index_ += stride_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      index_ += stride_;
+      return tmp;
+    }
+
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a.at_end() == b.at_end() && (a.at_end() || a.index_ == b.index_);
+    }
+    friend bool operator!=(const iterator &a, const iterator &b) {
+      return !(a == b);
+    }
+
+  private:
+    const LazyItem *parent_;
+    size_t index_;
+    size_t stride_;
+
+    bool at_end() const {
+      return parent_ == nullptr || !parent_->locate(index_ + stride_ - 1);
+    }
+  };
+
+  LazyItem();
+  /**
+   * @brief Lazily view the data item at the start of [data, data + size).
+   */
+  LazyItem(const uint8_t *data, size_t size);
+  explicit LazyItem(const std::vector<uint8_t> &data);
+
+  type_t type() const;
+
+  bool is_unsigned() const { return type() == type_t::Unsigned; }
+  bool is_int() const {
+    return type() == type_t::Unsigned || type() == type_t::Negative;
+  }
+  bool is_binary() const { return type() == type_t::Binary; }
+  bool is_string() const { return type() == type_t::String; }
+  bool is_array() const { return type() == type_t::Array; }
+  bool is_map() const { return type() == type_t::Map; }
+  bool is_tagged() const { return type() == type_t::Tagged; }
+  bool is_simple() const { return type() == type_t::Simple; }
+  bool is_null() const;
+  bool is_undefined() const;
+  bool is_float() const { return type() == type_t::Float; }
+
+  /**
+   * @brief Number of elements of an array or pairs of a map, 0 otherwise.
+   * Indefinite-length containers are located in full to count them.
+   */
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  const LazyItem &at(size_t index) const;
+
+  /**
+   * @brief Look up a map entry, scanning only up to the matching key.
+   * An undefined item is returned when the key is missing.
+   */
+  const LazyItem &operator[](const char *key) const;
+  const LazyItem &operator[](const std::string &key) const;
+  const LazyItem &operator[](const DataItem &key) const;
+
+  iterator begin() const;
+  iterator end() const;
+
+  uint64_t tag() const;
+  const LazyItem &child() const;
+
+  /**
+   * @brief The encoded bytes of this item, found by scanning its heads.
+   */
+  bytes_view encoded() const;
+
+  /**
+   * @brief Bytes of a definite-length text or byte string, pointing into
+   * the buffer; empty for chunked strings, which operator std::string()
+   * and operator std::vector<uint8_t>() assemble.
+   */
+  string_view as_string_view() const;
+  bytes_view as_bytes_view() const;
+
+  operator uint8_t() const { return to_item(); }
+  operator uint16_t() const { return to_item(); }
+  operator uint32_t() const { return to_item(); }
+  operator uint64_t() const { return to_item(); }
+
+  operator bool() const { return to_item(); }
+  operator int8_t() const { return to_item(); }
+  operator int16_t() const { return to_item(); }
+  operator int32_t() const { return to_item(); }
+  operator int64_t() const { return to_item(); }
+
+  operator float() const { return to_item(); }
+  operator double() const { return to_item(); }
+
+  operator std::vector<uint8_t>() const;
+  operator std::string() const;
+  operator cbor::simple() const { return to_item(); }
+
+  /**
+   * @brief Fully decode this item and everything below it.
+   */
+  DataItem to_item(const decode_options &options = decode_options()) const;
+  std::string dump(int indent = 2) const { return to_item().dump(indent); }
+
+private:
+  const uint8_t *data_;
+  const uint8_t *end_;
+  // children located so far, a deque so that handed out references stay
+  // valid while more are appended;
+  mutable std::deque<LazyItem> children_;
+  mutable const uint8_t *next_;
+  mutable uint64_t remaining_;
+  mutable bool started_;
+  mutable bool indefinite_;
+
+  bool head(int &major, int &minor, uint64_t &value) const;
+  bool locate(size_t index) const;
+  const LazyItem &child_at(size_t index) const;
+  bool key_equals(const char *key, size_t size) const;
+  const LazyItem &find(const char *key, size_t size) const;
+};
+
+} // namespace cbor
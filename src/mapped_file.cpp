@@ -0,0 +1,195 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cbor {
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), open_(false) {
+#if defined(_WIN32)
+  file_ = INVALID_HANDLE_VALUE;
+  mapping_ = nullptr;
+#endif
+}
+
+MappedFile::MappedFile(const std::string &path) : MappedFile() { open(path); }
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept : MappedFile() {
+  move_from(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    move_from(other);
+  }
+  return *this;
+}
+
+void MappedFile::move_from(MappedFile &other) {
+  data_ = other.data_;
+  size_ = other.size_;
+  open_ = other.open_;
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.open_ = false;
+#if defined(_WIN32)
+  file_ = other.file_;
+  mapping_ = other.mapping_;
+  other.file_ = INVALID_HANDLE_VALUE;
+  other.mapping_ = nullptr;
+#endif
+}
+
+#if defined(_WIN32)
+/* ----------------------- win32 ----------------------- */
+bool MappedFile::open(const std::string &path) {
+  close();
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) ||
+      uint64_t(size.QuadPart) > uint64_t(SIZE_MAX)) {
+    close();
+    return false;
+  }
+  size_ = size_t(size.QuadPart);
+  open_ = true;
+  // an empty file cannot be mapped, and has nothing to map;
+  if (size_ == 0) {
+    return true;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ == nullptr) {
+    close();
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (data_ == nullptr) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  if (file_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  open_ = false;
+  file_ = INVALID_HANDLE_VALUE;
+  mapping_ = nullptr;
+}
+
+bool MappedFile::advise(advice hint, size_t offset, size_t length) const {
+  if (offset >= size_) {
+    return offset == 0 && open_;
+  }
+  if (length == 0 || length > size_ - offset) {
+    length = size_ - offset;
+  }
+#if _WIN32_WINNT >= 0x0602
+  if (hint == advice::WillNeed) {
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t *>(data_ + offset);
+    range.NumberOfBytes = length;
+    return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+  }
+#endif
+  (void)hint;
+  return true;
+}
+
+#else
+/* ----------------------- posix ----------------------- */
+bool MappedFile::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || uint64_t(info.st_size) > uint64_t(SIZE_MAX)) {
+    ::close(fd);
+    return false;
+  }
+  size_ = size_t(info.st_size);
+  // an empty file cannot be mapped, and has nothing to map;
+  if (size_ != 0) {
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<const uint8_t *>(data);
+  }
+  // the mapping keeps the file referenced;
+  ::close(fd);
+  open_ = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  open_ = false;
+}
+
+bool MappedFile::advise(advice hint, size_t offset, size_t length) const {
+  if (offset >= size_) {
+    return offset == 0 && open_;
+  }
+  if (length == 0 || length > size_ - offset) {
+    length = size_ - offset;
+  }
+  // madvise() takes whole pages;
+  size_t page = size_t(sysconf(_SC_PAGESIZE));
+  size_t start = offset / page * page;
+  int flag = MADV_NORMAL;
+  switch (hint) {
+  case advice::Normal:
+    flag = MADV_NORMAL;
+    break;
+  case advice::Sequential:
+    flag = MADV_SEQUENTIAL;
+    break;
+  case advice::Random:
+    flag = MADV_RANDOM;
+    break;
+  case advice::WillNeed:
+    flag = MADV_WILLNEED;
+    break;
+  }
+  return madvise(const_cast<uint8_t *>(data_ + start), offset - start + length,
+                 flag) == 0;
+}
+#endif
+
+} // namespace cbor
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace cbor {
+
+/**
+ * @brief Read-only memory mapping of a whole file, to decode in place.
+ *
+ * Pages are read by the OS when first touched, so opening even a very
+ * large file is cheap and only the parts that are decoded cost I/O. With
+ * decode_options::borrow, strings and byte strings point straight into
+ * the mapping and must not outlive it.
+ */
+class MappedFile {
+public:
+  /**
+   * @brief Expected access pattern, passed on to madvise() where available.
+   */
+  enum class advice : uint8_t {
+    Normal,
+    Sequential,
+    Random,
+    WillNeed,
+  };
+
+  MappedFile();
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  /**
+   * @brief Map `path`, replacing the current mapping.
+   * @return false if the file cannot be opened or mapped.
+   */
+  bool open(const std::string &path);
+  void close();
+
+  bool is_open() const { return open_; }
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  bytes_view bytes() const { return bytes_view(data_, size_); }
+
+  /**
+   * @brief Hint how [offset, offset + length) is about to be read; a
+   * `length` of 0 covers the rest of the file.
+   * @return false if the hint was rejected; hints the platform does not
+   * have are accepted and ignored.
+   */
+  bool advise(advice hint, size_t offset = 0, size_t length = 0) const;
+
+private:
+  const uint8_t *data_;
+  size_t size_;
+  bool open_;
+#if defined(_WIN32)
+  void *file_;
+  void *mapping_;
+#endif
+
+  void move_from(MappedFile &other);
+};
+
+} // namespace cbor
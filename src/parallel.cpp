@@ -0,0 +1,351 @@
+#include "parallel.hpp"
+#include "detail.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace cbor {
+
+namespace {
+
+unsigned thread_count(const parallel_options &options) {
+  unsigned threads = options.threads;
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return threads == 0 ? 1 : threads;
+}
+
+// Runs task(0) .. task(count - 1) on `threads` threads, the calling one
+// included; every thread takes the next index from a shared counter.
+template <typename Task>
+void run_parallel(unsigned threads, size_t count, Task &task) {
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads && i < count; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (size_t i = 0; i < pool.size(); ++i) {
+    pool[i].join();
+  }
+}
+
+// Number of tasks to split `items` into, several per thread so that the
+// load evens out when items differ in size;
+size_t task_count(size_t items, unsigned threads) {
+  size_t tasks = size_t(threads) * 8;
+  return tasks < items ? tasks : items;
+}
+
+// Offsets of the items of a sequence, with the end of the input last;
+bool find_items(const uint8_t *data, size_t size,
+                std::vector<size_t> &offsets) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  while (p != end) {
+    offsets.push_back(p - data);
+    p = detail::skip_item(p, end);
+    if (p == nullptr) {
+      return false;
+    }
+  }
+  offsets.push_back(size);
+  return true;
+}
+
+template <typename Sink> struct decode_task {
+  const uint8_t *data;
+  const std::vector<size_t> &offsets;
+  size_t tasks;
+  const decode_options &options;
+  Sink &sink;
+  std::atomic<bool> &failed;
+
+  void operator()(size_t task) {
+    size_t items = offsets.size() - 1;
+    size_t first = items * task / tasks;
+    size_t last = items * (task + 1) / tasks;
+    for (size_t i = first; i < last && !failed; ++i) {
+      DataItem item;
+      size_t size = offsets[i + 1] - offsets[i];
+      if (item.read(data + offsets[i], size, options) != size) {
+        failed = true;
+        return;
+      }
+      sink(i, item);
+    }
+  }
+};
+
+template <typename Sink>
+bool decode_items(const uint8_t *data, const std::vector<size_t> &offsets,
+                  const parallel_options &options, Sink &sink) {
+  size_t items = offsets.size() - 1;
+  unsigned threads = items < options.threshold ? 1 : thread_count(options);
+  size_t tasks = task_count(items, threads);
+  std::atomic<bool> failed(false);
+  decode_task<Sink> task = {data, offsets, tasks, options.decode, sink,
+                            failed};
+  run_parallel(threads, tasks, task);
+  return !failed;
+}
+
+struct store_sink {
+  std::vector<DataItem> &items;
+
+  void operator()(size_t index, DataItem &item) {
+    items[index] = std::move(item);
+  }
+};
+
+struct callback_sink {
+  const std::function<void(size_t, DataItem &)> &callback;
+
+  void operator()(size_t index, DataItem &item) { callback(index, item); }
+};
+
+} // namespace
+
+/* ----------------------- encoder ----------------------- */
+namespace detail {
+
+struct parallel_encoder {
+  // Containers are looked into for large ones this many levels down;
+  static const int max_depth = 3;
+
+  // One piece of the output: the head of a split container, one item
+  // encoded whole, or a run of `count` elements or entries of a split
+  // array or map;
+  struct segment {
+    uint8_t head[9];
+    size_t head_size;
+    const DataItem *item;
+    const DataItem *elements;
+    const Map::value_type *entries;
+    size_t count;
+    size_t size;
+  };
+
+  std::vector<segment> segments;
+  size_t threshold;
+  size_t runs;
+  bool split;
+
+  parallel_encoder(const parallel_options &options, unsigned threads)
+      : threshold(options.threshold), runs(size_t(threads) * 8),
+        split(false) {}
+
+  segment &add() {
+    segment s = {{0}, 0, nullptr, nullptr, nullptr, 0, 0};
+    segments.push_back(s);
+    return segments.back();
+  }
+
+  void add_head(int major, uint64_t value) {
+    segment &s = add();
+    s.head_size = write_head(s.head, major, value) - s.head;
+  }
+
+  void plan(const DataItem &item, int depth) {
+    size_t count = 0;
+    switch (item.type_) {
+    case type_t::Array:
+      count = item.array_->size();
+      break;
+    case type_t::Map:
+      count = item.map_->entries.size();
+      break;
+    default:
+      break;
+    }
+    if (count >= threshold && count > 1) {
+      split = true;
+      add_head(item.is_array() ? major::Array : major::Map, count);
+      size_t run = (count + runs - 1) / runs;
+      for (size_t first = 0; first < count; first += run) {
+        segment &s = add();
+        s.count = count - first < run ? count - first : run;
+        if (item.is_array()) {
+          s.elements = item.array_->data() + first;
+        } else {
+          s.entries = item.map_->entries.data() + first;
+        }
+      }
+      return;
+    }
+    if (count != 0 && depth < max_depth) {
+      if (item.is_array()) {
+        add_head(major::Array, count);
+        for (size_t i = 0; i < count; ++i) {
+          plan((*item.array_)[i], depth + 1);
+        }
+      } else {
+        add_head(major::Map, count);
+        for (Map::const_iterator it = item.map_->entries.begin();
+             it != item.map_->entries.end(); ++it) {
+          plan(it->first, depth + 1);
+          plan(it->second, depth + 1);
+        }
+      }
+      return;
+    }
+    add().item = &item;
+  }
+
+  static size_t measure(const segment &s) {
+    if (s.item != nullptr) {
+      return s.item->encoded_size();
+    }
+    size_t size = s.head_size;
+    if (s.elements != nullptr) {
+      for (size_t i = 0; i < s.count; ++i) {
+        size += s.elements[i].encoded_size();
+      }
+      return size;
+    }
+    for (size_t i = 0; i < s.count; ++i) {
+      size += s.entries[i].first.encoded_size() +
+              s.entries[i].second.encoded_size();
+    }
+    return size;
+  }
+
+  static uint8_t *write(const segment &s, uint8_t *p) {
+    if (s.item != nullptr) {
+      return s.item->write_to(p);
+    }
+    memcpy(p, s.head, s.head_size);
+    p += s.head_size;
+    if (s.elements != nullptr) {
+      for (size_t i = 0; i < s.count; ++i) {
+        p = s.elements[i].write_to(p);
+      }
+      return p;
+    }
+    for (size_t i = 0; i < s.count; ++i) {
+      p = s.entries[i].first.write_to(p);
+      p = s.entries[i].second.write_to(p);
+    }
+    return p;
+  }
+};
+
+} // namespace detail
+
+namespace {
+
+struct measure_task {
+  std::vector<detail::parallel_encoder::segment> &segments;
+
+  void operator()(size_t i) {
+    segments[i].size = detail::parallel_encoder::measure(segments[i]);
+  }
+};
+
+struct write_task {
+  const std::vector<detail::parallel_encoder::segment> &segments;
+  const std::vector<size_t> &offsets;
+  uint8_t *out;
+
+  void operator()(size_t i) {
+    detail::parallel_encoder::write(segments[i], out + offsets[i]);
+  }
+};
+
+struct buffer_task {
+  const std::vector<detail::parallel_encoder::segment> &segments;
+  std::vector<uint8_t> *buffers;
+
+  void operator()(size_t i) {
+    const detail::parallel_encoder::segment &s = segments[i];
+    std::vector<uint8_t> &buffer = buffers[i];
+    buffer.resize(detail::parallel_encoder::measure(s));
+    detail::parallel_encoder::write(s, buffer.data());
+  }
+};
+
+} // namespace
+
+void encode_parallel(const DataItem &item, std::vector<uint8_t> &out,
+                     const parallel_options &options) {
+  unsigned threads = thread_count(options);
+  detail::parallel_encoder encoder(options, threads);
+  if (threads > 1) {
+    encoder.plan(item, 0);
+  }
+  if (!encoder.split) {
+    item.write(out);
+    return;
+  }
+  std::vector<detail::parallel_encoder::segment> &segments =
+      encoder.segments;
+  measure_task measure = {segments};
+  run_parallel(threads, segments.size(), measure);
+  std::vector<size_t> offsets(segments.size());
+  size_t total = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    offsets[i] = total;
+    total += segments[i].size;
+  }
+  size_t base = out.size();
+  out.resize(base + total);
+  write_task write = {segments, offsets, out.data() + base};
+  run_parallel(threads, segments.size(), write);
+}
+
+void encode_parallel(const DataItem &item,
+                     std::vector<std::vector<uint8_t>> &buffers,
+                     const parallel_options &options) {
+  unsigned threads = thread_count(options);
+  detail::parallel_encoder encoder(options, threads);
+  if (threads > 1) {
+    encoder.plan(item, 0);
+  }
+  if (!encoder.split) {
+    buffers.push_back(std::vector<uint8_t>());
+    item.write(buffers.back());
+    return;
+  }
+  size_t base = buffers.size();
+  buffers.resize(base + encoder.segments.size());
+  buffer_task task = {encoder.segments, buffers.data() + base};
+  run_parallel(threads, encoder.segments.size(), task);
+}
+
+/* ----------------------- sequence decoder ----------------------- */
+bool decode_sequence(const uint8_t *data, size_t size,
+                     std::vector<DataItem> &items,
+                     const parallel_options &options) {
+  items.clear();
+  std::vector<size_t> offsets;
+  if (!find_items(data, size, offsets)) {
+    return false;
+  }
+  items.resize(offsets.size() - 1);
+  store_sink sink = {items};
+  if (!decode_items(data, offsets, options, sink)) {
+    items.clear();
+    return false;
+  }
+  return true;
+}
+
+bool decode_sequence_unordered(
+    const uint8_t *data, size_t size,
+    const std::function<void(size_t, DataItem &)> &callback,
+    const parallel_options &options) {
+  std::vector<size_t> offsets;
+  if (!find_items(data, size, offsets)) {
+    return false;
+  }
+  callback_sink sink = {callback};
+  return decode_items(data, offsets, options, sink);
+}
+
+} // namespace cbor
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Options for the multi-threaded decoders and encoders.
+ */
+struct parallel_options {
+  /**
+   * @brief Threads to use, the calling one included; 0 picks
+   * std::thread::hardware_concurrency().
+   */
+  unsigned threads = 0;
+  /**
+   * @brief Inputs with fewer items than this are handled on the calling
+   * thread, where starting workers would cost more than it saves.
+   */
+  size_t threshold = 1024;
+  decode_options decode;
+};
+
+/**
+ * @brief Decode an RFC 8742 sequence, the items of [data, data + size) back
+ * to back, in parallel.
+ *
+ * One pass over the heads finds where every item starts, then the workers
+ * take runs of items from a shared queue and decode them; runs are small
+ * enough that threads finishing early pick up the remaining work.
+ * @return false if any item is malformed or truncated, `items` is then
+ * empty. Otherwise `items` holds every item in input order.
+ */
+bool decode_sequence(const uint8_t *data, size_t size,
+                     std::vector<DataItem> &items,
+                     const parallel_options &options = parallel_options());
+
+/**
+ * @brief Like decode_sequence(), but hands every item to `callback` with its
+ * position in the sequence as soon as it is decoded, in no particular order.
+ * The callback runs concurrently on the worker threads and must not throw.
+ * @return false if any item is malformed or truncated; the callback is not
+ * called at all when the framing is broken, items already delivered are
+ * not taken back when a later one fails to decode.
+ */
+bool decode_sequence_unordered(
+    const uint8_t *data, size_t size,
+    const std::function<void(size_t, DataItem &)> &callback,
+    const parallel_options &options = parallel_options());
+
+/**
+ * @brief Append the encoding of `item` to `out`, byte for byte the same as
+ * DataItem::write(), splitting arrays and maps of at least
+ * parallel_options::threshold elements into runs encoded on separate
+ * threads.
+ *
+ * Containers are split where they are the item itself or sit in the few
+ * levels of small maps and arrays around it; their heads come from
+ * the known element counts. Every run is sized first, so that each thread
+ * writes straight to its final place in `out`. Items without such a
+ * container are encoded on the calling thread.
+ */
+void encode_parallel(const DataItem &item, std::vector<uint8_t> &out,
+                     const parallel_options &options = parallel_options());
+
+/**
+ * @brief Like encode_parallel(), but appends the encoding as a list of
+ * buffers, to be written out in order e.g. with writev(). Every run is
+ * encoded into a buffer of its own on its thread and is never copied.
+ */
+void encode_parallel(const DataItem &item,
+                     std::vector<std::vector<uint8_t>> &buffers,
+                     const parallel_options &options = parallel_options());
+
+} // namespace cbor
@@ -0,0 +1,196 @@
+#include "push_decoder.hpp"
+#include "detail.hpp"
+
+namespace cbor {
+
+PushDecoder::PushDecoder() { reset(); }
+
+void PushDecoder::reset() {
+  ready_.clear();
+  buffer_.clear();
+  stack_.clear();
+  pending_ = 0;
+  skip_ = 0;
+  head_size_ = 0;
+  head_need_ = 0;
+  context_ = -1;
+  in_item_ = false;
+  failed_ = false;
+}
+
+bool PushDecoder::fail() {
+  failed_ = true;
+  buffer_.clear();
+  return false;
+}
+
+bool PushDecoder::feed(const std::vector<uint8_t> &data) {
+  return feed(data.data(), data.size());
+}
+
+bool PushDecoder::feed(const uint8_t *data, size_t size) {
+  if (failed_) {
+    return false;
+  }
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  // first byte of the current item not yet copied into buffer_;
+  const uint8_t *mark = data;
+  while (p != end) {
+    if (skip_ != 0) {
+      size_t n = uint64_t(end - p) < skip_ ? size_t(end - p) : size_t(skip_);
+      p += n;
+      skip_ -= n;
+    } else if (head_size_ == head_need_) {
+      if (!in_item_) {
+        in_item_ = true;
+        pending_ = 1;
+        mark = p;
+      }
+      if (!begin_head(*p++)) {
+        return fail();
+      }
+    } else {
+      head_[head_size_++] = *p++;
+    }
+    if (head_size_ == head_need_ && head_need_ != 0) {
+      if (!end_head()) {
+        return fail();
+      }
+    }
+    if (in_item_ && skip_ == 0 && head_size_ == head_need_ && pending_ == 0 &&
+        stack_.empty()) {
+      if (!complete(mark, p)) {
+        return fail();
+      }
+      mark = p;
+    }
+  }
+  if (in_item_) {
+    buffer_.insert(buffer_.end(), mark, end);
+  }
+  return true;
+}
+
+// Starts the head of the next item or handles a break, recording in
+// context_ what the enclosing item expects.
+bool PushDecoder::begin_head(uint8_t initial) {
+  context_ = -1;
+  if (pending_ == 0) {
+    context_ = int(stack_.back() & 7);
+    if (initial == 0xff) {
+      if (context_ == detail::IndefiniteMapValue) {
+        return false;
+      }
+      pending_ = stack_.back() >> 3;
+      stack_.pop_back();
+      head_size_ = head_need_ = 0;
+      return true;
+    }
+    if (context_ == detail::IndefiniteMapKey ||
+        context_ == detail::IndefiniteMapValue) {
+      stack_.back() ^= detail::IndefiniteMapKey ^ detail::IndefiniteMapValue;
+    }
+  } else {
+    --pending_;
+  }
+  int minor = initial & 31;
+  if (minor > 27 && minor < 31) {
+    return false;
+  }
+  head_[0] = initial;
+  head_size_ = 1;
+  head_need_ =
+      uint8_t(minor >= 24 && minor <= 27 ? 1 + (1 << (minor - 24)) : 1);
+  return true;
+}
+
+bool PushDecoder::end_head() {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  detail::read_head(head_, head_ + head_size_, major, minor, value);
+  head_size_ = head_need_ = 0;
+  if (context_ == detail::IndefiniteBytes ||
+      context_ == detail::IndefiniteText) {
+    int chunk_major = context_ == detail::IndefiniteBytes ? major::ByteString
+                                                          : major::TextString;
+    if (major != chunk_major || minor == 31) {
+      return false;
+    }
+    skip_ = value;
+    return true;
+  }
+  // a count no input could ever satisfy would overflow the bookkeeping;
+  const uint64_t max_pending = uint64_t(1) << 56;
+  switch (major) {
+  case major::ByteString:
+  case major::TextString:
+    if (minor != 31) {
+      skip_ = value;
+      return true;
+    }
+    if (stack_.size() == detail::max_indefinite_depth) {
+      return false;
+    }
+    stack_.push_back(pending_ << 3 | (major == major::ByteString
+                                          ? detail::IndefiniteBytes
+                                          : detail::IndefiniteText));
+    pending_ = 0;
+    return true;
+  case major::Array:
+  case major::Map:
+    if (minor == 31) {
+      if (stack_.size() == detail::max_indefinite_depth) {
+        return false;
+      }
+      stack_.push_back(pending_ << 3 | (major == major::Array
+                                            ? detail::IndefiniteArray
+                                            : detail::IndefiniteMapKey));
+      pending_ = 0;
+      return true;
+    }
+    if (value > max_pending || pending_ + value * 2 > max_pending) {
+      return false;
+    }
+    pending_ += major == major::Map ? value * 2 : value;
+    return true;
+  case major::Tag:
+    if (minor == 31) {
+      return false;
+    }
+    ++pending_;
+    return true;
+  default:
+    return minor != 31;
+  }
+}
+
+bool PushDecoder::complete(const uint8_t *begin, const uint8_t *end) {
+  DataItem item;
+  if (buffer_.empty()) {
+    if (item.read(begin, end - begin) != size_t(end - begin)) {
+      return false;
+    }
+  } else {
+    buffer_.insert(buffer_.end(), begin, end);
+    if (item.read(buffer_.data(), buffer_.size()) != buffer_.size()) {
+      return false;
+    }
+    buffer_.clear();
+  }
+  ready_.push_back(std::move(item));
+  in_item_ = false;
+  return true;
+}
+
+bool PushDecoder::next(DataItem &item) {
+  if (ready_.empty()) {
+    return false;
+  }
+  item = std::move(ready_.front());
+  ready_.pop_front();
+  return true;
+}
+
+} // namespace cbor
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Incremental decoder for input that arrives in arbitrary chunks,
+ * e.g. from a non-blocking socket.
+ *
+ * feed() tracks the structure of the current top-level item across calls:
+ * open containers, a head split between chunks and the unread part of a
+ * string. Every item is decoded once, as soon as its last byte arrives,
+ * and queued for next(). Items that lie entirely inside one chunk are
+ * decoded straight from it; only the bytes of an item spanning several
+ * chunks are kept until it completes.
+ */
+class PushDecoder {
+public:
+  PushDecoder();
+
+  /**
+   * @brief Consume the next chunk of input.
+   * @return false if the input is malformed, after which every call fails
+   * until reset().
+   */
+  bool feed(const uint8_t *data, size_t size);
+  bool feed(const std::vector<uint8_t> &data);
+
+  /**
+   * @brief Pop the oldest complete item.
+   * @return false if no item is ready.
+   */
+  bool next(DataItem &item);
+
+  /**
+   * @brief Number of complete items waiting in next().
+   */
+  size_t ready() const { return ready_.size(); }
+
+  /**
+   * @brief Whether a partially received item is pending.
+   */
+  bool in_item() const { return in_item_; }
+
+  /**
+   * @brief Bytes held for the partially received item.
+   */
+  size_t buffered() const { return buffer_.size(); }
+
+  bool failed() const { return failed_; }
+
+  /**
+   * @brief Drop all state, including items not yet taken.
+   */
+  void reset();
+
+private:
+  std::deque<DataItem> ready_;
+  std::vector<uint8_t> buffer_;
+  // open indefinite-length items, as in detail::walk();
+  std::vector<uint64_t> stack_;
+  uint64_t pending_;
+  // unread payload bytes of the current string or chunk;
+  uint64_t skip_;
+  uint8_t head_[9];
+  uint8_t head_size_;
+  uint8_t head_need_;
+  int context_;
+  bool in_item_;
+  bool failed_;
+
+  bool begin_head(uint8_t initial);
+  bool end_head();
+  bool complete(const uint8_t *begin, const uint8_t *end);
+  bool fail();
+};
+
+} // namespace cbor
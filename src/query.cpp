@@ -0,0 +1,271 @@
+#include "query.hpp"
+#include "detail.hpp"
+
+namespace cbor {
+
+namespace {
+
+// Steps through the children of one array or map, map keys and values
+// alternating;
+struct cursor {
+  const uint8_t *p;
+  const uint8_t *end;
+  uint64_t remaining;
+  bool indefinite;
+
+  bool open(const uint8_t *item, const uint8_t *item_end, int &major) {
+    int minor = 0;
+    uint64_t value = 0;
+    size_t n = detail::read_head(item, item_end, major, minor, value);
+    if (n == 0 || (major != major::Array && major != major::Map) ||
+        (minor > 27 && minor != 31) ||
+        (major == major::Map && value > UINT64_MAX / 2)) {
+      return false;
+    }
+    p = item + n;
+    end = item_end;
+    indefinite = minor == 31;
+    remaining = major == major::Map ? value * 2 : value;
+    return true;
+  }
+
+  // start of the current child, nullptr past the last one;
+  const uint8_t *peek() const {
+    if (indefinite ? p == end || *p == 0xff : remaining == 0) {
+      return nullptr;
+    }
+    return p;
+  }
+
+  bool skip() {
+    const uint8_t *after = detail::skip_item(p, end);
+    if (after == nullptr) {
+      return false;
+    }
+    p = after;
+    --remaining;
+    return true;
+  }
+};
+
+bool key_matches(const path_step &step, const uint8_t *key,
+                 const uint8_t *end) {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  size_t n = detail::read_head(key, end, major, minor, value);
+  if (n == 0) {
+    return false;
+  }
+  if (!step.is_key()) {
+    int64_t index = step.index();
+    return minor < 28 &&
+           (index >= 0 ? major == major::Unsigned && value == uint64_t(index)
+                       : major == major::Negative &&
+                             value == ~uint64_t(index));
+  }
+  if (major != major::TextString) {
+    return false;
+  }
+  if (minor == 31) {
+    DataItem item;
+    return item.read(key, end - key) != 0 &&
+           item.as_string_view() == step.key();
+  }
+  return minor < 28 && value <= uint64_t(end - key - n) &&
+         string_view(reinterpret_cast<const char *>(key + n), size_t(value)) ==
+             step.key();
+}
+
+} // namespace
+
+/* ----------------------- query ----------------------- */
+static bytes_view find_path(const uint8_t *data, size_t size,
+                            const path_step *steps, size_t count) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  for (size_t i = 0; i < count; ++i) {
+    const path_step &step = steps[i];
+    cursor children;
+    int major = 0;
+    if (!children.open(p, end, major)) {
+      return bytes_view();
+    }
+    if (major == major::Array) {
+      if (step.is_key() || step.index() < 0) {
+        return bytes_view();
+      }
+      for (int64_t skipped = 0; skipped < step.index(); ++skipped) {
+        if (children.peek() == nullptr || !children.skip()) {
+          return bytes_view();
+        }
+      }
+      p = children.peek();
+    } else {
+      for (;;) {
+        const uint8_t *key = children.peek();
+        if (key == nullptr || !children.skip()) {
+          return bytes_view();
+        }
+        if (key_matches(step, key, end)) {
+          break;
+        }
+        if (children.peek() == nullptr || !children.skip()) {
+          return bytes_view();
+        }
+      }
+      p = children.peek();
+    }
+    if (p == nullptr) {
+      return bytes_view();
+    }
+  }
+  const uint8_t *after = detail::skip_item(p, end);
+  return after == nullptr ? bytes_view() : bytes_view(p, after - p);
+}
+
+bytes_view query(const uint8_t *data, size_t size,
+                 std::initializer_list<path_step> path) {
+  return find_path(data, size, path.begin(), path.size());
+}
+
+bytes_view query(const std::vector<uint8_t> &data,
+                 std::initializer_list<path_step> path) {
+  return find_path(data.data(), data.size(), path.begin(), path.size());
+}
+
+bytes_view query(const uint8_t *data, size_t size, const path &path) {
+  return find_path(data, size, path.data(), path.size());
+}
+
+bytes_view query(const std::vector<uint8_t> &data, const path &path) {
+  return find_path(data.data(), data.size(), path.data(), path.size());
+}
+
+/* ----------------------- projection ----------------------- */
+namespace {
+
+// The selected paths merged into a tree, so that every container is
+// scanned once however many paths pass through it;
+struct selection {
+  struct Node {
+    path_step step;
+    // the whole subtree is selected;
+    bool whole;
+    std::vector<size_t> children;
+  };
+
+  std::vector<Node> nodes;
+
+  explicit selection(const std::vector<path> &paths) {
+    Node root = {path_step(0), false, {}};
+    nodes.push_back(root);
+    for (const path &path : paths) {
+      size_t current = 0;
+      for (const path_step &step : path) {
+        size_t next = 0;
+        for (size_t child : nodes[current].children) {
+          if (nodes[child].step == step) {
+            next = child;
+            break;
+          }
+        }
+        if (next == 0) {
+          next = nodes.size();
+          Node node = {step, false, {}};
+          nodes.push_back(node);
+          nodes[current].children.push_back(next);
+        }
+        current = next;
+      }
+      nodes[current].whole = true;
+    }
+  }
+
+  bool project(const uint8_t *item, const uint8_t *end, size_t index,
+               DataItem &out) const {
+    const Node &node = nodes[index];
+    if (node.whole) {
+      return out.read(item, end - item) != 0;
+    }
+    cursor children;
+    int major = 0;
+    if (!children.open(item, end, major)) {
+      // nothing below a scalar can be selected;
+      return detail::skip_item(item, end) != nullptr;
+    }
+    size_t found = 0;
+    if (major == major::Array) {
+      out = cbor::array();
+      for (int64_t i = 0; found < node.children.size(); ++i) {
+        const uint8_t *child = children.peek();
+        if (child == nullptr) {
+          break;
+        }
+        for (size_t selected : node.children) {
+          if (!nodes[selected].step.is_key() &&
+              nodes[selected].step.index() == i) {
+            out.emplace_back();
+            if (!project(child, end, selected, out.at(out.size() - 1))) {
+              return false;
+            }
+            ++found;
+            break;
+          }
+        }
+        if (!children.skip()) {
+          return false;
+        }
+      }
+      return true;
+    }
+    out = cbor::map();
+    while (found < node.children.size()) {
+      const uint8_t *key = children.peek();
+      if (key == nullptr) {
+        break;
+      }
+      if (!children.skip()) {
+        return false;
+      }
+      const uint8_t *value = children.peek();
+      if (value == nullptr) {
+        return false;
+      }
+      for (size_t selected : node.children) {
+        if (key_matches(nodes[selected].step, key, end)) {
+          DataItem key_item;
+          if (key_item.read(key, end - key) == 0 ||
+              !project(value, end, selected, out[key_item])) {
+            return false;
+          }
+          ++found;
+          break;
+        }
+      }
+      if (!children.skip()) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+DataItem project(const uint8_t *data, size_t size,
+                 const std::vector<path> &paths) {
+  selection selected(paths);
+  DataItem out;
+  if (!selected.project(data, data + size, 0, out)) {
+    return DataItem();
+  }
+  return out;
+}
+
+DataItem project(const std::vector<uint8_t> &data,
+                 const std::vector<path> &paths) {
+  return project(data.data(), data.size(), paths);
+}
+
+} // namespace cbor
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief One hop of a path: a text key of a map, or an integer that is an
+ * array index or an integer key of a map. Keys are referenced, not copied.
+ */
+class path_step {
+public:
+  path_step(const char *key) : key_(key, strlen(key)), index_(0) {}
+  path_step(const std::string &key)
+      : key_(key.data(), key.size()), index_(0) {}
+  path_step(string_view key) : key_(key), index_(0) {}
+  path_step(int index) : index_(index) {}
+  path_step(long index) : index_(index) {}
+  path_step(long long index) : index_(index) {}
+  path_step(unsigned index) : index_(int64_t(index)) {}
+  path_step(unsigned long index) : index_(int64_t(index)) {}
+  path_step(unsigned long long index) : index_(int64_t(index)) {}
+
+  bool is_key() const { return key_.data() != nullptr; }
+  string_view key() const { return key_; }
+  int64_t index() const { return index_; }
+
+  friend bool operator==(const path_step &a, const path_step &b) {
+    return a.is_key() == b.is_key() &&
+           (a.is_key() ? a.key_ == b.key_ : a.index_ == b.index_);
+  }
+
+private:
+  string_view key_;
+  int64_t index_;
+};
+
+using path = std::vector<path_step>;
+
+/**
+ * @brief Find the item at `path` inside the encoded item at the start of
+ * [data, data + size), scanning heads and skipping every subtree that is
+ * not on the way, without decoding anything.
+ * @return the encoded bytes of the item, pointing into `data`, or an empty
+ * view if the path does not exist or the input is malformed.
+ *
+ *   cbor::decode(cbor::query(buf, {"sensors", 3, "temp"}))
+ */
+bytes_view query(const uint8_t *data, size_t size,
+                 std::initializer_list<path_step> path);
+bytes_view query(const std::vector<uint8_t> &data,
+                 std::initializer_list<path_step> path);
+bytes_view query(const uint8_t *data, size_t size, const path &path);
+bytes_view query(const std::vector<uint8_t> &data, const path &path);
+
+/**
+ * @brief Decode only the subtrees at `paths`, and the maps and arrays on
+ * the way to them; everything else is skipped at header-scan speed. Maps
+ * keep just the selected entries and arrays just the selected elements,
+ * in their original order. An empty path selects the whole item.
+ * @return undefined if the input is malformed.
+ */
+DataItem project(const uint8_t *data, size_t size,
+                 const std::vector<path> &paths);
+DataItem project(const std::vector<uint8_t> &data,
+                 const std::vector<path> &paths);
+
+} // namespace cbor
@@ -0,0 +1,55 @@
+#include "sax.hpp"
+#include "detail.hpp"
+
+namespace cbor {
+
+namespace {
+struct event_visitor {
+  Handler &handler;
+
+  bool item(int major, int minor, uint64_t value, const uint8_t *payload) {
+    switch (major) {
+    case major::Unsigned:
+      return handler.on_uint(value);
+    case major::Negative:
+      return handler.on_negative(value);
+    case major::ByteString:
+      if (minor == 31) {
+        return handler.on_bytes_begin();
+      }
+      return handler.on_bytes(payload, size_t(value));
+    case major::TextString:
+      if (minor == 31) {
+        return handler.on_string_begin();
+      }
+      return handler.on_string(reinterpret_cast<const char *>(payload),
+                               size_t(value));
+    case major::Array:
+      return handler.on_array_begin(minor == 31 ? Handler::indefinite : value);
+    case major::Map:
+      return handler.on_map_begin(minor == 31 ? Handler::indefinite : value);
+    case major::Tag:
+      return handler.on_tag(value);
+    default:
+      if (minor >= 25) {
+        return handler.on_float(detail::decode_float(minor, value));
+      }
+      return handler.on_simple(uint8_t(value));
+    }
+  }
+
+  bool end_indefinite() { return handler.on_break(); }
+};
+} // namespace
+
+size_t parse(const uint8_t *data, size_t size, Handler &handler) {
+  event_visitor visitor = {handler};
+  const uint8_t *end = detail::walk(data, data + size, visitor);
+  return end == nullptr ? 0 : end - data;
+}
+
+size_t parse(const std::vector<uint8_t> &data, Handler &handler) {
+  return parse(data.data(), data.size(), handler);
+}
+
+} // namespace cbor
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Receives the events of parse(). Every callback returns true to
+ * continue or false to stop parsing; the defaults ignore the event.
+ *
+ * Containers report their element count up front, or `indefinite`, in
+ * which case the matching on_break() closes them. Maps count pairs, and
+ * their keys and values alternate. Chunked strings start with
+ * on_string_begin() or on_bytes_begin(), deliver every chunk through
+ * on_string() or on_bytes() and end with on_break().
+ */
+class Handler {
+public:
+  static const uint64_t indefinite = UINT64_MAX;
+
+  virtual ~Handler() {}
+
+  virtual bool on_uint(uint64_t /* value */) { return true; }
+  /**
+   * @brief Negative integer -1 - value.
+   */
+  virtual bool on_negative(uint64_t /* value */) { return true; }
+  virtual bool on_string(const char * /* data */, size_t /* size */) {
+    return true;
+  }
+  virtual bool on_bytes(const uint8_t * /* data */, size_t /* size */) {
+    return true;
+  }
+  virtual bool on_string_begin() { return true; }
+  virtual bool on_bytes_begin() { return true; }
+  virtual bool on_array_begin(uint64_t /* size */) { return true; }
+  virtual bool on_map_begin(uint64_t /* size */) { return true; }
+  virtual bool on_tag(uint64_t /* tag */) { return true; }
+  virtual bool on_simple(uint8_t /* value */) { return true; }
+  virtual bool on_float(double /* value */) { return true; }
+  virtual bool on_break() { return true; }
+};
+
+/**
+ * @brief Walk one encoded data item and report it to `handler` without
+ * building a tree. Memory use does not depend on the input size, and
+ * strings are handed out as pointers into `data`.
+ * @return bytes consumed, 0 if the item is malformed or the handler
+ * stopped. Events already delivered for a malformed item are not undone.
+ */
+size_t parse(const uint8_t *data, size_t size, Handler &handler);
+size_t parse(const std::vector<uint8_t> &data, Handler &handler);
+
+} // namespace cbor
@@ -0,0 +1,223 @@
+#include "sequence.hpp"
+#include "detail.hpp"
+#include "mapped_file.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace cbor {
+
+static const size_t read_block = 65536;
+
+static long read_some(int fd, uint8_t *data, size_t size) {
+  for (;;) {
+#if defined(_WIN32)
+    long n = _read(fd, data, unsigned(size > 0x40000000 ? 0x40000000 : size));
+#else
+    long n = long(::read(fd, data, size));
+#endif
+    if (n >= 0 || errno != EINTR) {
+      return n;
+    }
+  }
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t size) {
+  while (size != 0) {
+#if defined(_WIN32)
+    long n = _write(fd, data, unsigned(size > 0x40000000 ? 0x40000000 : size));
+#else
+    long n = long(::write(fd, data, size));
+#endif
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+/* ----------------------- reader ----------------------- */
+namespace {
+struct frame_visitor {
+  bool item(int, int, uint64_t, const uint8_t *) { return true; }
+  bool end_indefinite() { return true; }
+};
+} // namespace
+
+const size_t SequenceReader::default_max_item_size;
+
+SequenceReader::SequenceReader(const uint8_t *data, size_t size,
+                               const decode_options &options)
+    : pos_(data), end_(data + size), options_(options), fd_(-1), eof_(true),
+      failed_(false), count_(0), max_item_size_(size), rescan_(0) {}
+
+SequenceReader::SequenceReader(const std::vector<uint8_t> &data,
+                               const decode_options &options)
+    : SequenceReader(data.data(), data.size(), options) {}
+
+SequenceReader::SequenceReader(const MappedFile &file,
+                               const decode_options &options)
+    : SequenceReader(file.data(), file.size(), options) {}
+
+SequenceReader::SequenceReader(int fd, const decode_options &options,
+                               size_t max_item_size)
+    : pos_(nullptr), end_(nullptr), options_(options), fd_(fd), eof_(false),
+      failed_(false), count_(0), max_item_size_(max_item_size), rescan_(0) {
+  // the buffer is reused for later items;
+  options_.borrow = false;
+}
+
+// Moves the unread bytes to the front of the buffer and reads more after
+// them, growing the buffer when an item does not fit.
+bool SequenceReader::refill() {
+  size_t pending = end_ - pos_;
+  if (pending != 0 && pos_ != buffer_.data()) {
+    memmove(buffer_.data(), pos_, pending);
+  }
+  if (buffer_.size() - pending < read_block / 2) {
+    size_t size = buffer_.size() * 2;
+    buffer_.resize(size < pending + read_block ? pending + read_block : size);
+  }
+  long n = read_some(fd_, buffer_.data() + pending, buffer_.size() - pending);
+  pos_ = buffer_.data();
+  end_ = pos_ + pending + (n > 0 ? size_t(n) : 0);
+  if (n <= 0) {
+    // the end of the input is an error only inside an item, which next()
+    // finds when it scans what is left;
+    eof_ = true;
+    failed_ = n < 0;
+    return false;
+  }
+  return true;
+}
+
+bool SequenceReader::next(bytes_view &encoded) {
+  while (!failed_) {
+    size_t pending = size_t(end_ - pos_);
+    if (!eof_ && (pending == 0 || pending < rescan_)) {
+      refill();
+      continue;
+    }
+    if (pending == 0) {
+      return false;
+    }
+    frame_visitor visitor;
+    detail::failure failure = {error::None, pos_};
+    const uint8_t *after = detail::walk(pos_, end_, visitor, &failure);
+    if (after != nullptr && size_t(after - pos_) <= max_item_size_) {
+      encoded = bytes_view(pos_, after - pos_);
+      pos_ = after;
+      rescan_ = 0;
+      ++count_;
+      return true;
+    }
+    // counts are checked against the bytes at hand, so more input may
+    // settle them as well;
+    bool short_input = failure.reason == error::Truncated ||
+                       failure.reason == error::CountTooLarge;
+    if (after != nullptr || !short_input || eof_ ||
+        pending >= max_item_size_) {
+      failed_ = true;
+      return false;
+    }
+    rescan_ = pending < max_item_size_ / 2 ? pending * 2 : max_item_size_;
+  }
+  return false;
+}
+
+bool SequenceReader::next(DataItem &item) {
+  bytes_view encoded;
+  if (!next(encoded)) {
+    return false;
+  }
+  if (item.read(encoded.data(), encoded.size(), options_) != encoded.size()) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool SequenceReader::skip() {
+  bytes_view encoded;
+  return next(encoded);
+}
+
+size_t SequenceReader::next_batch(std::vector<DataItem> &batch,
+                                  size_t count) {
+  batch.resize(count);
+  size_t n = 0;
+  while (n < count && next(batch[n])) {
+    ++n;
+  }
+  batch.resize(n);
+  return n;
+}
+
+SequenceReader::iterator SequenceReader::begin() {
+  return next(current_) ? iterator(this) : end();
+}
+
+/* ----------------------- writer ----------------------- */
+SequenceWriter::SequenceWriter(std::vector<uint8_t> &out)
+    : out_(&out), fd_(-1), buffer_size_(0), failed_(false), count_(0) {}
+
+SequenceWriter::SequenceWriter(int fd, size_t buffer_size)
+    : out_(&buffer_), fd_(fd), buffer_size_(buffer_size), failed_(false),
+      count_(0) {
+  buffer_.reserve(buffer_size + read_block);
+}
+
+SequenceWriter::~SequenceWriter() { flush(); }
+
+// Counts the item just appended and flushes a full buffer;
+bool SequenceWriter::written() {
+  ++count_;
+  return fd_ < 0 || buffer_.size() < buffer_size_ || flush();
+}
+
+bool SequenceWriter::write(const DataItem &item) {
+  if (failed_) {
+    return false;
+  }
+  item.write(*out_);
+  return written();
+}
+
+bool SequenceWriter::write(bytes_view encoded) {
+  if (failed_) {
+    return false;
+  }
+  out_->insert(out_->end(), encoded.begin(), encoded.end());
+  return written();
+}
+
+bool SequenceWriter::write_batch(const std::vector<DataItem> &items) {
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (!write(items[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SequenceWriter::flush() {
+  if (failed_ || fd_ < 0 || buffer_.empty()) {
+    return !failed_;
+  }
+  failed_ = !write_all(fd_, buffer_.data(), buffer_.size());
+  buffer_.clear();
+  return !failed_;
+}
+
+} // namespace cbor
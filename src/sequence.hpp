@@ -0,0 +1,185 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <iterator>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+class MappedFile;
+
+/**
+ * @brief Reads an RFC 8742 sequence, data items stored back to back, from
+ * a buffer, a mapped file or a file descriptor.
+ *
+ * Items are framed by scanning their heads, so skip() and the encoded form
+ * of next() never decode anything. A descriptor is read in blocks into a
+ * buffer that grows to hold the largest item, up to a limit. A partial
+ * item is rescanned only once its bytes have doubled, so framing an item
+ * takes time linear in its size however the input arrives.
+ *
+ *   for (const DataItem &item : reader) { ... }
+ *   if (reader.failed()) { ... }
+ */
+class SequenceReader {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = DataItem;
+    using pointer = const DataItem *;
+    using reference = const DataItem &;
+
+    explicit iterator(SequenceReader *reader) : reader_(reader) {}
+
+    reference operator*() const { return reader_->current_; }
+    pointer operator->() const { return &reader_->current_; }
+
+    iterator &operator++() {
+      if (!reader_->next(reader_->current_)) {
+        reader_ = nullptr;
+      }
+      return *this;
+    }
+
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a.reader_ == b.reader_;
+    }
+    friend bool operator!=(const iterator &a, const iterator &b) {
+      return a.reader_ != b.reader_;
+    }
+
+  private:
+    SequenceReader *reader_;
+  };
+
+  SequenceReader(const uint8_t *data, size_t size,
+                 const decode_options &options = decode_options());
+  explicit SequenceReader(const std::vector<uint8_t> &data,
+                          const decode_options &options = decode_options());
+  explicit SequenceReader(const MappedFile &file,
+                          const decode_options &options = decode_options());
+  /**
+   * @brief Largest item a descriptor reader buffers by default.
+   */
+  static const size_t default_max_item_size = size_t(1) << 30;
+
+  /**
+   * @brief Read from `fd`, which stays owned by the caller. An item larger
+   * than `max_item_size` bytes fails the reader, so a forged length or
+   * count cannot make it buffer the rest of the input.
+   */
+  explicit SequenceReader(int fd,
+                          const decode_options &options = decode_options(),
+                          size_t max_item_size = default_max_item_size);
+
+  SequenceReader(const SequenceReader &) = delete;
+  SequenceReader &operator=(const SequenceReader &) = delete;
+
+  /**
+   * @brief Decode the next item.
+   * @return false at the end of the sequence or on an error, see failed().
+   */
+  bool next(DataItem &item);
+  /**
+   * @brief Frame the next item without decoding it. The view points into
+   * the source buffer, or for descriptors into the reader's buffer, where
+   * it stays valid until the next call.
+   */
+  bool next(bytes_view &encoded);
+  /**
+   * @brief Step over the next item without decoding it.
+   */
+  bool skip();
+  /**
+   * @brief Replace the contents of `batch` with up to `count` next items.
+   * @return number of items read, less than `count` only at the end or on
+   * an error.
+   */
+  size_t next_batch(std::vector<DataItem> &batch, size_t count);
+
+  /**
+   * @brief Whether the input was malformed, ended inside an item or could
+   * not be read.
+   */
+  bool failed() const { return failed_; }
+  /**
+   * @brief Number of items read or skipped so far.
+   */
+  size_t count() const { return count_; }
+
+  iterator begin();
+  iterator end() { return iterator(nullptr); }
+
+private:
+  const uint8_t *pos_;
+  const uint8_t *end_;
+  decode_options options_;
+  int fd_;
+  bool eof_;
+  bool failed_;
+  size_t count_;
+  size_t max_item_size_;
+  // bytes of a partial item to wait for before scanning it again;
+  size_t rescan_;
+  std::vector<uint8_t> buffer_;
+  DataItem current_;
+
+  bool refill();
+};
+
+/**
+ * @brief Appends an RFC 8742 sequence to a byte vector or writes it to a
+ * file descriptor.
+ *
+ * Writing to a descriptor goes through a buffer that is handed to the
+ * system once it holds at least `buffer_size` bytes, so that small items
+ * do not cost a system call each. The destructor flushes what is left.
+ */
+class SequenceWriter {
+public:
+  explicit SequenceWriter(std::vector<uint8_t> &out);
+  /**
+   * @brief Write to `fd`, which stays owned by the caller.
+   */
+  explicit SequenceWriter(int fd, size_t buffer_size = 65536);
+  ~SequenceWriter();
+
+  SequenceWriter(const SequenceWriter &) = delete;
+  SequenceWriter &operator=(const SequenceWriter &) = delete;
+
+  bool write(const DataItem &item);
+  /**
+   * @brief Append an item that is already encoded.
+   */
+  bool write(bytes_view encoded);
+  bool write_batch(const std::vector<DataItem> &items);
+
+  /**
+   * @brief Hand buffered bytes to the descriptor.
+   * @return false if writing failed, after which every write fails.
+   */
+  bool flush();
+
+  bool failed() const { return failed_; }
+  /**
+   * @brief Number of items written so far.
+   */
+  size_t count() const { return count_; }
+
+private:
+  std::vector<uint8_t> buffer_;
+  std::vector<uint8_t> *out_;
+  int fd_;
+  size_t buffer_size_;
+  bool failed_;
+  size_t count_;
+
+  bool written();
+};
+
+} // namespace cbor
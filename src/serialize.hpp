@@ -0,0 +1,661 @@
+#pragma once
+
+#include "cbor.hpp"
+#include "detail.hpp"
+
+#include <array>
+#include <limits>
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <optional>
+#define CBOR_HAS_OPTIONAL 1
+#endif
+
+/**
+ * @brief Describe the fields of a struct for serialize() and deserialize(),
+ * next to the struct in its own namespace:
+ *
+ *   struct Point { int x; int y; std::string label; };
+ *   CBOR_FIELDS(Point, x, y, label)
+ *
+ * A struct is encoded as a map from field names to values, in the order
+ * listed. Decoding matches keys by name, skips keys it does not know and
+ * leaves fields without a key untouched. Up to 32 fields.
+ */
+#define CBOR_FIELDS(Type, ...)                                                 \
+  template <typename Visitor>                                                  \
+  inline void cbor_fields(Type &value, Visitor &visitor) {                     \
+    CBOR_FOR_EACH(CBOR_FIELD, __VA_ARGS__)                                     \
+  }                                                                            \
+  template <typename Visitor>                                                  \
+  inline void cbor_fields(const Type &value, Visitor &visitor) {               \
+    CBOR_FOR_EACH(CBOR_FIELD, __VA_ARGS__)                                     \
+  }
+
+#define CBOR_FIELD(field) visitor(#field, value.field);
+
+// Applies m to each argument; the extra expansions are for MSVC, which
+// passes __VA_ARGS__ on as a single argument otherwise;
+#define CBOR_EXPAND(x) x
+#define CBOR_FOR_EACH_1(m, x) m(x)
+#define CBOR_FOR_EACH_2(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_1(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_3(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_2(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_4(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_3(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_5(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_4(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_6(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_5(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_7(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_6(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_8(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_7(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_9(m, x, ...)                                             \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_8(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_10(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_9(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_11(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_10(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_12(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_11(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_13(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_12(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_14(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_13(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_15(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_14(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_16(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_15(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_17(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_16(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_18(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_17(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_19(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_18(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_20(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_19(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_21(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_20(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_22(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_21(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_23(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_22(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_24(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_23(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_25(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_24(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_26(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_25(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_27(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_26(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_28(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_27(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_29(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_28(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_30(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_29(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_31(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_30(m, __VA_ARGS__))
+#define CBOR_FOR_EACH_32(m, x, ...)                                            \
+  m(x) CBOR_EXPAND(CBOR_FOR_EACH_31(m, __VA_ARGS__))
+
+#define CBOR_SELECT(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13,    \
+    _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27,      \
+    _28, _29, _30, _31, _32, NAME, ...) NAME
+#define CBOR_FOR_EACH(m, ...)                                                  \
+  CBOR_EXPAND(CBOR_SELECT(__VA_ARGS__, CBOR_FOR_EACH_32, CBOR_FOR_EACH_31,     \
+    CBOR_FOR_EACH_30, CBOR_FOR_EACH_29, CBOR_FOR_EACH_28, CBOR_FOR_EACH_27,    \
+    CBOR_FOR_EACH_26, CBOR_FOR_EACH_25, CBOR_FOR_EACH_24, CBOR_FOR_EACH_23,    \
+    CBOR_FOR_EACH_22, CBOR_FOR_EACH_21, CBOR_FOR_EACH_20, CBOR_FOR_EACH_19,    \
+    CBOR_FOR_EACH_18, CBOR_FOR_EACH_17, CBOR_FOR_EACH_16, CBOR_FOR_EACH_15,    \
+    CBOR_FOR_EACH_14, CBOR_FOR_EACH_13, CBOR_FOR_EACH_12, CBOR_FOR_EACH_11,    \
+    CBOR_FOR_EACH_10, CBOR_FOR_EACH_9, CBOR_FOR_EACH_8, CBOR_FOR_EACH_7,       \
+    CBOR_FOR_EACH_6, CBOR_FOR_EACH_5, CBOR_FOR_EACH_4, CBOR_FOR_EACH_3,        \
+    CBOR_FOR_EACH_2, CBOR_FOR_EACH_1, dummy)(m, __VA_ARGS__))
+
+namespace cbor {
+
+namespace detail {
+
+/**
+ * @brief Position in the input of deserialize().
+ */
+struct reader {
+  const uint8_t *p;
+  const uint8_t *end;
+};
+
+/**
+ * @brief How a type is written and read. Specialized below for the
+ * built-in types, enums and standard containers; the primary template
+ * handles structs described with CBOR_FIELDS.
+ */
+template <typename T, typename Enable = void> struct codec;
+
+inline void put_head(std::vector<uint8_t> &out, int major, uint64_t value) {
+  uint8_t head[9];
+  out.insert(out.end(), head, write_head(head, major, value));
+}
+
+inline void put_string(std::vector<uint8_t> &out, int major, const void *data,
+                       size_t size) {
+  put_head(out, major, size);
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  out.insert(out.end(), bytes, bytes + size);
+}
+
+// Reads a head whose additional information is a value or, where the
+// major type allows it, an indefinite length;
+inline bool next_head(reader &r, int &major, int &minor, uint64_t &value) {
+  size_t size = read_head(r.p, r.end, major, minor, value);
+  if (size == 0 || (minor > 27 && minor < 31)) {
+    return false;
+  }
+  r.p += size;
+  return true;
+}
+
+// Calls `element` for each of `count` elements, or up to the break of an
+// indefinite-length item;
+template <typename F>
+bool for_each_element(reader &r, int minor, uint64_t count, F element) {
+  if (minor == 31) {
+    for (;;) {
+      if (r.p == r.end) {
+        return false;
+      }
+      if (*r.p == 0xff) {
+        ++r.p;
+        return true;
+      }
+      if (!element()) {
+        return false;
+      }
+    }
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    if (!element()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A definite string is viewed in place, chunks are joined in `scratch`;
+inline bool read_string(reader &r, int want, const char *&data, size_t &size,
+                        std::string &scratch) {
+  int major = 0;
+  int minor = 0;
+  uint64_t value = 0;
+  if (!next_head(r, major, minor, value) || major != want) {
+    return false;
+  }
+  if (minor != 31) {
+    if (value > uint64_t(r.end - r.p)) {
+      return false;
+    }
+    data = reinterpret_cast<const char *>(r.p);
+    size = size_t(value);
+    r.p += size;
+    return true;
+  }
+  scratch.clear();
+  bool ok = for_each_element(r, 31, 0, [&]() -> bool {
+    int chunk_major = 0;
+    int chunk_minor = 0;
+    uint64_t length = 0;
+    if (!next_head(r, chunk_major, chunk_minor, length) ||
+        chunk_major != want || chunk_minor == 31 ||
+        length > uint64_t(r.end - r.p)) {
+      return false;
+    }
+    scratch.append(reinterpret_cast<const char *>(r.p), size_t(length));
+    r.p += length;
+    return true;
+  });
+  data = scratch.data();
+  size = scratch.size();
+  return ok;
+}
+
+// Upper bound for reserving a container of `count` elements, which all
+// take at least one byte of the remaining input;
+inline size_t reserve_count(const reader &r, int minor, uint64_t count) {
+  if (minor == 31) {
+    return 0;
+  }
+  return count < uint64_t(r.end - r.p) ? size_t(count) : size_t(r.end - r.p);
+}
+
+/* ----------------------- scalars ----------------------- */
+template <> struct codec<bool> {
+  static void encode(std::vector<uint8_t> &out, bool value) {
+    out.push_back(value ? 0xf5 : 0xf4);
+  }
+  static bool decode(reader &r, bool &value) {
+    if (r.p == r.end || (*r.p != 0xf4 && *r.p != 0xf5)) {
+      return false;
+    }
+    value = *r.p++ == 0xf5;
+    return true;
+  }
+};
+
+template <typename T>
+struct codec<T, typename std::enable_if<std::is_integral<T>::value &&
+                                        !std::is_same<T, bool>::value>::type> {
+  static void encode(std::vector<uint8_t> &out, T value) {
+    if (value < 0) {
+      put_head(out, major::Negative, ~uint64_t(int64_t(value)));
+    } else {
+      put_head(out, major::Unsigned, uint64_t(value));
+    }
+  }
+  static bool decode(reader &r, T &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t v = 0;
+    if (!next_head(r, major, minor, v) || minor == 31 ||
+        v > uint64_t(std::numeric_limits<T>::max())) {
+      return false;
+    }
+    if (major == major::Unsigned) {
+      value = T(v);
+      return true;
+    }
+    // -1 - v down to the minimum, which is -1 - max for two's complement;
+    if (major == major::Negative && std::is_signed<T>::value) {
+      value = T(-1 - int64_t(v));
+      return true;
+    }
+    return false;
+  }
+};
+
+template <typename T>
+struct codec<T,
+             typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static void encode(std::vector<uint8_t> &out, T value) {
+    uint8_t head[9];
+    out.insert(out.end(), head, write_float(head, double(value)));
+  }
+  static bool decode(reader &r, T &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t v = 0;
+    if (!next_head(r, major, minor, v) || minor == 31) {
+      return false;
+    }
+    switch (major) {
+    case major::Unsigned:
+      value = T(v);
+      return true;
+    case major::Negative:
+      value = T(-1 - double(v));
+      return true;
+    case major::Simple:
+      if (minor < 25 || minor > 27) {
+        return false;
+      }
+      value = T(decode_float(minor, v));
+      return true;
+    default:
+      return false;
+    }
+  }
+};
+
+template <typename T>
+struct codec<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  using underlying = typename std::underlying_type<T>::type;
+
+  static void encode(std::vector<uint8_t> &out, T value) {
+    codec<underlying>::encode(out, underlying(value));
+  }
+  static bool decode(reader &r, T &value) {
+    underlying v;
+    if (!codec<underlying>::decode(r, v)) {
+      return false;
+    }
+    value = T(v);
+    return true;
+  }
+};
+
+template <> struct codec<std::string> {
+  static void encode(std::vector<uint8_t> &out, const std::string &value) {
+    put_string(out, major::TextString, value.data(), value.size());
+  }
+  static bool decode(reader &r, std::string &value) {
+    const char *data = nullptr;
+    size_t size = 0;
+    if (!read_string(r, major::TextString, data, size, value)) {
+      return false;
+    }
+    if (data != value.data()) {
+      value.assign(data, size);
+    }
+    return true;
+  }
+};
+
+template <> struct codec<std::vector<uint8_t>> {
+  static void encode(std::vector<uint8_t> &out,
+                     const std::vector<uint8_t> &value) {
+    put_string(out, major::ByteString, value.data(), value.size());
+  }
+  static bool decode(reader &r, std::vector<uint8_t> &value) {
+    const char *data = nullptr;
+    size_t size = 0;
+    std::string scratch;
+    if (!read_string(r, major::ByteString, data, size, scratch)) {
+      return false;
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    value.assign(bytes, bytes + size);
+    return true;
+  }
+};
+
+template <> struct codec<DataItem> {
+  static void encode(std::vector<uint8_t> &out, const DataItem &value) {
+    value.write(out);
+  }
+  static bool decode(reader &r, DataItem &value) {
+    size_t size = value.read(r.p, r.end - r.p);
+    r.p += size;
+    return size != 0;
+  }
+};
+
+/* ----------------------- containers ----------------------- */
+template <typename T, typename A> struct codec<std::vector<T, A>> {
+  static void encode(std::vector<uint8_t> &out,
+                     const std::vector<T, A> &value) {
+    put_head(out, major::Array, value.size());
+    for (typename std::vector<T, A>::const_iterator it = value.begin();
+         it != value.end(); ++it) {
+      codec<T>::encode(out, *it);
+    }
+  }
+  static bool decode(reader &r, std::vector<T, A> &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t count = 0;
+    if (!next_head(r, major, minor, count) || major != major::Array) {
+      return false;
+    }
+    value.clear();
+    value.reserve(reserve_count(r, minor, count));
+    return for_each_element(r, minor, count, [&]() -> bool {
+      // a temporary keeps std::vector<bool> working;
+      T element = T();
+      if (!codec<T>::decode(r, element)) {
+        return false;
+      }
+      value.push_back(std::move(element));
+      return true;
+    });
+  }
+};
+
+template <typename T, size_t N> struct codec<std::array<T, N>> {
+  static void encode(std::vector<uint8_t> &out,
+                     const std::array<T, N> &value) {
+    put_head(out, major::Array, N);
+    for (size_t i = 0; i < N; ++i) {
+      codec<T>::encode(out, value[i]);
+    }
+  }
+  static bool decode(reader &r, std::array<T, N> &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t count = 0;
+    if (!next_head(r, major, minor, count) || major != major::Array) {
+      return false;
+    }
+    size_t i = 0;
+    bool ok = for_each_element(r, minor, count, [&]() -> bool {
+      return i < N && codec<T>::decode(r, value[i++]);
+    });
+    return ok && i == N;
+  }
+};
+
+// Maps of any kind: entries are written in iteration order, and of
+// repeated keys the first one is kept, as DataItem does;
+template <typename M> struct map_codec {
+  using key_type = typename M::key_type;
+  using mapped_type = typename M::mapped_type;
+
+  static void encode(std::vector<uint8_t> &out, const M &value) {
+    put_head(out, major::Map, value.size());
+    for (typename M::const_iterator it = value.begin(); it != value.end();
+         ++it) {
+      codec<key_type>::encode(out, it->first);
+      codec<mapped_type>::encode(out, it->second);
+    }
+  }
+  static bool decode(reader &r, M &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t count = 0;
+    if (!next_head(r, major, minor, count) || major != major::Map) {
+      return false;
+    }
+    value.clear();
+    return for_each_element(r, minor, count, [&]() -> bool {
+      key_type key = key_type();
+      mapped_type mapped = mapped_type();
+      if (!codec<key_type>::decode(r, key) ||
+          !codec<mapped_type>::decode(r, mapped)) {
+        return false;
+      }
+      value.insert(std::make_pair(std::move(key), std::move(mapped)));
+      return true;
+    });
+  }
+};
+
+template <typename K, typename V, typename C, typename A>
+struct codec<std::map<K, V, C, A>> : map_codec<std::map<K, V, C, A>> {};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct codec<std::unordered_map<K, V, H, E, A>>
+    : map_codec<std::unordered_map<K, V, H, E, A>> {};
+
+// Pairs and tuples are arrays of their elements;
+template <typename T, size_t I = 0,
+          bool Done = I == std::tuple_size<T>::value>
+struct tuple_elements {
+  using element = typename std::tuple_element<I, T>::type;
+
+  static void encode(std::vector<uint8_t> &out, const T &value) {
+    codec<element>::encode(out, std::get<I>(value));
+    tuple_elements<T, I + 1>::encode(out, value);
+  }
+  static bool decode(reader &r, T &value) {
+    return codec<element>::decode(r, std::get<I>(value)) &&
+           tuple_elements<T, I + 1>::decode(r, value);
+  }
+};
+
+template <typename T, size_t I> struct tuple_elements<T, I, true> {
+  static void encode(std::vector<uint8_t> &, const T &) {}
+  static bool decode(reader &, T &) { return true; }
+};
+
+template <typename T> struct tuple_codec {
+  static void encode(std::vector<uint8_t> &out, const T &value) {
+    put_head(out, major::Array, std::tuple_size<T>::value);
+    tuple_elements<T>::encode(out, value);
+  }
+  static bool decode(reader &r, T &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t count = 0;
+    if (!next_head(r, major, minor, count) || major != major::Array ||
+        minor == 31 || count != std::tuple_size<T>::value) {
+      return false;
+    }
+    return tuple_elements<T>::decode(r, value);
+  }
+};
+
+template <typename A, typename B>
+struct codec<std::pair<A, B>> : tuple_codec<std::pair<A, B>> {};
+
+template <typename... Ts>
+struct codec<std::tuple<Ts...>> : tuple_codec<std::tuple<Ts...>> {};
+
+#if defined(CBOR_HAS_OPTIONAL)
+// An empty optional is null;
+template <typename T> struct codec<std::optional<T>> {
+  static void encode(std::vector<uint8_t> &out, const std::optional<T> &value) {
+    if (value) {
+      codec<T>::encode(out, *value);
+    } else {
+      out.push_back(0xf6);
+    }
+  }
+  static bool decode(reader &r, std::optional<T> &value) {
+    if (r.p != r.end && *r.p == 0xf6) {
+      ++r.p;
+      value.reset();
+      return true;
+    }
+    T element = T();
+    if (!codec<T>::decode(r, element)) {
+      return false;
+    }
+    value = std::move(element);
+    return true;
+  }
+};
+#endif
+
+/* ----------------------- structs ----------------------- */
+struct field_counter {
+  size_t count;
+
+  template <typename F> void operator()(const char *, const F &) { ++count; }
+};
+
+struct field_writer {
+  std::vector<uint8_t> &out;
+
+  template <typename F> void operator()(const char *name, const F &field) {
+    put_string(out, major::TextString, name, strlen(name));
+    codec<F>::encode(out, field);
+  }
+};
+
+struct field_reader {
+  string_view key;
+  reader &r;
+  bool found;
+  bool ok;
+
+  template <typename F> void operator()(const char *name, F &field) {
+    if (!found && strlen(name) == key.size() &&
+        memcmp(name, key.data(), key.size()) == 0) {
+      found = true;
+      ok = codec<F>::decode(r, field);
+    }
+  }
+};
+
+// cbor_fields() is found by argument-dependent lookup in the namespace of
+// the struct, where CBOR_FIELDS put it;
+template <typename T, typename Enable> struct codec {
+  static_assert(std::is_class<T>::value,
+                "type has no CBOR encoding, describe it with CBOR_FIELDS");
+
+  static void encode(std::vector<uint8_t> &out, const T &value) {
+    field_counter counter = {0};
+    cbor_fields(value, counter);
+    put_head(out, major::Map, counter.count);
+    field_writer writer = {out};
+    cbor_fields(value, writer);
+  }
+  static bool decode(reader &r, T &value) {
+    int major = 0;
+    int minor = 0;
+    uint64_t count = 0;
+    if (!next_head(r, major, minor, count) || major != major::Map) {
+      return false;
+    }
+    std::string scratch;
+    return for_each_element(r, minor, count, [&]() -> bool {
+      const char *data = nullptr;
+      size_t size = 0;
+      if (!read_string(r, major::TextString, data, size, scratch)) {
+        return false;
+      }
+      field_reader fields = {string_view(data, size), r, false, true};
+      cbor_fields(value, fields);
+      if (!fields.found) {
+        r.p = skip_item(r.p, r.end);
+        return r.p != nullptr;
+      }
+      return fields.ok;
+    });
+  }
+};
+
+} // namespace detail
+
+/**
+ * @brief Append the encoding of `value` to `out` without building a
+ * DataItem: integers, floats, bool, enums, std::string, byte vectors,
+ * DataItem, and vectors, arrays, maps, pairs, tuples and, from C++17,
+ * optionals of these, as well as structs described with CBOR_FIELDS.
+ * Which code runs for which type is settled at compile time.
+ */
+template <typename T>
+void serialize(const T &value, std::vector<uint8_t> &out) {
+  detail::codec<T>::encode(out, value);
+}
+
+template <typename T> std::vector<uint8_t> serialize(const T &value) {
+  std::vector<uint8_t> out;
+  serialize(value, out);
+  return out;
+}
+
+/**
+ * @brief Decode one item from [data, data + size) straight into `value`,
+ * which must have a matching shape; integers must fit the target type.
+ * @return number of bytes consumed, 0 if the input is malformed or does
+ * not match, in which case `value` may be partly assigned.
+ */
+template <typename T>
+size_t deserialize(const uint8_t *data, size_t size, T &value) {
+  detail::reader r = {data, data + size};
+  if (!detail::codec<T>::decode(r, value)) {
+    return 0;
+  }
+  return r.p - data;
+}
+
+/**
+ * @brief Like deserialize() above, but `in` must hold exactly one item.
+ */
+template <typename T>
+bool deserialize(const std::vector<uint8_t> &in, T &value) {
+  return !in.empty() && deserialize(in.data(), in.size(), value) == in.size();
+}
+
+} // namespace cbor
@@ -0,0 +1,103 @@
+#include "stringref.hpp"
+#include "detail.hpp"
+
+#include <unordered_map>
+
+namespace cbor {
+
+namespace detail {
+
+struct stringref_encoder {
+  struct item_hash {
+    size_t operator()(const DataItem *item) const { return item->hash(); }
+  };
+  struct item_equal {
+    bool operator()(const DataItem *a, const DataItem *b) const {
+      return *a == *b;
+    }
+  };
+  // strings with an index, keyed by the item they first occurred in, so
+  // that text and byte strings of the same bytes stay apart;
+  using table =
+      std::unordered_map<const DataItem *, uint64_t, item_hash, item_equal>;
+
+  std::vector<uint8_t> &out;
+  table strings;
+
+  explicit stringref_encoder(std::vector<uint8_t> &out) : out(out) {}
+
+  void head(int major, uint64_t value) {
+    uint8_t buffer[9];
+    out.insert(out.end(), buffer, write_head(buffer, major, value));
+  }
+
+  void encode(const DataItem &item) {
+    switch (item.type_) {
+    case type_t::Binary:
+    case type_t::String: {
+      table::const_iterator it = strings.find(&item);
+      if (it != strings.end()) {
+        head(major::Tag, 25);
+        head(major::Unsigned, it->second);
+        return;
+      }
+      bytes_view bytes = item.as_bytes_view();
+      if (bytes.size() >= stringref_min_length(strings.size())) {
+        strings.emplace(&item, strings.size());
+      }
+      head(item.type_ == type_t::Binary ? major::ByteString
+                                        : major::TextString,
+           bytes.size());
+      out.insert(out.end(), bytes.begin(), bytes.end());
+      return;
+    }
+    case type_t::Array:
+      head(major::Array, item.array_->size());
+      for (size_t i = 0; i < item.array_->size(); ++i) {
+        encode((*item.array_)[i]);
+      }
+      return;
+    case type_t::Map:
+      head(major::Map, item.map_->entries.size());
+      for (Map::const_iterator it = item.map_->entries.begin();
+           it != item.map_->entries.end(); ++it) {
+        encode(it->first);
+        encode(it->second);
+      }
+      return;
+    case type_t::Tagged:
+      head(major::Tag, item.tagged_->tag);
+      if (item.tagged_->tag == 256) {
+        // a nested namespace starts out empty and ends with its tag;
+        table outer;
+        outer.swap(strings);
+        encode(item.tagged_->item);
+        strings.swap(outer);
+      } else {
+        encode(item.tagged_->item);
+      }
+      return;
+    default: {
+      uint8_t buffer[9];
+      out.insert(out.end(), buffer, item.write_to(buffer));
+      return;
+    }
+    }
+  }
+};
+
+} // namespace detail
+
+void encode_stringref(const DataItem &item, std::vector<uint8_t> &out) {
+  detail::stringref_encoder encoder(out);
+  encoder.head(major::Tag, 256);
+  encoder.encode(item);
+}
+
+std::vector<uint8_t> encode_stringref(const DataItem &item) {
+  std::vector<uint8_t> out;
+  encode_stringref(item, out);
+  return out;
+}
+
+} // namespace cbor
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Append `item` to `out` using the stringref extension
+ * (http://cbor.schmorp.de/stringref). The item is wrapped in tag 256, and
+ * every text or byte string that occurred earlier and is long enough to
+ * gain from it is written as tag 25 with the index of that occurrence.
+ * Decode with decode_options::stringref.
+ *
+ * A tag 256 inside `item` opens a namespace of its own, as the extension
+ * requires. Items must not contain tag 25 themselves; decoders would take
+ * it for a reference.
+ */
+void encode_stringref(const DataItem &item, std::vector<uint8_t> &out);
+std::vector<uint8_t> encode_stringref(const DataItem &item);
+
+} // namespace cbor
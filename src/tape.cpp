@@ -0,0 +1,321 @@
+#include "tape.hpp"
+#include "detail.hpp"
+
+#include <stdexcept>
+
+namespace cbor {
+
+static size_t minor_head_size(int minor) {
+  return minor < 24 || minor == 31 ? 1 : 1 + (size_t(1) << (minor - 24));
+}
+
+static bool is_string_entry(const Tape::Entry &entry) {
+  return entry.major() == major::ByteString ||
+         entry.major() == major::TextString;
+}
+
+/* ----------------------- indexer ----------------------- */
+namespace {
+struct tape_visitor {
+  struct Frame {
+    uint32_t index;
+    // children still to come for definite-length items;
+    uint64_t remaining;
+  };
+
+  std::vector<Tape::Entry> &entries;
+  const uint8_t *data;
+  std::vector<Frame> open;
+
+  bool item(int major, int minor, uint64_t value, const uint8_t *payload) {
+    if (entries.size() >= UINT32_MAX) {
+      return false;
+    }
+    const uint8_t *start = payload - minor_head_size(minor);
+    uint32_t index = uint32_t(entries.size());
+    Tape::Entry entry = {minor == 31 ? 0 : value, uint64_t(start - data), 0,
+                         0, *start};
+    entries.push_back(entry);
+    uint64_t children = 0;
+    switch (major) {
+    case major::Array:
+      children = value;
+      break;
+    case major::Map:
+      children = value * 2;
+      break;
+    case major::Tag:
+      children = 1;
+      break;
+    }
+    if (minor == 31 || children != 0) {
+      Frame frame = {index, children};
+      open.push_back(frame);
+      return true;
+    }
+    entries[index].next = index + 1;
+    completed();
+    return true;
+  }
+
+  bool end_indefinite() {
+    Tape::Entry &entry = entries[open.back().index];
+    entry.next = uint32_t(entries.size());
+    if (entry.major() == major::Map) {
+      entry.value /= 2;
+    }
+    open.pop_back();
+    completed();
+    return true;
+  }
+
+  // Counts a finished child against the open items, closing the definite
+  // ones it completes;
+  void completed() {
+    while (!open.empty()) {
+      Tape::Entry &parent = entries[open.back().index];
+      if (parent.indefinite()) {
+        parent.value += is_string_entry(parent) ? entries.back().value : 1;
+        return;
+      }
+      if (--open.back().remaining != 0) {
+        return;
+      }
+      parent.next = uint32_t(entries.size());
+      open.pop_back();
+    }
+  }
+};
+} // namespace
+
+size_t Tape::index(const std::vector<uint8_t> &data) {
+  return index(data.data(), data.size());
+}
+
+size_t Tape::index(const uint8_t *data, size_t size) {
+  clear();
+  tape_visitor visitor = {entries_, data, {}};
+  const uint8_t *end = detail::walk(data, data + size, visitor);
+  if (end == nullptr) {
+    clear();
+    return 0;
+  }
+  data_ = data;
+  size_ = end - data;
+  // the children of every item are its subtrees, one jump apart;
+  children_.reserve(entries_.size() - 1);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry &entry = entries_[i];
+    entry.children = uint32_t(children_.size());
+    for (uint32_t j = uint32_t(i + 1); j < entry.next; j = entries_[j].next) {
+      children_.push_back(j);
+    }
+  }
+  return size_;
+}
+
+void Tape::clear() {
+  data_ = nullptr;
+  size_ = 0;
+  entries_.clear();
+  children_.clear();
+}
+
+/* ----------------------- item ----------------------- */
+type_t TapeItem::type() const {
+  if (tape_ == nullptr) {
+    return type_t::Simple;
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  switch (entry.major()) {
+  case major::Unsigned:
+    return type_t::Unsigned;
+  case major::Negative:
+    return type_t::Negative;
+  case major::ByteString:
+    return type_t::Binary;
+  case major::TextString:
+    return type_t::String;
+  case major::Array:
+    return type_t::Array;
+  case major::Map:
+    return type_t::Map;
+  case major::Tag:
+    return type_t::Tagged;
+  default:
+    return entry.minor() >= 25 && entry.minor() <= 27 ? type_t::Float
+                                                      : type_t::Simple;
+  }
+}
+
+bool TapeItem::is_null() const {
+  return tape_ != nullptr &&
+         tape_->entries_[index_].initial == (major::Simple << 5 | simple::Null);
+}
+
+bool TapeItem::is_undefined() const {
+  return tape_ == nullptr || tape_->entries_[index_].initial ==
+                                 (major::Simple << 5 | simple::Undefined);
+}
+
+size_t TapeItem::size() const {
+  return is_array() || is_map() ? size_t(tape_->entries_[index_].value) : 0;
+}
+
+TapeItem TapeItem::at(size_t index) const {
+  if (!is_array() || index >= size()) {
+    throw std::out_of_range("cbor::TapeItem::at");
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  return TapeItem(tape_, tape_->children_[entry.children + index]);
+}
+
+TapeItem TapeItem::find(const char *key, size_t size) const {
+  if (!is_map()) {
+    return TapeItem();
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  const uint32_t *pair = tape_->children_.data() + entry.children;
+  for (size_t i = 0; i < entry.value; ++i, pair += 2) {
+    TapeItem candidate(tape_, pair[0]);
+    if (!candidate.is_string()) {
+      continue;
+    }
+    if (tape_->entries_[pair[0]].indefinite()) {
+      std::string s = candidate;
+      if (s.size() == size && memcmp(s.data(), key, size) == 0) {
+        return TapeItem(tape_, pair[1]);
+      }
+      continue;
+    }
+    string_view view = candidate.as_string_view();
+    if (view.size() == size && memcmp(view.data(), key, size) == 0) {
+      return TapeItem(tape_, pair[1]);
+    }
+  }
+  return TapeItem();
+}
+
+TapeItem TapeItem::operator[](const char *key) const {
+  return find(key, strlen(key));
+}
+
+TapeItem TapeItem::operator[](const std::string &key) const {
+  return find(key.data(), key.size());
+}
+
+TapeItem TapeItem::operator[](const DataItem &key) const {
+  if (key.is_string()) {
+    string_view view = key.as_string_view();
+    return find(view.data(), view.size());
+  }
+  if (!is_map()) {
+    return TapeItem();
+  }
+  for (iterator it = begin(); it != end(); ++it) {
+    if (it.key().to_item() == key) {
+      return it.value();
+    }
+  }
+  return TapeItem();
+}
+
+TapeItem::iterator TapeItem::begin() const {
+  if (!is_array() && !is_map()) {
+    return end();
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  return iterator(tape_, tape_->children_.data() + entry.children,
+                  is_map() ? 2 : 1);
+}
+
+TapeItem::iterator TapeItem::end() const {
+  if (!is_array() && !is_map()) {
+    return iterator(nullptr, nullptr, 1);
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  size_t stride = is_map() ? 2 : 1;
+  return iterator(tape_,
+                  tape_->children_.data() + entry.children +
+                      entry.value * stride,
+                  stride);
+}
+
+uint64_t TapeItem::tag() const {
+  return is_tagged() ? tape_->entries_[index_].value : 0;
+}
+
+TapeItem TapeItem::child() const {
+  return is_tagged() ? TapeItem(tape_, index_ + 1) : TapeItem();
+}
+
+bytes_view TapeItem::encoded() const {
+  if (tape_ == nullptr) {
+    return bytes_view();
+  }
+  // The item ends where the last entry of its subtree ends, plus a break
+  // for every indefinite-length item on the way down to that entry.
+  const std::vector<Tape::Entry> &entries = tape_->entries_;
+  size_t breaks = 0;
+  size_t i = index_;
+  for (;;) {
+    const Tape::Entry &entry = entries[i];
+    if (entry.indefinite()) {
+      ++breaks;
+    }
+    if (entry.next == i + 1) {
+      break;
+    }
+    i = entry.next - 1;
+    if (!is_string_entry(entry)) {
+      size_t count = entry.major() == major::Tag   ? 1
+                     : entry.major() == major::Map ? size_t(entry.value) * 2
+                                                   : size_t(entry.value);
+      i = tape_->children_[entry.children + count - 1];
+    }
+  }
+  const Tape::Entry &last = entries[i];
+  size_t end = size_t(last.offset) + minor_head_size(last.minor()) + breaks;
+  if (is_string_entry(last) && !last.indefinite()) {
+    end += size_t(last.value);
+  }
+  size_t start = size_t(entries[index_].offset);
+  return bytes_view(tape_->data_ + start, end - start);
+}
+
+string_view TapeItem::as_string_view() const {
+  if (!is_string() && !is_binary()) {
+    return string_view();
+  }
+  const Tape::Entry &entry = tape_->entries_[index_];
+  if (entry.indefinite()) {
+    return string_view();
+  }
+  const uint8_t *payload =
+      tape_->data_ + entry.offset + minor_head_size(entry.minor());
+  return string_view(reinterpret_cast<const char *>(payload),
+                     size_t(entry.value));
+}
+
+bytes_view TapeItem::as_bytes_view() const {
+  string_view view = as_string_view();
+  return bytes_view(reinterpret_cast<const uint8_t *>(view.data()),
+                    view.size());
+}
+
+TapeItem::operator std::vector<uint8_t>() const {
+  return to_item().operator std::vector<uint8_t>();
+}
+
+TapeItem::operator std::string() const { return to_item(); }
+
+DataItem TapeItem::to_item(const decode_options &options) const {
+  DataItem item;
+  if (tape_ != nullptr) {
+    bytes_view bytes = encoded();
+    item.read(bytes.data(), bytes.size(), options);
+  }
+  return item;
+}
+
+} // namespace cbor
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+class Tape;
+
+/**
+ * @brief Handle to one entry of a Tape, navigated in constant time per hop.
+ * Only valid while the Tape is neither re-indexed nor destroyed.
+ */
+class TapeItem {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = TapeItem;
+    using pointer = void;
+    using reference = TapeItem;
+
+    iterator(const Tape *tape, const uint32_t *pos, size_t stride)
+        : tape_(tape), pos_(pos), stride_(stride) {}
+
+    // for map iteration;
+    TapeItem key() const { return TapeItem(tape_, pos_[0]); }
+    TapeItem value() const { return TapeItem(tape_, pos_[1]); }
+
+    TapeItem operator*() const { return TapeItem(tape_, *pos_); }
+
+    iterator &operator++() {
+      pos_ += stride_;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator tmp = *this;
+      pos_ += stride_;
+      return tmp;
+    }
+
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a.pos_ == b.pos_;
+    }
+    friend bool operator!=(const iterator &a, const iterator &b) {
+      return a.pos_ != b.pos_;
+    }
+
+  private:
+    const Tape *tape_;
+    const uint32_t *pos_;
+    size_t stride_;
+  };
+
+  /**
+   * @brief An undefined item, also returned for missing children.
+   */
+  TapeItem() : tape_(nullptr), index_(0) {}
+  TapeItem(const Tape *tape, size_t index) : tape_(tape), index_(index) {}
+
+  type_t type() const;
+
+  bool is_unsigned() const { return type() == type_t::Unsigned; }
+  bool is_int() const {
+    return type() == type_t::Unsigned || type() == type_t::Negative;
+  }
+  bool is_binary() const { return type() == type_t::Binary; }
+  bool is_string() const { return type() == type_t::String; }
+  bool is_array() const { return type() == type_t::Array; }
+  bool is_map() const { return type() == type_t::Map; }
+  bool is_tagged() const { return type() == type_t::Tagged; }
+  bool is_simple() const { return type() == type_t::Simple; }
+  bool is_null() const;
+  bool is_undefined() const;
+  bool is_float() const { return type() == type_t::Float; }
+
+  /**
+   * @brief Number of elements of an array or pairs of a map, 0 otherwise.
+   */
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  /**
+   * @brief Array element by index in constant time.
+   */
+  TapeItem at(size_t index) const;
+
+  /**
+   * @brief Look up a map entry by comparing the keys in place; an undefined
+   * item is returned when the key is missing.
+   */
+  TapeItem operator[](const char *key) const;
+  TapeItem operator[](const std::string &key) const;
+  TapeItem operator[](const DataItem &key) const;
+
+  iterator begin() const;
+  iterator end() const;
+
+  uint64_t tag() const;
+  TapeItem child() const;
+
+  /**
+   * @brief Position of this item in Tape::entries().
+   */
+  size_t index() const { return index_; }
+
+  /**
+   * @brief The encoded bytes of this item, without scanning them.
+   */
+  bytes_view encoded() const;
+
+  /**
+   * @brief Bytes of a definite-length text or byte string, pointing into
+   * the buffer; empty for chunked strings.
+   */
+  string_view as_string_view() const;
+  bytes_view as_bytes_view() const;
+
+  operator uint8_t() const { return to_item(); }
+  operator uint16_t() const { return to_item(); }
+  operator uint32_t() const { return to_item(); }
+  operator uint64_t() const { return to_item(); }
+
+  operator bool() const { return to_item(); }
+  operator int8_t() const { return to_item(); }
+  operator int16_t() const { return to_item(); }
+  operator int32_t() const { return to_item(); }
+  operator int64_t() const { return to_item(); }
+
+  operator float() const { return to_item(); }
+  operator double() const { return to_item(); }
+
+  operator std::vector<uint8_t>() const;
+  operator std::string() const;
+  operator cbor::simple() const { return to_item(); }
+
+  /**
+   * @brief Decode this item and everything below it.
+   */
+  DataItem to_item(const decode_options &options = decode_options()) const;
+  std::string dump(int indent = 2) const { return to_item().dump(indent); }
+
+private:
+  const Tape *tape_;
+  size_t index_;
+
+  TapeItem find(const char *key, size_t size) const;
+};
+
+/**
+ * @brief Structural index of an encoded buffer, built in one pass.
+ *
+ * Every head of the item becomes an Entry in encoding order, recording
+ * where it starts, its value and where its subtree ends, so skipping a
+ * container is a single jump. The children of each container are listed
+ * contiguously as well, which makes element access by index constant time.
+ * Breaks are not recorded. Repeated queries over the same buffer read the
+ * tape instead of decoding heads again.
+ *
+ * The buffer must stay alive and unchanged while the tape is in use.
+ */
+class Tape {
+public:
+  struct Entry {
+    // integer, simple value, tag, string length or element count; for
+    // chunked strings and indefinite-length containers the totals;
+    uint64_t value;
+    // of the head within the buffer;
+    uint64_t offset;
+    // index of the first entry after this item's subtree;
+    uint32_t next;
+    // start of the children in Tape::children(), for containers and tags;
+    uint32_t children;
+    // first byte of the head;
+    uint8_t initial;
+
+    int major() const { return initial >> 5; }
+    int minor() const { return initial & 31; }
+    bool indefinite() const { return minor() == 31; }
+  };
+
+  Tape() : data_(nullptr), size_(0) {}
+
+  /**
+   * @brief Index the data item at the start of [data, data + size),
+   * replacing the current tape.
+   * @return bytes taken by the item, or 0 if it is malformed, the tape is
+   * then empty.
+   */
+  size_t index(const uint8_t *data, size_t size);
+  size_t index(const std::vector<uint8_t> &data);
+
+  void clear();
+
+  TapeItem root() const {
+    return entries_.empty() ? TapeItem() : TapeItem(this, 0);
+  }
+
+  const std::vector<Entry> &entries() const { return entries_; }
+  /**
+   * @brief Entry indices of the children of every container and tag,
+   * grouped per parent; map keys and values alternate.
+   */
+  const std::vector<uint32_t> &children() const { return children_; }
+  const uint8_t *data() const { return data_; }
+
+  friend class TapeItem;
+
+private:
+  const uint8_t *data_;
+  // bytes taken by the root item;
+  size_t size_;
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> children_;
+};
+
+} // namespace cbor
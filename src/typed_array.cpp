@@ -0,0 +1,350 @@
+#include "cbor.hpp"
+#include "detail.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(CBOR_X86)
+#include <immintrin.h>
+#elif defined(CBOR_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cbor {
+
+namespace {
+
+#if defined(CBOR_LITTLE_ENDIAN)
+const bool host_little_endian = true;
+#else
+const bool host_little_endian = false;
+#endif
+
+// Element type of an RFC 8746 typed array, from the bits 0b010_f_s_e_ll of
+// its tag: float, signed, little endian and the size;
+struct element_format {
+  size_t width;
+  bool is_float;
+  bool is_signed;
+  bool little_endian;
+};
+
+bool typed_format(uint64_t tag, element_format &format) {
+  if (tag < 64 || tag > 87) {
+    return false;
+  }
+  unsigned bits = unsigned(tag - 64);
+  unsigned ll = bits & 3;
+  format.is_float = (bits & 16) != 0;
+  format.is_signed = (bits & 8) != 0 || format.is_float;
+  format.little_endian = (bits & 4) != 0;
+  if (format.is_float) {
+    // 128-bit floats have no C++ type to go to;
+    format.width = size_t(2) << ll;
+    return ll != 3;
+  }
+  format.width = size_t(1) << ll;
+  // tag 76 would be a little-endian int8, which is reserved;
+  return !(format.is_signed && format.little_endian && ll == 0);
+}
+
+// The byte string of a typed array, if `child` is one for `tag`;
+bool typed_bytes(uint64_t tag, const DataItem &child, element_format &format,
+                 bytes_view &bytes) {
+  if (!typed_format(tag, format) || !child.is_binary()) {
+    return false;
+  }
+  bytes = child.as_bytes_view();
+  return bytes.size() % format.width == 0;
+}
+
+template <typename T> uint64_t typed_tag() {
+  const bool is_float = std::is_floating_point<T>::value;
+  uint64_t ll = sizeof(T) == 1   ? 0
+                : sizeof(T) == 2 ? 1
+                : sizeof(T) == 4 ? 2
+                                 : 3;
+  uint64_t tag = 64 | (is_float ? 16 : 0) | (is_float ? ll - 1 : ll);
+  if (std::is_signed<T>::value && !is_float) {
+    tag |= 8;
+  }
+  if (host_little_endian && sizeof(T) > 1) {
+    tag |= 4;
+  }
+  return tag;
+}
+
+template <typename T>
+T read_element(const uint8_t *p, const element_format &f) {
+  bool swap = f.little_endian != host_little_endian;
+  uint64_t bits = 0;
+  switch (f.width) {
+  case 1:
+    bits = *p;
+    break;
+  case 2: {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    bits = swap ? detail::byteswap(v) : v;
+    break;
+  }
+  case 4: {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    bits = swap ? detail::byteswap(v) : v;
+    break;
+  }
+  default:
+    memcpy(&bits, p, 8);
+    bits = swap ? detail::byteswap(bits) : bits;
+    break;
+  }
+  if (f.is_float) {
+    return T(detail::decode_float(f.width == 2 ? 25 : f.width == 4 ? 26 : 27,
+                                  bits));
+  }
+  if (f.is_signed) {
+    unsigned shift = unsigned(64 - 8 * f.width);
+    return T(int64_t(bits << shift) >> shift);
+  }
+  return T(bits);
+}
+
+template <typename T> T number_as(const DataItem &item) {
+  if (std::is_floating_point<T>::value) {
+    return T(double(item));
+  }
+  return std::is_signed<T>::value ? T(int64_t(item)) : T(uint64_t(item));
+}
+
+/* ----------------------- byte swap ----------------------- */
+typedef void (*swap_kernel)(uint8_t *out, const uint8_t *in, size_t size,
+                            size_t width);
+
+void swap_scalar(uint8_t *out, const uint8_t *in, size_t size, size_t width) {
+  for (size_t i = 0; i + width <= size; i += width) {
+    if (width == 2) {
+      uint16_t v;
+      memcpy(&v, in + i, 2);
+      v = detail::byteswap(v);
+      memcpy(out + i, &v, 2);
+    } else if (width == 4) {
+      uint32_t v;
+      memcpy(&v, in + i, 4);
+      v = detail::byteswap(v);
+      memcpy(out + i, &v, 4);
+    } else {
+      uint64_t v;
+      memcpy(&v, in + i, 8);
+      v = detail::byteswap(v);
+      memcpy(out + i, &v, 8);
+    }
+  }
+}
+
+#if defined(CBOR_X86)
+// Shuffle that reverses every `width` bytes of a 16-byte lane;
+void swap_mask(uint8_t *mask, size_t width) {
+  for (size_t i = 0; i < 16; ++i) {
+    mask[i] = uint8_t(i / width * width + (width - 1 - i % width));
+  }
+}
+
+CBOR_TARGET("sse4.2")
+void swap_sse(uint8_t *out, const uint8_t *in, size_t size, size_t width) {
+  uint8_t bytes[16];
+  swap_mask(bytes, width);
+  __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_shuffle_epi8(v, mask));
+  }
+  swap_scalar(out + i, in + i, size - i, width);
+}
+
+CBOR_TARGET("avx2")
+void swap_avx2(uint8_t *out, const uint8_t *in, size_t size, size_t width) {
+  uint8_t bytes[16];
+  swap_mask(bytes, width);
+  // the shuffle stays within 128-bit lanes, which hold whole elements;
+  __m256i mask = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes)));
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_shuffle_epi8(v, mask));
+  }
+  swap_scalar(out + i, in + i, size - i, width);
+}
+#endif // CBOR_X86
+
+#if defined(CBOR_NEON)
+void swap_neon(uint8_t *out, const uint8_t *in, size_t size, size_t width) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    uint8x16_t v = vld1q_u8(in + i);
+    v = width == 2 ? vrev16q_u8(v) : width == 4 ? vrev32q_u8(v) : vrev64q_u8(v);
+    vst1q_u8(out + i, v);
+  }
+  swap_scalar(out + i, in + i, size - i, width);
+}
+#endif // CBOR_NEON
+
+swap_kernel select_swap_kernel() {
+#if defined(CBOR_X86)
+  if (detail::has_avx2()) {
+    return swap_avx2;
+  }
+  if (detail::has_sse42()) {
+    return swap_sse;
+  }
+#elif defined(CBOR_NEON)
+  return swap_neon;
+#endif
+  return swap_scalar;
+}
+
+void swap_bytes(uint8_t *out, const uint8_t *in, size_t size, size_t width) {
+  static const swap_kernel kernel = select_swap_kernel();
+  kernel(out, in, size, width);
+}
+
+/* ----------------------- half precision ----------------------- */
+// Half-precision elements are converted a block at a time, so that the
+// bulk kernel sees the halves in host order;
+const size_t half_block = 256;
+
+void convert_halves(float *out, const uint16_t *in, size_t count) {
+  detail::halves_to_floats(out, in, count);
+}
+
+template <typename T>
+void convert_halves(T *out, const uint16_t *in, size_t count) {
+  float floats[half_block];
+  detail::halves_to_floats(floats, in, count);
+  std::copy(floats, floats + count, out);
+}
+
+template <typename T>
+std::vector<T> read_halves(bytes_view bytes, const element_format &format) {
+  size_t count = bytes.size() / 2;
+  std::vector<T> values(count);
+  uint16_t halves[half_block];
+  for (size_t i = 0; i < count; i += half_block) {
+    size_t n = std::min(half_block, count - i);
+    const uint8_t *in = bytes.data() + 2 * i;
+    if (format.little_endian == host_little_endian) {
+      memcpy(halves, in, 2 * n);
+    } else {
+      swap_bytes(reinterpret_cast<uint8_t *>(halves), in, 2 * n, 2);
+    }
+    convert_halves(values.data() + i, halves, n);
+  }
+  return values;
+}
+
+} // namespace
+
+/* ----------------------- typed arrays ----------------------- */
+bool DataItem::is_typed_array() const {
+  element_format format;
+  bytes_view bytes;
+  return type_ == type_t::Tagged &&
+         typed_bytes(tagged_->tag, tagged_->item, format, bytes);
+}
+
+template <typename T> typed_view<T> DataItem::as_typed() const {
+  if (type_ == type_t::Array) {
+    std::vector<T> values(array_->size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = number_as<T>((*array_)[i]);
+    }
+    return typed_view<T>(std::move(values));
+  }
+  element_format format;
+  bytes_view bytes;
+  if (type_ != type_t::Tagged ||
+      !typed_bytes(tagged_->tag, tagged_->item, format, bytes)) {
+    return typed_view<T>();
+  }
+  size_t count = bytes.size() / format.width;
+  bool same_type = format.width == sizeof(T) &&
+                   format.is_float == std::is_floating_point<T>::value &&
+                   format.is_signed == std::is_signed<T>::value;
+  if (format.is_float && format.width == 2 &&
+      std::is_floating_point<T>::value) {
+    return typed_view<T>(read_halves<T>(bytes, format));
+  }
+  if (!same_type) {
+    std::vector<T> values(count);
+    for (size_t i = 0; i < count; ++i) {
+      values[i] = read_element<T>(bytes.data() + i * format.width, format);
+    }
+    return typed_view<T>(std::move(values));
+  }
+  if (count == 0) {
+    return typed_view<T>();
+  }
+  bool native = sizeof(T) == 1 || format.little_endian == host_little_endian;
+  if (native && uintptr_t(bytes.data()) % alignof(T) == 0) {
+    return typed_view<T>(reinterpret_cast<const T *>(bytes.data()), count);
+  }
+  std::vector<T> values(count);
+  uint8_t *out = reinterpret_cast<uint8_t *>(values.data());
+  if (native) {
+    memcpy(out, bytes.data(), bytes.size());
+  } else {
+    swap_bytes(out, bytes.data(), bytes.size(), sizeof(T));
+  }
+  return typed_view<T>(std::move(values));
+}
+
+template <typename T>
+DataItem DataItem::typed_array(const T *values, size_t count) {
+  DataItem result;
+  result.type_ = type_t::Tagged;
+  result.tagged_ = new Tagged{typed_tag<T>(), DataItem()};
+  result.tagged_->item.set_bytes(type_t::Binary,
+                                 reinterpret_cast<const char *>(values),
+                                 count * sizeof(T));
+  return result;
+}
+
+DataItem DataItem::half_array(const float *values, size_t count) {
+  DataItem result;
+  result.type_ = type_t::Tagged;
+  result.tagged_ = new Tagged{host_little_endian ? 84u : 80u, DataItem()};
+  std::vector<uint16_t> halves(count);
+  detail::floats_to_halves(halves.data(), values, count);
+  result.tagged_->item.set_bytes(
+      type_t::Binary, reinterpret_cast<const char *>(halves.data()),
+      count * 2);
+  return result;
+}
+
+template typed_view<uint8_t> DataItem::as_typed<uint8_t>() const;
+template typed_view<uint16_t> DataItem::as_typed<uint16_t>() const;
+template typed_view<uint32_t> DataItem::as_typed<uint32_t>() const;
+template typed_view<uint64_t> DataItem::as_typed<uint64_t>() const;
+template typed_view<int8_t> DataItem::as_typed<int8_t>() const;
+template typed_view<int16_t> DataItem::as_typed<int16_t>() const;
+template typed_view<int32_t> DataItem::as_typed<int32_t>() const;
+template typed_view<int64_t> DataItem::as_typed<int64_t>() const;
+template typed_view<float> DataItem::as_typed<float>() const;
+template typed_view<double> DataItem::as_typed<double>() const;
+
+template DataItem DataItem::typed_array(const uint8_t *, size_t);
+template DataItem DataItem::typed_array(const uint16_t *, size_t);
+template DataItem DataItem::typed_array(const uint32_t *, size_t);
+template DataItem DataItem::typed_array(const uint64_t *, size_t);
+template DataItem DataItem::typed_array(const int8_t *, size_t);
+template DataItem DataItem::typed_array(const int16_t *, size_t);
+template DataItem DataItem::typed_array(const int32_t *, size_t);
+template DataItem DataItem::typed_array(const int64_t *, size_t);
+template DataItem DataItem::typed_array(const float *, size_t);
+template DataItem DataItem::typed_array(const double *, size_t);
+
+} // namespace cbor
@@ -0,0 +1,396 @@
+#include "cbor.hpp"
+#include "detail.hpp"
+
+#if defined(CBOR_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(CBOR_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cbor {
+
+/* ----------------------- scalar ----------------------- */
+namespace detail {
+
+bool is_utf8_scalar(const uint8_t *p, size_t size) {
+  const uint8_t *end = p + size;
+  while (p != end) {
+    if (end - p >= 8) {
+      uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      if ((word & 0x8080808080808080ull) == 0) {
+        p += 8;
+        continue;
+      }
+    }
+    uint8_t lead = *p;
+    if (lead < 0x80) {
+      ++p;
+      continue;
+    }
+    // the valid range of the second byte depends on the lead byte, see
+    // table 3-7 of the Unicode standard;
+    size_t length = 0;
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      length = 3;
+      low = lead == 0xe0 ? 0xa0 : 0x80;
+      high = lead == 0xed ? 0x9f : 0xbf;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      length = 4;
+      low = lead == 0xf0 ? 0x90 : 0x80;
+      high = lead == 0xf4 ? 0x8f : 0xbf;
+    } else {
+      return false;
+    }
+    if (size_t(end - p) < length || p[1] < low || p[1] > high) {
+      return false;
+    }
+    for (size_t i = 2; i < length; i++) {
+      if ((p[i] & 0xc0) != 0x80) {
+        return false;
+      }
+    }
+    p += length;
+  }
+  return true;
+}
+
+} // namespace detail
+
+// The vector kernels classify every byte together with the one in front of
+// it through three 16-entry lookups, as described by Keiser and Lemire in
+// "Validating UTF-8 In Less Than One Instruction Per Byte". A bit that
+// survives the AND of the lookups flags an error; continuation bytes owed
+// to 3 and 4 byte sequences are checked from the bytes 2 and 3 back.
+namespace {
+
+const uint8_t TooShort = 1 << 0;
+const uint8_t TooLong = 1 << 1;
+const uint8_t Overlong3 = 1 << 2;
+const uint8_t TooLarge = 1 << 3;
+const uint8_t Surrogate = 1 << 4;
+const uint8_t Overlong2 = 1 << 5;
+const uint8_t TooLarge1000 = 1 << 6;
+const uint8_t Overlong4 = 1 << 6;
+const uint8_t TwoConts = 1 << 7;
+const uint8_t Carry = TooShort | TooLong | TwoConts;
+
+// indexed by the high nibble of the previous byte;
+const uint8_t byte_1_high[16] = {
+    TooLong,   TooLong,   TooLong,   TooLong,
+    TooLong,   TooLong,   TooLong,   TooLong,
+    TwoConts,  TwoConts,  TwoConts,  TwoConts,
+    TooShort | Overlong2,
+    TooShort,
+    TooShort | Overlong3 | Surrogate,
+    TooShort | TooLarge | TooLarge1000 | Overlong4};
+
+// indexed by the low nibble of the previous byte;
+const uint8_t byte_1_low[16] = {
+    Carry | Overlong3 | Overlong2 | Overlong4,
+    Carry | Overlong2,
+    Carry,
+    Carry,
+    Carry | TooLarge,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000 | Surrogate,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000};
+
+// indexed by the high nibble of the current byte;
+const uint8_t byte_2_high[16] = {
+    TooShort, TooShort, TooShort, TooShort,
+    TooShort, TooShort, TooShort, TooShort,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooShort, TooShort, TooShort, TooShort};
+
+// a lead byte in the last 3 positions above these starts a sequence that
+// continues in the next block;
+const uint8_t incomplete_max[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf};
+
+} // namespace
+
+#if defined(CBOR_X86)
+/* ----------------------- SSE4.2 ----------------------- */
+namespace {
+
+struct sse_state {
+  __m128i error;
+  __m128i prev_input;
+  __m128i prev_incomplete;
+};
+
+CBOR_TARGET("sse4.2")
+inline __m128i sse_high_nibble(__m128i v) {
+  return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+}
+
+CBOR_TARGET("sse4.2")
+inline void sse_step(sse_state &state, __m128i input) {
+  if (_mm_movemask_epi8(input) == 0) {
+    state.error = _mm_or_si128(state.error, state.prev_incomplete);
+    state.prev_input = input;
+    return;
+  }
+  const __m128i table_1_high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(byte_1_high));
+  const __m128i table_1_low =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(byte_1_low));
+  const __m128i table_2_high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(byte_2_high));
+  __m128i prev1 = _mm_alignr_epi8(input, state.prev_input, 15);
+  __m128i low_nibble = _mm_and_si128(prev1, _mm_set1_epi8(0x0f));
+  __m128i special = _mm_and_si128(
+      _mm_and_si128(_mm_shuffle_epi8(table_1_high, sse_high_nibble(prev1)),
+                    _mm_shuffle_epi8(table_1_low, low_nibble)),
+      _mm_shuffle_epi8(table_2_high, sse_high_nibble(input)));
+  __m128i prev2 = _mm_alignr_epi8(input, state.prev_input, 14);
+  __m128i prev3 = _mm_alignr_epi8(input, state.prev_input, 13);
+  __m128i must_continue =
+      _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                   _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80)));
+  must_continue = _mm_and_si128(must_continue, _mm_set1_epi8(char(0x80)));
+  state.error =
+      _mm_or_si128(state.error, _mm_xor_si128(must_continue, special));
+  state.prev_incomplete = _mm_subs_epu8(
+      input,
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(incomplete_max + 16)));
+  state.prev_input = input;
+}
+
+CBOR_TARGET("sse4.2")
+bool is_utf8_sse(const uint8_t *p, size_t size) {
+  sse_state state;
+  state.error = _mm_setzero_si128();
+  state.prev_input = _mm_setzero_si128();
+  state.prev_incomplete = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    sse_step(state,
+             _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)));
+  }
+  // the zero padding is ASCII, which also flags a sequence cut off by the
+  // end of the input;
+  uint8_t tail[16] = {0};
+  memcpy(tail, p + i, size - i);
+  sse_step(state, _mm_loadu_si128(reinterpret_cast<const __m128i *>(tail)));
+  return _mm_testz_si128(state.error, state.error) != 0;
+}
+
+/* ----------------------- AVX2 ----------------------- */
+struct avx2_state {
+  __m256i error;
+  __m256i prev_input;
+  __m256i prev_incomplete;
+};
+
+CBOR_TARGET("avx2")
+inline __m256i avx2_table(const uint8_t *table) {
+  return _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(table)));
+}
+
+CBOR_TARGET("avx2")
+inline __m256i avx2_high_nibble(__m256i v) {
+  return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+}
+
+CBOR_TARGET("avx2")
+inline void avx2_step(avx2_state &state, __m256i input) {
+  if (_mm256_movemask_epi8(input) == 0) {
+    state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+    state.prev_input = input;
+    return;
+  }
+  // the upper lane of the previous block followed by the lower lane of
+  // this one, so that the byte shifts below cross the lane boundary;
+  __m256i shifted = _mm256_permute2x128_si256(state.prev_input, input, 0x21);
+  __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+  __m256i special = _mm256_and_si256(
+      _mm256_and_si256(
+          _mm256_shuffle_epi8(avx2_table(byte_1_high), avx2_high_nibble(prev1)),
+          _mm256_shuffle_epi8(avx2_table(byte_1_low),
+                              _mm256_and_si256(prev1, _mm256_set1_epi8(0x0f)))),
+      _mm256_shuffle_epi8(avx2_table(byte_2_high), avx2_high_nibble(input)));
+  __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+  __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+  __m256i must_continue =
+      _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+                      _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80)));
+  must_continue =
+      _mm256_and_si256(must_continue, _mm256_set1_epi8(char(0x80)));
+  state.error =
+      _mm256_or_si256(state.error, _mm256_xor_si256(must_continue, special));
+  state.prev_incomplete = _mm256_subs_epu8(
+      input,
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(incomplete_max)));
+  state.prev_input = input;
+}
+
+CBOR_TARGET("avx2")
+bool is_utf8_avx2(const uint8_t *p, size_t size) {
+  avx2_state state;
+  state.error = _mm256_setzero_si256();
+  state.prev_input = _mm256_setzero_si256();
+  state.prev_incomplete = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    avx2_step(state,
+              _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i)));
+  }
+  uint8_t tail[32] = {0};
+  memcpy(tail, p + i, size - i);
+  avx2_step(state,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tail)));
+  return _mm256_testz_si256(state.error, state.error) != 0;
+}
+
+} // namespace
+
+/* ----------------------- cpu features ----------------------- */
+namespace detail {
+
+#if defined(_MSC_VER) && !defined(__clang__)
+bool has_sse42() {
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+}
+
+bool has_avx2() {
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  // the OS must save the YMM registers too;
+  if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+}
+
+bool has_f16c() {
+  int info[4];
+  __cpuid(info, 1);
+  // F16C works on YMM registers, so AVX must be usable as well;
+  const int bits = 1 << 29 | 1 << 28 | 1 << 27;
+  return (info[2] & bits) == bits && (_xgetbv(0) & 6) == 6;
+}
+#else
+bool has_sse42() { return __builtin_cpu_supports("sse4.2"); }
+bool has_avx2() { return __builtin_cpu_supports("avx2"); }
+bool has_f16c() {
+  return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+#endif
+
+} // namespace detail
+#endif // CBOR_X86
+
+#if defined(CBOR_NEON)
+/* ----------------------- NEON ----------------------- */
+namespace {
+
+struct neon_state {
+  uint8x16_t error;
+  uint8x16_t prev_input;
+  uint8x16_t prev_incomplete;
+};
+
+inline void neon_step(neon_state &state, uint8x16_t input) {
+  if (vmaxvq_u8(input) < 0x80) {
+    state.error = vorrq_u8(state.error, state.prev_incomplete);
+    state.prev_input = input;
+    return;
+  }
+  uint8x16_t prev1 = vextq_u8(state.prev_input, input, 15);
+  uint8x16_t special =
+      vandq_u8(vandq_u8(vqtbl1q_u8(vld1q_u8(byte_1_high), vshrq_n_u8(prev1, 4)),
+                        vqtbl1q_u8(vld1q_u8(byte_1_low),
+                                   vandq_u8(prev1, vdupq_n_u8(0x0f)))),
+               vqtbl1q_u8(vld1q_u8(byte_2_high), vshrq_n_u8(input, 4)));
+  uint8x16_t prev2 = vextq_u8(state.prev_input, input, 14);
+  uint8x16_t prev3 = vextq_u8(state.prev_input, input, 13);
+  uint8x16_t must_continue =
+      vorrq_u8(vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80)),
+               vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80)));
+  must_continue = vandq_u8(must_continue, vdupq_n_u8(0x80));
+  state.error = vorrq_u8(state.error, veorq_u8(must_continue, special));
+  state.prev_incomplete = vqsubq_u8(input, vld1q_u8(incomplete_max + 16));
+  state.prev_input = input;
+}
+
+bool is_utf8_neon(const uint8_t *p, size_t size) {
+  neon_state state;
+  state.error = vdupq_n_u8(0);
+  state.prev_input = vdupq_n_u8(0);
+  state.prev_incomplete = vdupq_n_u8(0);
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    neon_step(state, vld1q_u8(p + i));
+  }
+  uint8_t tail[16] = {0};
+  memcpy(tail, p + i, size - i);
+  neon_step(state, vld1q_u8(tail));
+  return vmaxvq_u8(state.error) == 0;
+}
+
+} // namespace
+#endif // CBOR_NEON
+
+/* ----------------------- dispatch ----------------------- */
+namespace {
+
+typedef bool (*utf8_kernel)(const uint8_t *, size_t);
+
+utf8_kernel select_utf8_kernel() {
+#if defined(CBOR_X86)
+  if (detail::has_avx2()) {
+    return is_utf8_avx2;
+  }
+  if (detail::has_sse42()) {
+    return is_utf8_sse;
+  }
+#elif defined(CBOR_NEON)
+  return is_utf8_neon;
+#endif
+  return detail::is_utf8_scalar;
+}
+
+} // namespace
+
+bool is_utf8(const char *data, size_t size) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  // short strings, the bulk of map keys, are done before a vector kernel
+  // would have loaded its tables;
+  if (size < 16) {
+    return detail::is_utf8_scalar(p, size);
+  }
+  static const utf8_kernel kernel = select_utf8_kernel();
+  return kernel(p, size);
+}
+
+} // namespace cbor
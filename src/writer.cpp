@@ -0,0 +1,199 @@
+#include "writer.hpp"
+#include "detail.hpp"
+
+#include <cassert>
+
+namespace cbor {
+
+Writer::Writer() : out_(&own_) {}
+
+Writer::Writer(std::vector<uint8_t> &out) : out_(&out) {}
+
+void Writer::clear() {
+  out_->clear();
+  frames_.clear();
+}
+
+void Writer::head(int major, uint64_t value) {
+  uint8_t buffer[9];
+  uint8_t *end = detail::write_head(buffer, major, value);
+  out_->insert(out_->end(), buffer, end);
+}
+
+// Checks that the innermost open item accepts a child of type `major`;
+void Writer::before_item(int major) {
+  (void)major;
+  if (frames_.empty()) {
+    return;
+  }
+  switch (frames_.back().kind) {
+  case IndefiniteBytes:
+    assert(major == major::ByteString && "chunk of another type");
+    break;
+  case IndefiniteText:
+    assert(major == major::TextString && "chunk of another type");
+    break;
+  default:
+    break;
+  }
+}
+
+// Counts one finished child against the open items, closing the definite
+// ones it completes;
+void Writer::after_item() {
+  while (!frames_.empty()) {
+    Frame &frame = frames_.back();
+    if (frame.kind > Tag) {
+      ++frame.count;
+      return;
+    }
+    if (--frame.count != 0) {
+      return;
+    }
+    frames_.pop_back();
+  }
+}
+
+void Writer::open(frame_kind kind, uint64_t count) {
+  if (kind <= Tag && count == 0) {
+    after_item();
+    return;
+  }
+  Frame frame = {count, kind};
+  frames_.push_back(frame);
+}
+
+void Writer::check_key() const {
+  assert(!frames_.empty() && "key outside a map");
+  assert((frames_.back().kind == DefiniteMap ||
+          frames_.back().kind == IndefiniteMap) &&
+         "key outside a map");
+  assert(frames_.back().count % 2 == 0 && "key in value position");
+}
+
+Writer &Writer::begin_array(uint64_t size) {
+  before_item(major::Array);
+  head(major::Array, size);
+  open(DefiniteArray, size);
+  return *this;
+}
+
+Writer &Writer::begin_array() {
+  before_item(major::Array);
+  out_->push_back(major::Array << 5 | 31);
+  open(IndefiniteArray, 0);
+  return *this;
+}
+
+Writer &Writer::begin_map(uint64_t size) {
+  assert(size <= UINT64_MAX / 2 && "map too large");
+  before_item(major::Map);
+  head(major::Map, size);
+  open(DefiniteMap, size * 2);
+  return *this;
+}
+
+Writer &Writer::begin_map() {
+  before_item(major::Map);
+  out_->push_back(major::Map << 5 | 31);
+  open(IndefiniteMap, 0);
+  return *this;
+}
+
+Writer &Writer::begin_string() {
+  // chunks themselves must have a definite length;
+  before_item(major::Simple);
+  out_->push_back(major::TextString << 5 | 31);
+  open(IndefiniteText, 0);
+  return *this;
+}
+
+Writer &Writer::begin_bytes() {
+  before_item(major::Simple);
+  out_->push_back(major::ByteString << 5 | 31);
+  open(IndefiniteBytes, 0);
+  return *this;
+}
+
+Writer &Writer::tag(uint64_t tag) {
+  before_item(major::Tag);
+  head(major::Tag, tag);
+  open(Tag, 1);
+  return *this;
+}
+
+Writer &Writer::end() {
+  assert(!frames_.empty() && "end() without an open item");
+  assert(frames_.back().kind > Tag && "end() of a definite-length item");
+  assert((frames_.back().kind != IndefiniteMap ||
+          frames_.back().count % 2 == 0) &&
+         "map key without a value");
+  out_->push_back(0xff);
+  frames_.pop_back();
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value_signed(long long value) {
+  if (value < 0) {
+    before_item(major::Negative);
+    head(major::Negative, ~uint64_t(value));
+    after_item();
+    return *this;
+  }
+  return value_unsigned(value);
+}
+
+Writer &Writer::value_unsigned(unsigned long long value) {
+  before_item(major::Unsigned);
+  head(major::Unsigned, value);
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value(bool value) {
+  return this->value(value ? simple::True : simple::False);
+}
+
+Writer &Writer::value(simple value) {
+  before_item(major::Simple);
+  head(major::Simple, value);
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value(double value) {
+  before_item(major::Simple);
+  size_t size = out_->size();
+  out_->resize(size + detail::float_size(value));
+  detail::write_float(&(*out_)[size], value);
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value(string_view value) {
+  before_item(major::TextString);
+  head(major::TextString, value.size());
+  out_->insert(out_->end(), value.begin(), value.end());
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value(bytes_view value) {
+  before_item(major::ByteString);
+  head(major::ByteString, value.size());
+  out_->insert(out_->end(), value.begin(), value.end());
+  after_item();
+  return *this;
+}
+
+Writer &Writer::value(const DataItem &value) {
+  before_item(value.is_string()   ? major::TextString
+              : value.is_binary() ? major::ByteString
+                                  : major::Simple);
+  value.write(*out_);
+  after_item();
+  return *this;
+}
+
+} // namespace cbor
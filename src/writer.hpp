@@ -0,0 +1,149 @@
+#pragma once
+
+#include "cbor.hpp"
+
+#include <cstddef>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cbor {
+
+/**
+ * @brief Streaming encoder that appends heads and payloads straight to an
+ * output buffer, without building a DataItem tree first.
+ *
+ * Definite-length arrays and maps and tags close by themselves once their
+ * last child is written; indefinite-length items and chunked strings are
+ * closed with end(). Builds without NDEBUG assert that the calls form one
+ * well-formed item per top-level value: element counts, key positions,
+ * chunk types and end() against what is open.
+ *
+ *   writer.begin_map(2).key("id").value(7).key("tags").begin_array();
+ *   writer.value("a").value("b").end();
+ */
+class Writer {
+public:
+  /**
+   * @brief Write into a buffer owned by the writer, see buffer().
+   */
+  Writer();
+  /**
+   * @brief Append to `out`, which must outlive the writer.
+   */
+  explicit Writer(std::vector<uint8_t> &out);
+
+  Writer(const Writer &) = delete;
+  Writer &operator=(const Writer &) = delete;
+
+  Writer &begin_array(uint64_t size);
+  /**
+   * @brief Open an indefinite-length array, closed by end().
+   */
+  Writer &begin_array();
+  Writer &begin_map(uint64_t size);
+  Writer &begin_map();
+  /**
+   * @brief Open a chunked text string; every value() until end() must be
+   * a string and is written as one chunk.
+   */
+  Writer &begin_string();
+  /**
+   * @brief Open a chunked byte string; every value() until end() must be
+   * a byte string and is written as one chunk.
+   */
+  Writer &begin_bytes();
+  /**
+   * @brief Tag the next item.
+   */
+  Writer &tag(uint64_t tag);
+  /**
+   * @brief Close the innermost indefinite-length item.
+   */
+  Writer &end();
+
+  Writer &value(bool value);
+  Writer &value(int value) { return value_signed(value); }
+  Writer &value(long value) { return value_signed(value); }
+  Writer &value(long long value) { return value_signed(value); }
+  Writer &value(unsigned value) { return value_unsigned(value); }
+  Writer &value(unsigned long value) { return value_unsigned(value); }
+  Writer &value(unsigned long long value) { return value_unsigned(value); }
+  Writer &value(double value);
+  Writer &value(simple value);
+  Writer &value(std::nullptr_t) { return value(simple::Null); }
+
+  Writer &value(const char *value) {
+    return this->value(string_view(value, strlen(value)));
+  }
+  Writer &value(const std::string &value) {
+    return this->value(string_view(value.data(), value.size()));
+  }
+  Writer &value(string_view value);
+  Writer &value(const std::vector<uint8_t> &value) {
+    return this->value(bytes_view(value.data(), value.size()));
+  }
+  Writer &value(bytes_view value);
+  /**
+   * @brief Encode a whole DataItem as the next item.
+   */
+  Writer &value(const DataItem &value);
+
+  /**
+   * @brief Write a map key; the same as value() but asserts that a map is
+   * expecting a key.
+   */
+  template <typename T> Writer &key(const T &key) {
+    check_key();
+    return value(key);
+  }
+
+  /**
+   * @brief Number of items still open.
+   */
+  size_t depth() const { return frames_.size(); }
+
+  /**
+   * @brief Whether every item written so far is closed.
+   */
+  bool complete() const { return frames_.empty(); }
+
+  const std::vector<uint8_t> &buffer() const { return *out_; }
+
+  /**
+   * @brief Drop the output and any open items.
+   */
+  void clear();
+
+private:
+  enum frame_kind {
+    DefiniteArray,
+    DefiniteMap,
+    Tag,
+    IndefiniteArray,
+    IndefiniteMap,
+    IndefiniteBytes,
+    IndefiniteText
+  };
+
+  struct Frame {
+    // children left for definite items, children written for the others;
+    uint64_t count;
+    frame_kind kind;
+  };
+
+  std::vector<uint8_t> own_;
+  std::vector<uint8_t> *out_;
+  std::vector<Frame> frames_;
+
+  Writer &value_signed(long long value);
+  Writer &value_unsigned(unsigned long long value);
+  void head(int major, uint64_t value);
+  void before_item(int major);
+  void after_item();
+  void open(frame_kind kind, uint64_t count);
+  void check_key() const;
+};
+
+} // namespace cbor
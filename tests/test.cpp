@@ -1,7 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
 
+#include "canonical.hpp"
 #include "cbor.hpp"
+#include "detail.hpp"
+#include "document.hpp"
+#include "lazy.hpp"
+#include "mapped_file.hpp"
+#include "messages.hpp"
+#include "parallel.hpp"
+#include "push_decoder.hpp"
+#include "query.hpp"
+#include "sax.hpp"
+#include "sequence.hpp"
+#include "serialize.hpp"
+#include "stringref.hpp"
+#include "tape.hpp"
+#include "writer.hpp"
 
 using namespace cbor;
 
@@ -31,6 +54,16 @@ void test_array() {
     DataItem map = cbor::map({});
     assert(map.type() == cbor::type_t::Map);
     array.push_back(map);
+
+    // at() on anything but an array throws and leaves the item alone;
+    DataItem keyed = cbor::map({{"a", 1}});
+    bool thrown = false;
+    try {
+        keyed.at(0);
+    } catch (const std::out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown && keyed.is_map() && keyed["a"] == DataItem(1));
 }
 
 void test_map() {
@@ -59,9 +92,1641 @@ void test_map() {
     }
 }
 
+void test_decode() {
+    DataItem m = cbor::map({
+        {"name", "cbor"},
+        {"bytes", std::vector<uint8_t>{1, 2, 3}},
+        {"list", cbor::array({1, -2, 3.5, nullptr})},
+        {"big", uint64_t(1) << 40},
+    });
+    std::vector<uint8_t> buf = cbor::encode(m);
+    assert(cbor::decode(buf) == m);
+    assert(DataItem::validate(buf));
+
+    // truncated input and trailing bytes are rejected;
+    std::vector<uint8_t> truncated(buf.begin(), buf.end() - 1);
+    assert(!DataItem::validate(truncated));
+    DataItem item;
+    size_t used = item.read(truncated.data(), truncated.size());
+    assert(used == 0);
+    std::vector<uint8_t> trailing = buf;
+    trailing.push_back(0);
+    assert(cbor::decode(trailing).is_undefined());
+
+    // chunked strings: (_ h'0102', h'03') and (_ "ab", "c");
+    const uint8_t chunked[] = {0x82, 0x5f, 0x42, 0x01, 0x02, 0x41, 0x03, 0xff,
+                               0x7f, 0x62, 'a', 'b', 0x61, 'c', 0xff};
+    item = cbor::decode(chunked, sizeof(chunked));
+    assert(item.at(0) == DataItem(std::vector<uint8_t>{1, 2, 3}));
+    assert(item.at(1) == DataItem("abc"));
+    const uint8_t bad_chunk[] = {0x5f, 0x61, 'a', 0xff};
+    assert(cbor::decode(bad_chunk, sizeof(bad_chunk)).is_undefined());
+
+    // the stream adapter consumes exactly one item at a time;
+    std::string two(buf.begin(), buf.end());
+    two += std::string(chunked, chunked + sizeof(chunked));
+    std::istringstream in(two);
+    DataItem first, second;
+    in >> first >> second;
+    assert(in.good() && first == m && second.size() == 2);
+    in >> first;
+    assert(!in);
+}
+
+void test_encode() {
+    // {"a": 1, "b": [2, 3]} from RFC 8949 appendix A;
+    const uint8_t expected[] = {0xa2, 0x61, 'a', 0x01, 0x61, 'b',
+                                0x82, 0x02, 0x03};
+    DataItem m = cbor::map({{"a", 1}, {"b", cbor::array({2, 3})}});
+    assert(m.encoded_size() == sizeof(expected));
+    std::vector<uint8_t> buf = cbor::encode(m);
+    assert(buf == std::vector<uint8_t>(expected, expected + sizeof(expected)));
+    assert(buf.capacity() == buf.size());
+
+    uint8_t out[16];
+    size_t written = m.write(out, sizeof(expected) - 1);
+    assert(written == 0);
+    written = m.write(out, sizeof(out));
+    assert(written == sizeof(expected));
+    assert(memcmp(out, expected, sizeof(expected)) == 0);
+
+    // append mode keeps what is already in the vector;
+    std::vector<uint8_t> appended(1, 0xf6);
+    cbor::encode(m, appended);
+    assert(appended.size() == 1 + sizeof(expected) && appended[0] == 0xf6);
+
+    DataItem values = cbor::array({0, 23, 24, 255, 256, 65535, 65536,
+                                   uint64_t(1) << 32, -1, -1000, 1.5, 1.1,
+                                   "", std::vector<uint8_t>(), false});
+    std::ostringstream oss;
+    values.write(oss);
+    assert(oss.str().size() == values.encoded_size());
+    assert(cbor::decode(cbor::encode(values)) == values);
+}
+
+void test_layout() {
+    static_assert(sizeof(void *) != 8 || sizeof(DataItem) == 24,
+                  "DataItem is 24 bytes on 64-bit targets");
+
+    DataItem small = "short";
+    DataItem large = std::string(100, 'x');
+    DataItem bytes = std::vector<uint8_t>(17, 0xab);
+    assert(small.as<std::string>() == "short");
+    assert(large.as<std::string>() == std::string(100, 'x'));
+    assert(bytes.operator std::vector<uint8_t>().size() == 17);
+    assert(small < large && !(large < small));
+
+    DataItem copy = large;
+    DataItem moved = std::move(copy);
+    assert(moved == large && copy.is_undefined());
+
+    // assigning a child to its parent must not read freed memory;
+    DataItem nested = cbor::array({cbor::array({1, 2}), "tail"});
+    nested = nested.at(0);
+    assert(nested.size() == 2 && int(nested.at(1)) == 2);
+    nested = std::move(nested.at(0));
+    assert(int(nested) == 1);
+
+    DataItem tagged = DataItem::tagged(1, 1363896240);
+    DataItem tagged_copy = tagged;
+    assert(tagged_copy.tag() == 1 && int(tagged_copy.child()) == 1363896240);
+    assert(cbor::decode(cbor::encode(tagged)) == tagged);
+
+    // mutators switch the item to the container they need;
+    DataItem item = "was a string";
+    item["key"] = "value";
+    assert(item.is_map() && item.size() == 1);
+    item.push_back(1);
+    assert(item.is_array() && item.size() == 1);
+}
+
+void test_document() {
+    DataItem m = cbor::map({
+        {"id", 42},
+        {"neg", -7},
+        {"name", "a string that does not fit inline"},
+        {"tags", cbor::array({"x", "y", 1.5, nullptr})},
+        {"blob", std::vector<uint8_t>{9, 8, 7}},
+        {1, DataItem::tagged(32, "http://example.com")},
+    });
+    std::vector<uint8_t> buf = cbor::encode(m);
+
+    cbor::Document doc(64);
+    bool parsed = doc.parse(buf);
+    assert(parsed);
+    assert(doc.type() == cbor::type_t::Map && doc.size() == 6);
+    assert(int(doc["id"]) == 42 && int(doc["neg"]) == -7);
+    assert(std::string(doc["name"]) == "a string that does not fit inline");
+    assert(doc["tags"].size() == 4 && std::string(doc["tags"].at(1)) == "y");
+    assert(double(doc["tags"].at(2)) == 1.5 && doc["tags"].at(3).is_null());
+    assert(doc[DataItem(1)].tag() == 32);
+    assert(doc["missing"].is_undefined());
+    assert(doc.root().to_item() == m);
+
+    size_t count = 0;
+    for (cbor::Node::iterator it = doc.begin(); it != doc.end(); ++it) {
+        assert(m[it.key().to_item()] == it.value().to_item());
+        count++;
+    }
+    assert(count == 6);
+
+    // repeated keys keep the first value, as decode() does;
+    std::vector<uint8_t> repeated = {0xa2, 0x61, 0x6b, 0x01, 0x61, 0x6b, 0x02};
+    cbor::Document twice;
+    parsed = twice.parse(repeated);
+    assert(parsed);
+    DataItem converted = twice.root().to_item();
+    DataItem decoded = cbor::decode(repeated);
+    assert(int(twice["k"]) == 1 && converted["k"] == DataItem(1));
+    assert(converted == decoded);
+
+    // reset() recycles the arena instead of growing it;
+    size_t capacity = doc.arena().capacity();
+    for (int i = 0; i < 10; i++) {
+        parsed = doc.parse(buf);
+        assert(parsed);
+    }
+    assert(doc.arena().capacity() == capacity);
+
+    // indefinite containers and chunked strings;
+    const uint8_t indefinite[] = {0xbf, 0x61, 'a', 0x9f, 0x01, 0x02, 0xff,
+                                  0x61, 'b', 0x7f, 0x61, 'c', 0x61, 'd', 0xff,
+                                  0xff};
+    parsed = doc.parse(indefinite, sizeof(indefinite));
+    assert(parsed);
+    assert(doc["a"].size() == 2 && int(doc["a"].at(1)) == 2);
+    assert(std::string(doc["b"]) == "cd");
+
+    std::vector<uint8_t> truncated(buf.begin(), buf.end() - 1);
+    parsed = doc.parse(truncated);
+    assert(!parsed && doc.root().is_undefined());
+}
+
+void test_borrow() {
+    std::vector<uint8_t> blob(1000);
+    for (size_t i = 0; i < blob.size(); i++) {
+        blob[i] = uint8_t(i);
+    }
+    DataItem m = cbor::map({{"blob", blob}, {"text", "borrowed text"}});
+    std::vector<uint8_t> buf = cbor::encode(m);
+    const uint8_t *begin = buf.data();
+    const uint8_t *end = begin + buf.size();
+
+    cbor::decode_options options;
+    options.borrow = true;
+    DataItem item = cbor::decode(buf.data(), buf.size(), options);
+    assert(item == m);
+    cbor::bytes_view bytes = item["blob"].as_bytes_view();
+    assert(item["blob"].is_borrowed() && bytes.size() == blob.size());
+    assert(bytes.data() >= begin && bytes.data() + bytes.size() <= end);
+    cbor::string_view text = item["text"].as_string_view();
+    assert(text == cbor::string_view("borrowed text", 13));
+    assert((const uint8_t *)text.data() >= begin);
+
+    // copies keep referencing the input, re-encoding reproduces it;
+    DataItem copy = item["blob"];
+    assert(copy.is_borrowed() && copy.as_bytes_view().data() == bytes.data());
+    assert(cbor::encode(item) == buf);
+
+    // the default mode owns its strings;
+    assert(!cbor::decode(buf)["blob"].is_borrowed());
+
+    cbor::Document doc;
+    bool parsed = doc.parse(buf, options);
+    assert(parsed);
+    assert(doc["blob"].as_bytes_view().data() == bytes.data());
+    assert(doc["text"].as_string_view() == text);
+}
+
+void test_lazy() {
+    DataItem big = cbor::array();
+    for (int i = 0; i < 1000; i++) {
+        big.push_back(cbor::map({{"i", i}, {"s", std::string(20, 'x')}}));
+    }
+    DataItem m = cbor::map({
+        {"big", big},
+        {"id", 7},
+        {"name", "lazy"},
+        {"tagged", DataItem::tagged(1, 1363896240)},
+    });
+    std::vector<uint8_t> buf = cbor::encode(m);
+
+    cbor::LazyItem root(buf);
+    assert(root.is_map() && root.size() == 4);
+    assert(int(root["id"]) == 7);
+    assert(std::string(root["name"]) == "lazy");
+    assert(root["name"].as_string_view() == cbor::string_view("lazy", 4));
+    assert(root["tagged"].tag() == 1 && int(root["tagged"].child()) == 1363896240);
+    assert(root["missing"].is_undefined());
+    assert(root["big"].size() == 1000);
+    assert(int(root["big"].at(999)["i"]) == 999);
+    assert(root["big"].at(3).to_item() == big.at(3));
+    assert(root.to_item() == m);
+
+    size_t count = 0;
+    for (cbor::LazyItem::iterator it = root.begin(); it != root.end(); ++it) {
+        assert(m[it.key().to_item()] == it.value().to_item());
+        count++;
+    }
+    assert(count == 4);
+    const cbor::LazyItem &inner = root["big"].at(10);
+    assert(inner.encoded().size() == cbor::encode(big.at(10)).size());
+
+    // indefinite containers are walked up to their break;
+    const uint8_t indefinite[] = {0x9f, 0x01, 0xbf, 0x61, 'a', 0x02, 0xff,
+                                  0x5f, 0x41, 0x01, 0x41, 0x02, 0xff, 0xff};
+    cbor::LazyItem list(indefinite, sizeof(indefinite));
+    assert(list.size() == 3 && int(list.at(1)["a"]) == 2);
+    assert(list.at(2).operator std::vector<uint8_t>().size() == 2);
+    assert(list.at(2).as_bytes_view().empty());
+    count = 0;
+    for (auto &item : list) {
+        (void)item;
+        count++;
+    }
+    assert(count == 3);
+}
+
+// Renders events in a diagnostic-like notation and sums integers.
+class EventLog : public cbor::Handler {
+public:
+    std::string log;
+    int64_t sum = 0;
+    size_t limit = SIZE_MAX;
+
+    bool on_uint(uint64_t value) override {
+        sum += value;
+        return add("u" + std::to_string(value));
+    }
+    bool on_negative(uint64_t value) override {
+        sum += -1 - int64_t(value);
+        return add("n" + std::to_string(value));
+    }
+    bool on_string(const char *data, size_t size) override {
+        return add("\"" + std::string(data, size) + "\"");
+    }
+    bool on_bytes(const uint8_t *, size_t size) override {
+        return add("h" + std::to_string(size));
+    }
+    bool on_string_begin() override { return add("(_s"); }
+    bool on_array_begin(uint64_t size) override {
+        return add(size == indefinite ? "[_" : "[" + std::to_string(size));
+    }
+    bool on_map_begin(uint64_t size) override {
+        return add(size == indefinite ? "{_" : "{" + std::to_string(size));
+    }
+    bool on_tag(uint64_t tag) override { return add("t" + std::to_string(tag)); }
+    bool on_simple(uint8_t value) override {
+        return add("s" + std::to_string(value));
+    }
+    bool on_float(double value) override {
+        return add("f" + std::to_string(int(value * 10)));
+    }
+    bool on_break() override { return add("."); }
+
+private:
+    bool add(const std::string &event) {
+        if (limit-- == 0) {
+            return false;
+        }
+        log += log.empty() ? event : " " + event;
+        return true;
+    }
+};
+
+void test_sax() {
+    DataItem m = cbor::map({
+        {"a", cbor::array({1, -2, 2.5, true})},
+        {"b", DataItem::tagged(2, std::vector<uint8_t>{1, 2})},
+    });
+    std::vector<uint8_t> buf = cbor::encode(m);
+    EventLog events;
+    size_t used = cbor::parse(buf, events);
+    assert(used == buf.size());
+    assert(events.log == "{2 \"a\" [4 u1 n1 f25 s21 \"b\" t2 h2");
+    assert(events.sum == -1);
+
+    const uint8_t indefinite[] = {0x9f, 0x7f, 0x61, 'a', 0x61, 'b', 0xff,
+                                  0xbf, 0x01, 0x02, 0xff, 0xff};
+    EventLog chunks;
+    used = cbor::parse(indefinite, sizeof(indefinite), chunks);
+    assert(used == sizeof(indefinite));
+    assert(chunks.log == "[_ (_s \"a\" \"b\" . {_ u1 u2 . .");
+
+    // a handler can stop early, malformed input is reported;
+    EventLog stop;
+    stop.limit = 3;
+    used = cbor::parse(buf, stop);
+    assert(used == 0 && stop.log == "{2 \"a\" [4");
+    EventLog truncated;
+    used = cbor::parse(buf.data(), buf.size() - 1, truncated);
+    assert(used == 0);
+    const uint8_t odd_map[] = {0xbf, 0x01, 0xff};
+    used = cbor::parse(odd_map, sizeof(odd_map), truncated);
+    assert(used == 0);
+}
+
+void test_push_decoder() {
+    std::vector<DataItem> items = {
+        cbor::map({{"a", 1}, {"b", std::string(300, 'b')}}),
+        uint64_t(1) << 40,
+        cbor::array({DataItem::tagged(1, 2.5), std::vector<uint8_t>(70000, 7)}),
+        "last",
+    };
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < items.size(); i++) {
+        cbor::encode(items[i], stream);
+    }
+    const uint8_t indefinite[] = {0x9f, 0x7f, 0x61, 'a', 0x61, 'b', 0xff,
+                                  0xbf, 0x01, 0x02, 0xff, 0xff};
+    stream.insert(stream.end(), indefinite, indefinite + sizeof(indefinite));
+
+    // any chunking yields the same items, each as soon as it is complete;
+    size_t chunk_sizes[] = {1, 2, 3, 7, 100, 4096, stream.size()};
+    for (size_t chunk : chunk_sizes) {
+        cbor::PushDecoder decoder;
+        std::vector<DataItem> out;
+        for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+            size_t n = std::min(chunk, stream.size() - pos);
+            bool fed = decoder.feed(stream.data() + pos, n);
+            assert(fed);
+            DataItem item;
+            while (decoder.next(item)) {
+                out.push_back(item);
+            }
+        }
+        assert(!decoder.in_item() && decoder.buffered() == 0);
+        assert(out.size() == items.size() + 1);
+        for (size_t i = 0; i < items.size(); i++) {
+            assert(out[i] == items[i]);
+        }
+        assert(out.back().size() == 2);
+    }
+
+    cbor::PushDecoder decoder;
+    const uint8_t head[] = {0x19, 0x01};
+    bool fed = decoder.feed(head, sizeof(head));
+    assert(fed && decoder.in_item());
+    assert(decoder.ready() == 0);
+    const uint8_t rest[] = {0x02};
+    fed = decoder.feed(rest, sizeof(rest));
+    assert(fed && decoder.ready() == 1);
+    DataItem item;
+    bool got = decoder.next(item);
+    assert(got && int(item) == 0x0102);
+
+    const uint8_t stray_break[] = {0xff};
+    fed = decoder.feed(stray_break, 1);
+    assert(!fed && decoder.failed());
+    fed = decoder.feed(rest, sizeof(rest));
+    assert(!fed);
+    decoder.reset();
+    fed = decoder.feed(rest, sizeof(rest));
+    assert(fed && decoder.ready() == 1);
+}
+
+void test_validate() {
+    struct Case {
+        std::vector<uint8_t> input;
+        cbor::error reason;
+        size_t offset;
+    };
+    const Case cases[] = {
+        {{0x83, 0x01, 0x9f, 0x02, 0xff, 0x03}, cbor::error::None, 6},
+        {{}, cbor::error::Truncated, 0},
+        {{0x82, 0x01, 0x19, 0x01}, cbor::error::Truncated, 2},
+        {{0x81, 0x1c}, cbor::error::ReservedInfo, 1},
+        {{0x82, 0x01, 0xff}, cbor::error::UnexpectedBreak, 2},
+        {{0xbf, 0x01, 0xff}, cbor::error::UnexpectedBreak, 2},
+        {{0x5f, 0x41, 0x00, 0x61, 'a', 0xff}, cbor::error::ChunkType, 3},
+        {{0x7f, 0x7f, 0xff, 0xff}, cbor::error::ChunkType, 1},
+        {{0x1f}, cbor::error::InvalidIndefinite, 0},
+        {{0xf8, 0x10}, cbor::error::InvalidSimple, 0},
+        {{0x81, 0x9a, 0xff, 0xff, 0xff, 0xff}, cbor::error::CountTooLarge, 1},
+        {{0x01, 0x02}, cbor::error::TrailingBytes, 1},
+    };
+    for (const Case &c : cases) {
+        cbor::validate_result result =
+            cbor::validate(c.input.data(), c.input.size());
+        assert(result.reason == c.reason && result.offset == c.offset);
+        assert(bool(result) == (c.reason == cbor::error::None));
+        assert(DataItem::validate(c.input) == bool(result));
+        assert(strlen(cbor::error_message(result.reason)) != 0);
+    }
+
+    std::vector<uint8_t> deep(1025, 0x9f);
+    cbor::validate_result result = cbor::validate(deep.data(), deep.size());
+    assert(result.reason == cbor::error::TooDeep && result.offset == 1024);
+
+    // the decoder takes exactly what the validator accepts;
+    std::vector<std::vector<uint8_t>> inputs;
+    for (const Case &c : cases) {
+        inputs.push_back(c.input);
+    }
+    inputs.push_back({0xf8, 0x20});
+    inputs.push_back({0xf8, 0x1f});
+    for (size_t depth : {1024, 1025, 1100}) {
+        std::vector<uint8_t> nested(depth, 0x9f);
+        nested.insert(nested.end(), depth, 0xff);
+        inputs.push_back(nested);
+        // a chunked string is one more level;
+        nested = std::vector<uint8_t>(depth - 1, 0x9f);
+        nested.push_back(0x7f);
+        nested.insert(nested.end(), depth, 0xff);
+        inputs.push_back(nested);
+    }
+    for (const std::vector<uint8_t> &input : inputs) {
+        bool valid = bool(cbor::validate(input.data(), input.size()));
+        DataItem item;
+        size_t used = item.read(input.data(), input.size());
+        assert(valid == (used != 0 && used == input.size()));
+    }
+}
+
+void test_utf8() {
+    const char *valid[] = {"", "plain ascii", "\xc2\xa9", "\xe2\x82\xac",
+                           "\xef\xbf\xbf", "\xf0\x90\x80\x80",
+                           "\xf4\x8f\xbf\xbf", "\xed\x9f\xbf"};
+    const char *invalid[] = {"\x80", "\xc0\xaf", "\xc2", "\xe0\x9f\xbf",
+                             "\xed\xa0\x80", "\xf0\x8f\xbf\xbf",
+                             "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+                             "\xe2\x82", "\xff"};
+    // at every offset around the 16 and 32 byte blocks of the kernels;
+    for (size_t pad = 0; pad < 70; pad++) {
+        for (const char *s : valid) {
+            std::string text = std::string(pad, 'a') + s + "tail";
+            assert(cbor::is_utf8(text.data(), text.size()));
+            text = std::string(pad, 'a') + s;
+            assert(cbor::is_utf8(text.data(), text.size()));
+        }
+        for (const char *s : invalid) {
+            std::string text = std::string(pad, 'a') + s + "tail";
+            assert(!cbor::is_utf8(text.data(), text.size()));
+            text = std::string(pad, 'a') + s;
+            assert(!cbor::is_utf8(text.data(), text.size()));
+        }
+    }
+    // the vector kernels agree with the scalar one;
+    uint32_t seed = 1;
+    const uint8_t alphabet[] = {'a', 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc1,
+                                0xc2, 0xdf, 0xe0, 0xed, 0xef, 0xf0, 0xf4, 0xf5};
+    for (int round = 0; round < 20000; round++) {
+        std::string text;
+        size_t size = round % 80;
+        for (size_t i = 0; i < size; i++) {
+            seed = seed * 1103515245 + 12345;
+            // mostly valid sequences, so that errors are not all up front;
+            text += seed >> 28 < 12 ? "\xe2\x82\xac"
+                                    : std::string(1, char(alphabet[seed >> 16 & 15]));
+        }
+        assert(cbor::is_utf8(text.data(), text.size()) ==
+               cbor::detail::is_utf8_scalar(
+                   reinterpret_cast<const uint8_t *>(text.data()), text.size()));
+    }
+
+    // strict decoding rejects bad text, also in chunks and nested items;
+    cbor::decode_options strict;
+    strict.strict_utf8 = true;
+    const uint8_t good[] = {0x82, 0x62, 0xc2, 0xa9, 0x7f, 0x61, 'a', 0xff};
+    const uint8_t bad[] = {0x82, 0x61, 'a', 0x7f, 0x61, 0xc2, 0x61, 0xa9, 0xff};
+    const uint8_t bytes[] = {0x41, 0xff};
+    DataItem item;
+    size_t used = item.read(good, sizeof(good), strict);
+    assert(used == sizeof(good));
+    used = item.read(bad, sizeof(bad), strict);
+    assert(used == 0);
+    used = item.read(bad, sizeof(bad));
+    assert(used == sizeof(bad));
+    used = item.read(bytes, sizeof(bytes), strict);
+    assert(used == sizeof(bytes));
+    cbor::Document doc;
+    bool parsed = doc.parse(good, sizeof(good), strict);
+    assert(parsed);
+    parsed = doc.parse(bad, sizeof(bad), strict);
+    assert(!parsed);
+    parsed = doc.parse(bad, sizeof(bad));
+    assert(parsed);
+    assert(cbor::validate(bad, sizeof(bad)));
+    cbor::validate_result result = cbor::validate(bad, sizeof(bad), strict);
+    assert(result.reason == cbor::error::InvalidUtf8 && result.offset == 4);
+}
+
+void test_tape() {
+    DataItem numbers = cbor::array();
+    for (int i = 0; i < 1000; i++) {
+        numbers.emplace_back(i % 3 == 0 ? DataItem(cbor::array({i, "x"}))
+                                        : DataItem(i));
+    }
+    DataItem message = cbor::map({
+        {"numbers", numbers},
+        {"name", "tape"},
+        {"when", DataItem::tagged(1, 2.5)},
+    });
+    std::vector<uint8_t> buf = cbor::encode(message);
+    // an indefinite-length array with a chunked string after it;
+    const uint8_t tail[] = {0x9f, 0x01, 0xbf, 0x61, 'k', 0x7f, 0x61, 'a',
+                            0x61, 'b', 0xff, 0xff, 0x80, 0xff};
+    DataItem outer = cbor::array({message});
+    std::vector<uint8_t> nested = cbor::encode(outer);
+    nested[0] = 0x82;
+    nested.insert(nested.end(), tail, tail + sizeof(tail));
+
+    cbor::Tape tape;
+    size_t used = tape.index(nested);
+    assert(used == nested.size());
+    // every entry knows its extent without scanning;
+    for (size_t i = 0; i < tape.entries().size(); i++) {
+        const uint8_t *start = tape.data() + tape.entries()[i].offset;
+        const uint8_t *end = cbor::detail::skip_item(start, nested.data() + nested.size());
+        cbor::bytes_view encoded = cbor::TapeItem(&tape, i).encoded();
+        assert(encoded.data() == start && encoded.size() == size_t(end - start));
+    }
+
+    cbor::TapeItem root = tape.root();
+    assert(root.is_array() && root.size() == 2);
+    cbor::TapeItem doc = root.at(0);
+    assert(doc.to_item() == message);
+    assert(doc["numbers"].size() == 1000);
+    assert(int(doc["numbers"].at(998)) == 998);
+    assert(std::string(doc["numbers"].at(999).at(1)) == "x");
+    assert(std::string(doc["name"]) == "tape");
+    assert(doc["name"].as_string_view() == cbor::string_view("tape", 4));
+    assert(doc["when"].tag() == 1 && double(doc["when"].child()) == 2.5);
+    assert(doc["missing"].is_undefined());
+
+    cbor::TapeItem last = root.at(1);
+    assert(last.is_array() && last.size() == 3);
+    assert(last.at(1).is_map() && last.at(1).size() == 1);
+    assert(std::string(last.at(1)["k"]) == "ab");
+    assert(last.at(1)["k"].as_string_view().empty());
+    assert(last.at(2).is_array() && last.at(2).empty());
+    size_t count = 0;
+    for (cbor::TapeItem::iterator it = last.at(1).begin(); it != last.at(1).end(); ++it) {
+        assert(std::string(it.key()) == "k");
+        count++;
+    }
+    assert(count == 1);
+
+    const uint8_t truncated[] = {0x82, 0x01};
+    used = tape.index(truncated, sizeof(truncated));
+    assert(used == 0);
+    assert(tape.entries().empty() && tape.root().is_undefined());
+}
+
+void test_query() {
+    DataItem sensors = cbor::array();
+    for (int i = 0; i < 5; i++) {
+        sensors.emplace_back(cbor::map({{"id", i}, {"temp", 20.5 + i}}));
+    }
+    DataItem message = cbor::map({
+        {"sensors", sensors},
+        {"site", "north"},
+        {1, "one"},
+        {-2, "minus two"},
+    });
+    std::vector<uint8_t> buf = cbor::encode(message);
+
+    cbor::bytes_view temp = cbor::query(buf, {"sensors", 3, "temp"});
+    assert(double(cbor::decode(temp.data(), temp.size())) == 23.5);
+    assert(temp.data() >= buf.data() && temp.data() < buf.data() + buf.size());
+    cbor::bytes_view site = cbor::query(buf, {"site"});
+    assert(std::string(cbor::decode(site.data(), site.size())) == "north");
+    cbor::bytes_view one = cbor::query(buf, {1});
+    assert(std::string(cbor::decode(one.data(), one.size())) == "one");
+    cbor::bytes_view minus = cbor::query(buf, {-2});
+    assert(std::string(cbor::decode(minus.data(), minus.size())) == "minus two");
+    cbor::bytes_view whole = cbor::query(buf, {});
+    assert(whole.size() == buf.size());
+    cbor::path path = {"sensors", 4, "id"};
+    cbor::bytes_view id = cbor::query(buf.data(), buf.size(), path);
+    assert(int(cbor::decode(id.data(), id.size())) == 4);
+
+    assert(cbor::query(buf, {"sensors", 5}).empty());
+    assert(cbor::query(buf, {"sensors", "id"}).empty());
+    assert(cbor::query(buf, {"site", 0}).empty());
+    assert(cbor::query(buf, {"nothing"}).empty());
+
+    // chunked keys and indefinite-length containers;
+    const uint8_t indefinite[] = {0xbf, 0x7f, 0x61, 'a', 0x61, 'b', 0xff,
+                                  0x9f, 0x01, 0x02, 0xff, 0xff};
+    cbor::bytes_view second = cbor::query(indefinite, sizeof(indefinite), {"ab", 1});
+    assert(second.size() == 1 && second[0] == 0x02);
+    assert(cbor::query(indefinite, 9, {"ab", 1}).empty());
+    assert(cbor::project(indefinite, 9, {{"ab"}}).is_undefined());
+
+    DataItem projected = cbor::project(
+        buf, {{"sensors", 1, "temp"}, {"sensors", 3}, {"site"}, {"missing"}});
+    DataItem expected = cbor::map({
+        {"sensors", cbor::array({cbor::map({{"temp", 21.5}}), sensors.at(3)})},
+        {"site", "north"},
+    });
+    assert(projected == expected);
+    assert(cbor::project(buf, {{}}) == message);
+    assert(cbor::project(buf, {}) == cbor::map());
+}
+
+void test_decode_sequence() {
+    std::vector<DataItem> items;
+    std::vector<uint8_t> sequence;
+    for (int i = 0; i < 5000; i++) {
+        items.push_back(i % 7 == 0 ? cbor::map({{"n", i}, {"s", std::string(i % 50, 's')}})
+                                   : DataItem(i));
+        cbor::encode(items.back(), sequence);
+    }
+
+    unsigned thread_counts[] = {1, 4, 0};
+    for (unsigned threads : thread_counts) {
+        cbor::parallel_options options;
+        options.threads = threads;
+        std::vector<DataItem> out;
+        bool decoded = cbor::decode_sequence(sequence.data(), sequence.size(),
+                                             out, options);
+        assert(decoded && out == items);
+
+        std::vector<int> seen(items.size(), 0);
+        std::atomic<size_t> count(0);
+        decoded = cbor::decode_sequence_unordered(
+            sequence.data(), sequence.size(),
+            [&](size_t index, DataItem &item) {
+                assert(item == items[index]);
+                seen[index]++;
+                count++;
+            },
+            options);
+        assert(decoded && count == items.size());
+        assert(std::count(seen.begin(), seen.end(), 1) == int(seen.size()));
+    }
+
+    // below the threshold everything stays on the calling thread;
+    std::vector<DataItem> out;
+    bool decoded = cbor::decode_sequence(sequence.data(), 9, out);
+    assert(decoded && out.size() == 3);
+    decoded = cbor::decode_sequence(sequence.data(), 0, out);
+    assert(decoded && out.empty());
+    decoded = cbor::decode_sequence(sequence.data(), sequence.size() - 1, out);
+    assert(!decoded && out.empty());
+    // well framed but not decodable under strict UTF-8;
+    const uint8_t bad_text[] = {0x01, 0x61, 0xff, 0x02};
+    cbor::parallel_options strict;
+    strict.decode.strict_utf8 = true;
+    decoded = cbor::decode_sequence(bad_text, sizeof(bad_text), out);
+    assert(decoded);
+    decoded = cbor::decode_sequence(bad_text, sizeof(bad_text), out, strict);
+    assert(!decoded);
+}
+
+void test_encode_parallel() {
+    DataItem big = cbor::array();
+    DataItem table = cbor::map();
+    for (int i = 0; i < 20000; i++) {
+        big.emplace_back(i % 5 == 0 ? DataItem(std::string(i % 40, 'x'))
+                                    : DataItem(i * 1000));
+        table[DataItem(i)] = cbor::array({i, -i});
+    }
+    DataItem envelope = cbor::map({{"rows", big}, {"table", table}, {"v", 1}});
+    DataItem items[] = {big, table, envelope, cbor::array({envelope}),
+                        cbor::array({1, 2, 3})};
+
+    cbor::parallel_options options;
+    options.threads = 4;
+    for (const DataItem &item : items) {
+        std::vector<uint8_t> expected = cbor::encode(item);
+        std::vector<uint8_t> out(3, 0xaa);
+        cbor::encode_parallel(item, out, options);
+        assert(out.size() == expected.size() + 3);
+        assert(std::equal(expected.begin(), expected.end(), out.begin() + 3));
+
+        std::vector<std::vector<uint8_t>> buffers;
+        cbor::encode_parallel(item, buffers, options);
+        std::vector<uint8_t> joined;
+        for (const std::vector<uint8_t> &buffer : buffers) {
+            joined.insert(joined.end(), buffer.begin(), buffer.end());
+        }
+        assert(joined == expected);
+    }
+
+    // small items stay whole;
+    std::vector<std::vector<uint8_t>> buffers;
+    cbor::encode_parallel(cbor::array({1, 2, 3}), buffers, options);
+    assert(buffers.size() == 1);
+    options.threads = 1;
+    cbor::encode_parallel(big, buffers, options);
+    assert(buffers.size() == 2 && buffers[1] == cbor::encode(big));
+}
+
+void test_mapped_file() {
+    DataItem message = cbor::map({{"name", std::string(100, 'n')}, {"id", 7}});
+    std::vector<uint8_t> encoded = cbor::encode(message);
+    const char *path = "cbor_test_mapped.cbor";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+    }
+
+    cbor::MappedFile file(path);
+    assert(file.is_open() && file.size() == encoded.size());
+    assert(std::equal(encoded.begin(), encoded.end(), file.data()));
+    bool advised = file.advise(cbor::MappedFile::advice::Sequential);
+    assert(advised);
+    advised = file.advise(cbor::MappedFile::advice::Random, 3, 10);
+    assert(advised);
+    advised = file.advise(cbor::MappedFile::advice::WillNeed);
+    assert(advised);
+
+    cbor::decode_options borrow;
+    borrow.borrow = true;
+    DataItem item;
+    size_t used = item.read(file.data(), file.size(), borrow);
+    assert(used == file.size());
+    assert(item == message && item["name"].is_borrowed());
+    const char *name = item["name"].as_string_view().data();
+    assert(name > reinterpret_cast<const char *>(file.data()) &&
+           name < reinterpret_cast<const char *>(file.data() + file.size()));
+
+    cbor::MappedFile moved(std::move(file));
+    assert(!file.is_open() && file.data() == nullptr);
+    assert(moved.is_open() && moved.bytes() == cbor::bytes_view(encoded.data(), encoded.size()));
+    moved.close();
+    assert(!moved.is_open() && moved.size() == 0);
+
+    {
+        std::ofstream empty(path, std::ios::binary | std::ios::trunc);
+    }
+    bool opened = moved.open(path);
+    assert(opened && moved.size() == 0);
+    std::remove(path);
+    opened = moved.open(path);
+    assert(!opened && !moved.is_open());
+}
+
+void test_sequence() {
+    std::vector<DataItem> items = {1, "two", cbor::array({3, 4}),
+                                   std::vector<uint8_t>(200000, 5),
+                                   cbor::map({{"six", 6}})};
+    std::vector<uint8_t> encoded;
+    {
+        cbor::SequenceWriter writer(encoded);
+        bool written = writer.write_batch(items);
+        assert(written);
+        std::vector<uint8_t> seven = cbor::encode(DataItem(7));
+        written = writer.write(cbor::bytes_view(seven.data(), seven.size()));
+        assert(written && writer.count() == 6);
+    }
+    items.push_back(7);
+
+    cbor::SequenceReader reader(encoded);
+    size_t i = 0;
+    for (const DataItem &item : reader) {
+        assert(item == items[i++]);
+    }
+    assert(i == items.size() && !reader.failed());
+
+    cbor::SequenceReader skipping(encoded);
+    std::vector<DataItem> batch;
+    bool skipped = skipping.skip() && skipping.skip();
+    assert(skipped);
+    size_t got = skipping.next_batch(batch, 2);
+    assert(got == 2 && batch[1] == items[3]);
+    got = skipping.next_batch(batch, 5);
+    assert(got == 2 && batch[0] == items[4]);
+    got = skipping.next_batch(batch, 1);
+    assert(skipping.count() == 6 && got == 0);
+
+    // a descriptor, written through a small buffer and read in blocks
+    // smaller than the large item;
+    const char *path = "cbor_test_sequence.cbor";
+    FILE *out = std::fopen(path, "wb");
+    {
+        cbor::SequenceWriter writer(fileno(out), 16);
+        for (const DataItem &item : items) {
+            bool written = writer.write(item);
+            assert(written);
+        }
+        bool flushed = writer.flush();
+        assert(flushed && !writer.failed());
+    }
+    std::fclose(out);
+    FILE *in = std::fopen(path, "rb");
+    cbor::SequenceReader file(fileno(in));
+    std::vector<DataItem> all;
+    size_t loaded = file.next_batch(all, 100);
+    assert(loaded == items.size() && all == items && !file.failed());
+    std::fclose(in);
+
+    // a truncated last item is an error, unlike the end of the input;
+    out = std::fopen(path, "wb");
+    std::fwrite(encoded.data(), 1, encoded.size() - 2, out);
+    std::fclose(out);
+    in = std::fopen(path, "rb");
+    cbor::SequenceReader truncated(fileno(in));
+    while (truncated.skip()) {
+    }
+    assert(truncated.failed() && truncated.count() == 4);
+    std::fclose(in);
+
+    // items past the limit fail instead of being buffered;
+    in = std::fopen(path, "rb");
+    cbor::SequenceReader limited(fileno(in), cbor::decode_options(), 100000);
+    while (limited.skip()) {
+    }
+    assert(limited.failed() && limited.count() == 3);
+    std::fclose(in);
+
+    // a large last item completes at the end of the input, between rescans;
+    out = std::fopen(path, "wb");
+    std::vector<uint8_t> last = cbor::encode(DataItem(std::vector<uint8_t>(150000, 8)));
+    std::fwrite(last.data(), 1, last.size(), out);
+    std::fclose(out);
+    in = std::fopen(path, "rb");
+    cbor::SequenceReader whole(fileno(in));
+    cbor::bytes_view framed;
+    bool next = whole.next(framed);
+    assert(next && framed.size() == last.size());
+    next = whole.next(framed);
+    assert(!next && !whole.failed());
+    std::fclose(in);
+    std::remove(path);
+
+    std::vector<uint8_t> malformed = {0x01, 0x1c, 0x02};
+    cbor::SequenceReader bad(malformed);
+    DataItem item;
+    next = bad.next(item);
+    assert(next && item == DataItem(1));
+    next = bad.next(item);
+    assert(!next && bad.failed());
+}
+
+void test_hash() {
+    DataItem a = cbor::map({{"x", cbor::array({1, "two", 3.5})}, {"y", nullptr}});
+    DataItem b = cbor::decode(cbor::encode(a));
+    assert(a.hash() == b.hash() && std::hash<DataItem>()(a) == a.hash());
+    assert(DataItem(1).hash() != DataItem(-2).hash());
+    assert(DataItem("1").hash() != DataItem(std::vector<uint8_t>{'1'}).hash());
+    assert(DataItem(std::string(40, 'a')).hash() !=
+           DataItem(std::string(40, 'a') + "b").hash());
+
+    // the hash follows modifications;
+    size_t before = a.hash();
+    a["y"] = 1;
+    assert(a.hash() != before && a != b);
+    a["y"] = DataItem(nullptr);
+    assert(a.hash() == before && a == b);
+    DataItem list = cbor::array({1});
+    before = list.hash();
+    list.push_back(2);
+    assert(list.hash() != before);
+
+    // a container key changed through a reference after hashing is found
+    // by its new content, in small maps and indexed ones alike;
+    for (int size : {3, 20}) {
+        DataItem keys = cbor::map();
+        for (int i = 0; i < size; ++i) {
+            keys[i] = i;
+        }
+        DataItem key = cbor::map({{"a", 1}});
+        DataItem &element = key["a"];
+        key.hash();
+        element = 5;
+        keys[key] = "first";
+        keys[cbor::map({{"a", 5}})] = "second";
+        const DataItem &lookup = keys;
+        assert(int(keys.size()) == size + 1);
+        assert(*lookup.find(cbor::map({{"a", 5}})) == DataItem("second"));
+        assert(lookup.find(cbor::map({{"a", 1}})) == nullptr);
+        assert(cbor::decode(cbor::encode(keys)) == keys);
+    }
+
+    std::unordered_set<DataItem> seen;
+    seen.insert(DataItem("key"));
+    seen.insert(cbor::array({1, 2}));
+    assert(seen.count(DataItem("key")) == 1 && seen.count(cbor::array({1, 2})) == 1);
+    assert(seen.count(cbor::array({2, 1})) == 0);
+
+    // large maps look keys up through the index;
+    DataItem big;
+    for (int i = 0; i < 300; ++i) {
+        big["key" + std::to_string(i)] = i;
+    }
+    const DataItem &view = big;
+    assert(big.size() == 300);
+    for (int i = 0; i < 300; ++i) {
+        const DataItem *value = view.find("key" + std::to_string(i));
+        assert(value != nullptr && int(*value) == i);
+    }
+    assert(view.find("key300") == nullptr && view.find(7) == nullptr);
+    big["key7"] = "seven";
+    big["new"] = true;
+    assert(big.size() == 301 && *view.find("key7") == DataItem("seven"));
+    assert(view.find("new") != nullptr);
+    DataItem copy = big;
+    copy["other"] = 1;
+    assert(copy.find("other") != nullptr && view.find("other") == nullptr);
+    assert(cbor::decode(cbor::encode(big)) == big);
+    big.clear();
+    assert(view.find("key7") == nullptr);
+    big["key7"] = 7;
+    assert(*view.find("key7") == DataItem(7));
+    assert(DataItem(1).find(1) == nullptr);
+}
+
+void test_map_order() {
+    // entries keep the order they were inserted or decoded in;
+    DataItem m = cbor::map({{"z", 1}, {"a", 2}, {3, "m"}});
+    m["b"] = 4;
+    m["z"] = 5;
+    const char *keys[] = {"z", "a", "3", "b"};
+    size_t i = 0;
+    for (cbor::iterator it = m.begin(); it != m.end(); ++it, ++i) {
+        assert(it.key().dump() == (i == 2 ? std::string("3")
+                                          : "\"" + std::string(keys[i]) + "\""));
+    }
+    assert(int(m["z"]) == 5 && m.size() == 4);
+    const uint8_t wire[] = {0xa3, 0x61, 'y', 0x01, 0x61, 'x', 0x02, 0x00, 0x03};
+    std::vector<uint8_t> in(wire, wire + sizeof(wire));
+    assert(cbor::encode(cbor::decode(in)) == in);
+
+    // order does not matter to comparisons and hashes;
+    DataItem reordered = cbor::map({{"b", 4}, {3, "m"}, {"a", 2}, {"z", 5}});
+    assert(m == reordered && !(m < reordered) && !(reordered < m));
+    assert(m.hash() == reordered.hash());
+    assert(cbor::map({{"a", 1}}) < cbor::map({{"a", 2}}));
+    assert(DataItem(m.operator std::map<DataItem, DataItem>()) == m);
+
+    // of repeated keys the first one wins, when decoding too;
+    cbor::Map entries = {{"k", 1}, {"j", 2}, {"k", 3}};
+    DataItem from_entries(entries);
+    assert(from_entries.size() == 2 && int(from_entries["k"]) == 1);
+    const uint8_t repeated[] = {0xa2, 0x61, 'k', 0x01, 0x61, 'k', 0x02};
+    DataItem decoded = cbor::decode(std::vector<uint8_t>(
+        repeated, repeated + sizeof(repeated)));
+    assert(decoded.size() == 1 && int(decoded["k"]) == 1);
+
+    // large maps, past the size where lookups use the index;
+    std::vector<uint8_t> large;
+    cbor::Writer writer(large);
+    writer.begin_map(41);
+    for (int k = 40; k > 0; --k) {
+        writer.key(k).value(-k);
+    }
+    writer.key(7).value(0);
+    DataItem big = cbor::decode(large);
+    assert(big.size() == 40 && int(big[7]) == -7 && int(big[40]) == -40);
+    assert(big.begin().key() == DataItem(40));
+    std::vector<uint8_t> expected(large.begin(), large.end() - 2);
+    expected[1] = 40;
+    assert(cbor::encode(big) == expected);
+}
+
+void test_stringref() {
+    // the example of the stringref specification;
+    const char *names[] = {"1", "222", "333", "4", "555", "666", "777", "888",
+                           "999", "aaa", "bbb", "ccc", "ddd", "eee", "fff",
+                           "ggg", "hhh", "iii", "jjj", "kkk", "lll", "mmm",
+                           "nnn", "ooo", "ppp", "qqq", "rrr", "333", "ssss",
+                           "qqq", "rrr", "ssss"};
+    DataItem list = cbor::array();
+    for (const char *name : names) {
+        list.push_back(name);
+    }
+    std::vector<uint8_t> packed = cbor::encode_stringref(list);
+    const uint8_t head[] = {0xd9, 0x01, 0x00, 0x98, 0x20, 0x61, '1'};
+    assert(std::equal(head, head + sizeof(head), packed.begin()));
+    // "rrr" came too late for an index, past 24 strings it takes four bytes;
+    const uint8_t tail[] = {0xd8, 0x19, 0x01, 0x64, 's', 's', 's', 's',
+                            0xd8, 0x19, 0x17, 0x63, 'r', 'r', 'r',
+                            0xd8, 0x19, 0x18, 0x18};
+    assert(std::equal(tail, tail + sizeof(tail), packed.end() - sizeof(tail)));
+
+    cbor::decode_options options;
+    options.stringref = true;
+    assert(cbor::decode(packed.data(), packed.size(), options) == list);
+    DataItem plain = cbor::decode(packed);
+    assert(plain.is_tagged() && plain.tag() == 256);
+
+    // repeated keys and values are written once, references share them;
+    DataItem records = cbor::array();
+    for (int i = 0; i < 100; ++i) {
+        records.push_back(cbor::map({{"temperature", i},
+                                     {"status", "nominal"},
+                                     {"abc", std::vector<uint8_t>{'a', 'b', 'c'}}}));
+    }
+    packed = cbor::encode_stringref(records);
+    assert(packed.size() * 2 < cbor::encode(records).size());
+    options.borrow = true;
+    DataItem decoded = cbor::decode(packed.data(), packed.size(), options);
+    assert(decoded == records);
+    assert(decoded.at(99)["status"].is_borrowed());
+    assert(decoded.at(99)["status"].as_string_view().data() ==
+           decoded.at(0)["status"].as_string_view().data());
+    // text and byte strings of the same bytes are told apart;
+    assert(decoded.at(50)["abc"].is_binary() && decoded.at(50).begin().key().is_string());
+
+    // a nested namespace starts with its own table;
+    DataItem nested = cbor::array({"outer", DataItem::tagged(256, cbor::array({
+        "inner", "inner", "outer"})), "outer"});
+    packed = cbor::encode_stringref(nested);
+    DataItem expected = cbor::array({"outer", cbor::array({"inner", "inner", "outer"}), "outer"});
+    assert(cbor::decode(packed.data(), packed.size(), options) == expected);
+
+    // references to strings that have no index are malformed;
+    const uint8_t dangling[] = {0xd9, 0x01, 0x00, 0x82, 0x63, 'a', 'b', 'c',
+                                0xd8, 0x19, 0x01};
+    std::vector<uint8_t> bad(dangling, dangling + sizeof(dangling));
+    assert(cbor::decode(bad.data(), bad.size(), options).is_undefined());
+    bad.back() = 0x00;
+    assert(cbor::decode(bad.data(), bad.size(), options) ==
+           cbor::array({"abc", "abc"}));
+}
+
+void test_typed_array() {
+    std::vector<float> samples;
+    for (int i = 0; i < 37; ++i) {
+        samples.push_back(i * 0.5f - 3);
+    }
+    DataItem item = DataItem::typed_array(samples);
+    assert(item.is_typed_array() && item.tag() == 85); // float32, little endian;
+    std::vector<uint8_t> encoded = cbor::encode(item);
+    assert(encoded.size() == 2 + 2 + samples.size() * 4);
+    DataItem decoded = cbor::decode(encoded);
+    cbor::typed_view<float> floats = decoded.as_typed<float>();
+    assert(floats.in_place() && floats.size() == samples.size());
+    assert(std::equal(samples.begin(), samples.end(), floats.begin()));
+    cbor::typed_view<double> doubles = decoded.as_typed<double>();
+    assert(!doubles.in_place() && doubles[3] == -1.5);
+    cbor::typed_view<int32_t> ints = decoded.as_typed<int32_t>();
+    assert(ints[36] == 15);
+
+    // the other byte order is swapped, past the vector width and in the tail;
+    std::vector<uint8_t> big_endian;
+    for (float f : samples) {
+        uint32_t bits;
+        memcpy(&bits, &f, 4);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            big_endian.push_back(uint8_t(bits >> shift));
+        }
+    }
+    DataItem swapped = DataItem::tagged(81, big_endian);
+    floats = swapped.as_typed<float>();
+    assert(!floats.in_place() && std::equal(samples.begin(), samples.end(), floats.begin()));
+    cbor::typed_view<float> copy = floats;
+    assert(copy.data() != floats.data() && copy[36] == samples[36]);
+
+    const uint8_t words[] = {0x01, 0x02, 0xff, 0xfe, 0x00, 0x03};
+    DataItem u16 = DataItem::tagged(65, std::vector<uint8_t>(words, words + 6));
+    assert(u16.as_typed<uint16_t>()[0] == 0x0102 && u16.as_typed<uint16_t>()[1] == 0xfffe);
+    assert(u16.as_typed<int16_t>()[1] == -2 && u16.as_typed<uint64_t>()[2] == 3);
+    DataItem s8 = DataItem::tagged(72, std::vector<uint8_t>{0xff, 0x80, 0x05});
+    assert(s8.as_typed<int64_t>()[0] == -1 && s8.as_typed<int64_t>()[1] == -128);
+    DataItem half = DataItem::tagged(80, std::vector<uint8_t>{0x3c, 0x00, 0xc0, 0x00});
+    assert(half.as_typed<float>()[0] == 1.0f && half.as_typed<float>()[1] == -2.0f);
+
+    // byte strings borrowed at an odd offset are copied to align them;
+    std::vector<uint8_t> padded = cbor::encode(cbor::array({1, item}));
+    cbor::decode_options borrow;
+    borrow.borrow = true;
+    DataItem outer = cbor::decode(padded.data(), padded.size(), borrow);
+    floats = outer.at(1).as_typed<float>();
+    assert(floats.size() == samples.size() && floats[10] == samples[10]);
+
+    // plain arrays of numbers convert the same way;
+    cbor::typed_view<double> numbers = cbor::array({1, -2, 2.5}).as_typed<double>();
+    assert(numbers.size() == 3 && numbers[1] == -2 && numbers[2] == 2.5);
+    assert(double(DataItem(-2)) == -2.0);
+    assert(double(DataItem::negative(~uint64_t(0))) == -18446744073709551616.0);
+    assert(DataItem("text").as_typed<float>().empty());
+    assert(!DataItem::tagged(76, std::vector<uint8_t>{1}).is_typed_array());
+    assert(!DataItem::tagged(83, std::vector<uint8_t>(16)).is_typed_array());
+    assert(!DataItem::tagged(66, std::vector<uint8_t>(3)).is_typed_array());
+    std::vector<int64_t> none;
+    assert(DataItem::typed_array(none).is_typed_array() &&
+           DataItem::typed_array(none).as_typed<int64_t>().empty());
+}
+
+void test_writer() {
+    // same bytes as the equivalent tree;
+    DataItem tree = cbor::map({
+        {"id", -7},
+        {"name", "writer"},
+        {"scores", cbor::array({1, 2.5, uint64_t(1) << 40})},
+        {"blob", std::vector<uint8_t>(300, 1)},
+        {"when", DataItem::tagged(1, 1500000000)},
+        {"none", nullptr},
+        {"ok", true},
+    });
+    std::vector<uint8_t> out;
+    cbor::Writer writer(out);
+    writer.begin_map(7).key("id").value(-7).key("name").value("writer");
+    writer.key("scores").begin_array(3).value(1).value(2.5).value(
+        uint64_t(1) << 40);
+    writer.key("blob").value(std::vector<uint8_t>(300, 1));
+    writer.key("when").tag(1).value(1500000000);
+    writer.key("none").value(nullptr).key("ok").value(true);
+    assert(writer.complete() && writer.depth() == 0);
+    assert(cbor::decode(out) == tree && out == cbor::encode(tree));
+    std::vector<uint8_t> scores;
+    cbor::Writer(scores).begin_array(3).value(1).value(2.5).value(
+        uint64_t(1) << 40);
+    assert(scores == cbor::encode(tree["scores"]));
+
+    // indefinite-length items and chunked strings;
+    cbor::Writer chunks;
+    chunks.begin_array().begin_string().value("ab").value("cd").end();
+    assert(chunks.depth() == 1);
+    chunks.begin_bytes().end().begin_map().key(1).value(DataItem("x")).end();
+    chunks.begin_array(0).end();
+    assert(chunks.complete());
+    const uint8_t expected[] = {0x9f, 0x7f, 0x62, 'a', 'b', 0x62, 'c', 'd',
+                                0xff, 0x5f, 0xff, 0xbf, 0x01, 0x61, 'x',
+                                0xff, 0x80, 0xff};
+    assert(chunks.buffer() ==
+           std::vector<uint8_t>(expected, expected + sizeof(expected)));
+    DataItem decoded = cbor::decode(chunks.buffer());
+    assert(decoded.size() == 4 && std::string(decoded.at(0)) == "abcd");
+    chunks.clear();
+    assert(chunks.buffer().empty() && chunks.complete());
+}
+
+namespace serial {
+
+enum class color : uint8_t { Red, Green, Blue };
+
+struct point {
+    int x;
+    int y;
+    std::string label;
+};
+CBOR_FIELDS(point, x, y, label)
+
+struct shape {
+    std::string name;
+    color fill;
+    std::vector<point> points;
+    std::map<std::string, double> weights;
+    std::unordered_map<int, std::vector<uint8_t>> blobs;
+    std::array<int16_t, 3> offsets;
+    std::pair<bool, std::string> flag;
+    std::tuple<uint64_t, int64_t, float> extent;
+    std::vector<bool> mask;
+    DataItem extra;
+};
+CBOR_FIELDS(shape, name, fill, points, weights, blobs, offsets, flag, extent,
+            mask, extra)
+
+} // namespace serial
+
+void test_serialize() {
+    serial::shape s;
+    s.name = "triangle";
+    s.fill = serial::color::Blue;
+    s.points = {{0, 0, "a"}, {-5, 1 << 20, "b"}, {3, -1, ""}};
+    s.weights = {{"w", 0.5}, {"h", 1e300}};
+    s.blobs[7] = std::vector<uint8_t>(40, 0xab);
+    s.offsets = {{-1, 300, -32768}};
+    s.flag = std::make_pair(true, "on");
+    s.extent = std::make_tuple(~uint64_t(0), INT64_MIN, 1.5f);
+    s.mask = {true, false, true};
+    s.extra = cbor::map({{"k", cbor::array({1, "v"})}});
+    std::vector<uint8_t> out = cbor::serialize(s);
+
+    // the same bytes as the tree, decoded back field for field;
+    DataItem tree = cbor::decode(out);
+    assert(tree.size() == 10 && std::string(tree["name"]) == "triangle");
+    assert(int(tree["fill"]) == 2 && tree["points"].size() == 3);
+    assert(std::string(tree["points"].at(1)["label"]) == "b");
+    assert(int(tree["points"].at(1)["y"]) == 1 << 20);
+    assert(double(tree["weights"]["h"]) == 1e300);
+    assert(tree["extent"].at(1) == DataItem(INT64_MIN));
+    assert(cbor::encode(tree) == out);
+    serial::shape back;
+    bool decoded = cbor::deserialize(out, back);
+    assert(decoded);
+    assert(back.name == s.name && back.fill == s.fill);
+    assert(back.points.size() == 3 && back.points[1].y == 1 << 20 &&
+           back.points[1].label == "b" && back.points[2].x == 3);
+    assert(back.weights == s.weights && back.blobs == s.blobs);
+    assert(back.offsets == s.offsets && back.flag == s.flag);
+    assert(back.extent == s.extent && back.mask == s.mask);
+    assert(back.extra == s.extra);
+    assert(cbor::serialize(back) == out);
+
+    // scalars take the shortest heads, like DataItem;
+    assert(cbor::serialize(-500) == cbor::encode(DataItem(-500)));
+    assert(cbor::serialize(uint64_t(1) << 40) ==
+           cbor::encode(DataItem(uint64_t(1) << 40)));
+    assert(cbor::serialize(2.5) == cbor::encode(DataItem(2.5)));
+    assert(cbor::serialize(std::string("hi")) == cbor::encode(DataItem("hi")));
+
+    // unknown keys are skipped, missing fields are left alone;
+    std::vector<uint8_t> extra = cbor::encode(cbor::map({
+        {"x", 4},
+        {"z", cbor::array({cbor::map({{"x", 9}}), "deep"})},
+        {"label", "p"},
+    }));
+    serial::point p = {1, 2, ""};
+    decoded = cbor::deserialize(extra, p);
+    assert(decoded);
+    assert(p.x == 4 && p.y == 2 && p.label == "p");
+
+    // indefinite lengths and chunked strings, keys included;
+    cbor::Writer chunks;
+    chunks.begin_map().begin_string().value("la").value("bel").end();
+    chunks.begin_string().value("q").value("r").end();
+    chunks.key("y").value(-3).end();
+    decoded = cbor::deserialize(chunks.buffer(), p);
+    assert(decoded);
+    assert(p.x == 4 && p.y == -3 && p.label == "qr");
+    cbor::Writer list;
+    list.begin_array().value(1).value(2).value(3).end();
+    std::vector<int> ints;
+    decoded = cbor::deserialize(list.buffer(), ints);
+    assert(decoded && ints.size() == 3);
+    std::array<int, 3> fixed;
+    decoded = cbor::deserialize(list.buffer(), fixed);
+    assert(decoded && fixed[2] == 3);
+
+    // floats accept integers, integers must fit;
+    double d = 0;
+    decoded = cbor::deserialize(cbor::serialize(-7), d);
+    assert(decoded && d == -7);
+    uint8_t small = 0;
+    decoded = cbor::deserialize(cbor::serialize(255), small);
+    assert(decoded && small == 255);
+    decoded = cbor::deserialize(cbor::serialize(256), small);
+    assert(!decoded);
+    decoded = cbor::deserialize(cbor::serialize(-1), small);
+    assert(!decoded);
+    int8_t tiny = 0;
+    decoded = cbor::deserialize(cbor::serialize(-128), tiny);
+    assert(decoded && tiny == -128);
+    decoded = cbor::deserialize(cbor::serialize(-129), tiny);
+    assert(!decoded);
+
+    // shapes that do not match, and bad input, fail;
+    decoded = cbor::deserialize(cbor::serialize(std::string("x")), ints);
+    assert(!decoded);
+    std::array<int, 2> pair_of;
+    decoded = cbor::deserialize(list.buffer(), pair_of);
+    assert(!decoded);
+    std::tuple<int, int> two;
+    decoded = cbor::deserialize(list.buffer(), two);
+    assert(!decoded);
+    decoded = cbor::deserialize(cbor::encode(cbor::map({{"x", "4"}})), p);
+    assert(!decoded);
+    decoded = cbor::deserialize(cbor::encode(cbor::map({{1, 4}})), p);
+    assert(!decoded);
+    std::vector<uint8_t> truncated(out.begin(), out.end() - 1);
+    decoded = cbor::deserialize(truncated, back);
+    assert(!decoded);
+    std::vector<uint8_t> huge = {0x9b, 0xff, 0xff, 0xff, 0xff,
+                                 0xff, 0xff, 0xff, 0xff};
+    decoded = cbor::deserialize(huge, ints);
+    assert(!decoded);
+
+    // deserialize() over a sequence stops after one item;
+    std::vector<uint8_t> two_items = cbor::serialize(1);
+    cbor::serialize(std::string("next"), two_items);
+    int first = 0;
+    size_t used = cbor::deserialize(two_items.data(), two_items.size(), first);
+    assert(used == 1);
+    decoded = cbor::deserialize(two_items, first);
+    assert(!decoded);
+}
+
+void test_cddl() {
+    // the generated types encode like the equivalent trees;
+    messages::request request;
+    request.id = 42;
+    request.method = messages::method::delete_;
+    request.has_params = true;
+    messages::param name;
+    name.name = "path";
+    name.value = "/tmp/x";
+    messages::param depth;
+    depth.name = "depth";
+    depth.value = -3;
+    request.params = {name, depth};
+    request.has_trace = true;
+    request.trace.span = {1, 2, 3};
+    std::vector<uint8_t> out = cbor::serialize(request);
+    DataItem tree = cbor::map({
+        {"type", "request"},
+        {"id", 42},
+        {"method", "delete"},
+        {"params", cbor::array({
+            cbor::map({{"name", "path"}, {"value", "/tmp/x"}}),
+            cbor::map({{"name", "depth"}, {"value", -3}}),
+        })},
+        {"trace", cbor::map({{"span", std::vector<uint8_t>{1, 2, 3}}})},
+    });
+    assert(out == cbor::encode(tree));
+    messages::request back;
+    back.has_deadline = true;
+    bool valid = cbor::deserialize(out, back);
+    assert(valid);
+    assert(back.id == 42 && back.method == messages::method::delete_);
+    assert(back.has_params && back.params.size() == 2);
+    assert(back.params[1].name == "depth" && back.params[1].value == DataItem(-3));
+    assert(!back.has_deadline && back.has_trace && !back.trace.has_sampled);
+    assert(back.trace.span == request.trace.span);
+    assert(cbor::serialize(back) == out);
+
+    // keys in any order, unknown ones skipped, chunked and indefinite;
+    cbor::Writer shuffled;
+    shuffled.begin_map().key("method").value("list").key("extra");
+    shuffled.begin_array().value(1).value(cbor::map({{"id", 1}})).end();
+    shuffled.key(7).value(7).key("id").value(9);
+    shuffled.begin_string().value("ty").value("pe").end().value("request");
+    shuffled.key("deadline").value(1).end();
+    valid = cbor::deserialize(shuffled.buffer(), back);
+    assert(valid);
+    assert(back.id == 9 && back.method == messages::method::list);
+    assert(!back.has_params && back.has_deadline && back.deadline == 1);
+
+    // missing, repeated and mistyped members fail, as do wrong literals;
+    DataItem missing = cbor::map({{"type", "request"}, {"method", "get"}});
+    valid = cbor::deserialize(cbor::encode(missing), back);
+    assert(!valid);
+    DataItem literal = tree;
+    literal["type"] = "response";
+    valid = cbor::deserialize(cbor::encode(literal), back);
+    assert(!valid);
+    DataItem method = tree;
+    method["method"] = "post";
+    valid = cbor::deserialize(cbor::encode(method), back);
+    assert(!valid);
+    DataItem choice = tree;
+    choice["params"].at(0)["value"] = std::vector<uint8_t>{1};
+    valid = cbor::deserialize(cbor::encode(choice), back);
+    assert(!valid);
+    // nil is the one simple value the choice takes;
+    DataItem others[] = {DataItem(true), DataItem(false), DataItem(1.5),
+                         DataItem()};
+    for (const DataItem &other : others) {
+        choice["params"].at(0)["value"] = other;
+        valid = cbor::deserialize(cbor::encode(choice), back);
+        assert(!valid);
+    }
+    choice["params"].at(0)["value"] = DataItem(nullptr);
+    valid = cbor::deserialize(cbor::encode(choice), back);
+    assert(valid);
+    messages::param param;
+    valid = cbor::deserialize(
+        cbor::encode(cbor::map({{"name", "x"}, {"value", 1.5}})), param);
+    assert(!valid);
+    cbor::Writer repeated;
+    repeated.begin_map(4).key("type").value("request").key("id").value(1);
+    repeated.key("method").value("get").key("id").value(2);
+    valid = cbor::deserialize(repeated.buffer(), back);
+    assert(!valid);
+
+    // enums of integers, arrays, tables and integer keys;
+    messages::response response;
+    response.id = 1;
+    response.status = messages::status::v404;
+    response.has_error = true;
+    response.error.code = -2;
+    response.error.message = "not found";
+    response.has_headers = true;
+    response.headers["retry"] = "never";
+    out = cbor::serialize(response);
+    assert(out == cbor::encode(cbor::map({
+        {"id", 1},
+        {"status", 404},
+        {"error", cbor::array({-2, "not found"})},
+        {"headers", cbor::map({{"retry", "never"}})},
+    })));
+    messages::response decoded;
+    valid = cbor::deserialize(out, decoded);
+    assert(valid);
+    assert(decoded.status == messages::status::v404 && !decoded.has_body);
+    assert(decoded.error.message == "not found" && decoded.headers == response.headers);
+    DataItem status = cbor::decode(out);
+    status["status"] = 403;
+    valid = cbor::deserialize(cbor::encode(status), decoded);
+    assert(!valid);
+
+    messages::header header;
+    header.alg = -7;
+    header.has_key_n1 = true;
+    header.key_n1 = "x";
+    out = cbor::serialize(header);
+    assert(out == cbor::encode(cbor::map({{1, -7}, {-1, "x"}})));
+    messages::header parsed;
+    DataItem cose = cbor::map({{"1", 0}, {-1, "x"}, {1, 5}});
+    valid = cbor::deserialize(cbor::encode(cose), parsed);
+    assert(valid);
+    assert(parsed.alg == 5 && !parsed.has_kid && parsed.key_n1 == "x");
+
+    messages::ids ids = {1, 2, uint64_t(1) << 40};
+    messages::ids ids_back;
+    valid = cbor::deserialize(cbor::serialize(ids), ids_back);
+    assert(valid && ids_back == ids);
+}
+
+void test_canonical() {
+    // the key order example of RFC 8949 section 4.2.1, inserted reversed;
+    std::vector<DataItem> keys = {10, 100, -1, "z", "aa", cbor::array({100}),
+                                  cbor::array({-1}), false};
+    DataItem map = cbor::map();
+    for (size_t i = keys.size(); i-- > 0;) {
+        map[keys[i]] = int(i);
+    }
+    std::vector<uint8_t> out = cbor::encode_canonical(map);
+    const uint8_t expected[] = {0xa8, 0x0a, 0x00, 0x18, 0x64, 0x01, 0x20, 0x02,
+                                0x61, 'z', 0x03, 0x62, 'a', 'a', 0x04,
+                                0x81, 0x18, 0x64, 0x05, 0x81, 0x20, 0x06,
+                                0xf4, 0x07};
+    assert(out == std::vector<uint8_t>(expected, expected + sizeof(expected)));
+    assert(cbor::decode(out) == map);
+    assert(cbor::encode(map) != out);
+
+    // equal content gives equal bytes, whatever the order of the maps;
+    DataItem a = cbor::map({
+        {"id", 7},
+        {"tags", cbor::array({cbor::map({{"b", 1}, {"a", 2}})})},
+        {cbor::map({{2, 0}, {1, 0}}), "map key"},
+    });
+    DataItem b = cbor::map({
+        {cbor::map({{1, 0}, {2, 0}}), "map key"},
+        {"tags", cbor::array({cbor::map({{"a", 2}, {"b", 1}})})},
+        {"id", 7},
+    });
+    assert(a == b && cbor::encode(a) != cbor::encode(b));
+    assert(cbor::encode_canonical(a) == cbor::encode_canonical(b));
+    std::vector<uint8_t> reencoded =
+        cbor::encode_canonical(cbor::decode(cbor::encode(b)));
+    assert(reencoded == cbor::encode_canonical(a));
+
+    // floats take the shortest exact form, down to half precision;
+    struct {
+        double value;
+        std::vector<uint8_t> bytes;
+    } floats[] = {
+        {1.5, {0xf9, 0x3e, 0x00}},
+        {-0.0, {0xf9, 0x80, 0x00}},
+        {65504.0, {0xf9, 0x7b, 0xff}},
+        {5.960464477539063e-8, {0xf9, 0x00, 0x01}},
+        {3.0517578125e-05, {0xf9, 0x02, 0x00}},
+        {INFINITY, {0xf9, 0x7c, 0x00}},
+        {-INFINITY, {0xf9, 0xfc, 0x00}},
+        {NAN, {0xf9, 0x7e, 0x00}},
+        {100000.0, {0xfa, 0x47, 0xc3, 0x50, 0x00}},
+        {65536.0 + 32, {0xfa, 0x47, 0x80, 0x10, 0x00}},
+        {1.1, {0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}},
+    };
+    for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); ++i) {
+        assert(cbor::encode_canonical(DataItem(floats[i].value)) ==
+               floats[i].bytes);
+    }
+    DataItem half = cbor::decode(std::vector<uint8_t>{0xf9, 0x02, 0x00});
+    assert(double(half) == 3.0517578125e-05);
+
+    // heads are shortest whatever the input used;
+    std::vector<uint8_t> long_heads = {0xa1, 0x79, 0x00, 0x01, 'k',
+                                       0x1b, 0, 0, 0, 0, 0, 0, 0, 5};
+    assert(cbor::encode_canonical(cbor::decode(long_heads)) ==
+           (std::vector<uint8_t>{0xa1, 0x61, 'k', 0x05}));
+
+    // NaN keys that differ only in their payload would collide;
+    uint64_t payloads[] = {0x7ff8000000000000ull, 0x7ff8000000000001ull};
+    DataItem nans = cbor::map();
+    for (uint64_t payload : payloads) {
+        double nan;
+        memcpy(&nan, &payload, 8);
+        nans[DataItem(cbor::array({nan}))] = 1;
+    }
+    assert(nans.size() == 2);
+    std::vector<uint8_t> prefix = {0x01};
+    bool encoded_nans = cbor::encode_canonical(nans, prefix);
+    assert(!encoded_nans && prefix == std::vector<uint8_t>{0x01});
+    assert(cbor::encode_canonical(nans).empty());
+
+    // the comparator orders encodings as map keys are ordered;
+    std::vector<std::vector<uint8_t>> encoded;
+    for (size_t i = keys.size(); i-- > 0;) {
+        encoded.push_back(cbor::encode_canonical(keys[i]));
+    }
+    std::sort(encoded.begin(), encoded.end(), cbor::canonical_less());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        assert(cbor::decode(encoded[i]) == keys[i]);
+    }
+    const uint8_t x[] = {0x62, 'a', 'b'};
+    assert(cbor::compare_canonical(x, 3, x, 3) == 0);
+    assert(cbor::compare_canonical(x, 2, x, 3) < 0);
+    assert(cbor::compare_canonical(x, 3, x, 0) > 0);
+    assert(cbor::canonical_less()(cbor::bytes_view(x, 1), cbor::bytes_view(x, 2)));
+}
+
+void test_float16() {
+    // write() picks the shortest width that keeps the value exactly;
+    assert(cbor::encode(DataItem(1.5)) == (std::vector<uint8_t>{0xf9, 0x3e, 0x00}));
+    assert(cbor::encode(DataItem(0.5)).size() == 3);
+    assert(cbor::encode(DataItem(1.0f)).size() == 3);
+    assert(cbor::encode(DataItem(-0.0)) == (std::vector<uint8_t>{0xf9, 0x80, 0x00}));
+    assert(cbor::encode(DataItem(INFINITY)).size() == 3);
+    assert(cbor::encode(DataItem(NAN)).size() == 3);
+    assert(cbor::encode(DataItem(100000.0)).size() == 5);
+    assert(cbor::encode(DataItem(65536.0 + 32)).size() == 5);
+    assert(cbor::encode(DataItem(1.1)).size() == 9);
+    const double samples[] = {0.5, -2.75, 65504.0, 5.960464477539063e-8,
+                              6.097555160522461e-5, 100000.0, 1.1, 1e300};
+    for (double value : samples) {
+        assert(double(cbor::decode(cbor::encode(DataItem(value)))) == value);
+    }
+
+    // NaN payloads survive in the narrowest width that holds them;
+    uint64_t payload = 0x7ff8000000000000ull | uint64_t(0x155) << 42;
+    double nan;
+    memcpy(&nan, &payload, 8);
+    std::vector<uint8_t> out = cbor::encode(DataItem(nan));
+    assert(out == (std::vector<uint8_t>{0xf9, 0x7f, 0x55}));
+    double decoded = double(cbor::decode(out));
+    assert(memcmp(&decoded, &payload, 8) == 0);
+    payload |= 1u << 29;
+    memcpy(&nan, &payload, 8);
+    assert(cbor::encode(DataItem(nan)).size() == 5);
+
+    // conversions round to nearest even, like the hardware does;
+    assert(cbor::detail::float_to_half(1.0f + 1.0f / 2048) == 0x3c00);
+    assert(cbor::detail::float_to_half(1.0f + 3.0f / 2048) == 0x3c02);
+    assert(cbor::detail::float_to_half(65520.0f) == 0x7c00);
+    assert(cbor::detail::float_to_half(1e-8f) == 0x0000);
+    assert(cbor::detail::float_to_half(-1e-9f) == 0x8000);
+
+    // the bulk kernels agree with the scalar conversions on every half;
+    std::vector<uint16_t> halves(65536);
+    for (size_t i = 0; i < halves.size(); ++i) {
+        halves[i] = uint16_t(i);
+    }
+    std::vector<float> floats(halves.size());
+    cbor::detail::halves_to_floats(floats.data(), halves.data(), halves.size());
+    std::vector<uint16_t> back(halves.size());
+    cbor::detail::floats_to_halves(back.data(), floats.data(), floats.size());
+    for (size_t i = 0; i < halves.size(); ++i) {
+        float f = cbor::detail::half_to_float(halves[i]);
+        uint32_t scalar, bulk;
+        memcpy(&scalar, &f, 4);
+        memcpy(&bulk, &floats[i], 4);
+        // hardware quiets signaling NaNs, keeping the rest of the payload;
+        bool is_nan = (i & 0x7c00) == 0x7c00 && (i & 0x3ff) != 0;
+        uint32_t quiet = is_nan ? 0x400000 : 0;
+        assert((scalar | quiet) == (bulk | quiet));
+        assert((cbor::detail::float_to_half(floats[i]) | quiet >> 13) ==
+               (back[i] | quiet >> 13));
+        assert((back[i] | quiet >> 13) == (i | quiet >> 13));
+    }
+
+    // half-precision typed arrays convert in bulk, either byte order;
+    std::vector<float> values = {0.5f, -1.25f, 3.140625f, 1e-7f, 70000.0f};
+    for (size_t i = 0; i < 300; ++i) {
+        values.push_back(float(i) / 4);
+    }
+    DataItem array = DataItem::half_array(values);
+    assert(array.is_typed_array() && array.tag() == 84); // float16, little endian;
+    assert(cbor::encode(array).size() == 2 + 3 + values.size() * 2);
+    cbor::typed_view<float> view = array.as_typed<float>();
+    assert(view.size() == values.size());
+    assert(view[0] == 0.5f && view[1] == -1.25f && view[2] == 3.140625f);
+    assert(view[3] == cbor::detail::half_to_float(0x0002));
+    assert(view[4] == INFINITY);
+    for (size_t i = 5; i < values.size(); ++i) {
+        assert(view[i] == values[i]);
+    }
+    const uint8_t big_endian[] = {0xd8, 0x50, 0x44, 0x3c, 0x00, 0xc0, 0x00};
+    DataItem swapped = cbor::decode(std::vector<uint8_t>(
+        big_endian, big_endian + sizeof(big_endian)));
+    cbor::typed_view<double> doubles = swapped.as_typed<double>();
+    assert(doubles.size() == 2 && doubles[0] == 1.0 && doubles[1] == -2.0);
+}
+
 int main(int argc, char** argv) {
     test_array();
     test_map();
+    test_decode();
+    test_encode();
+    test_layout();
+    test_document();
+    test_borrow();
+    test_lazy();
+    test_sax();
+    test_push_decoder();
+    test_writer();
+    test_validate();
+    test_utf8();
+    test_tape();
+    test_query();
+    test_decode_sequence();
+    test_encode_parallel();
+    test_mapped_file();
+    test_sequence();
+    test_hash();
+    test_map_order();
+    test_stringref();
+    test_typed_array();
+    test_serialize();
+    test_cddl();
+    test_canonical();
+    test_float16();
     
     uint16_t int16 = 23;
     DataItem i16(int16);
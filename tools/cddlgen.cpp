@@ -0,0 +1,1510 @@
+/*
+ * cbor_cddlgen: generates C++ types with encoders and decoders specialized
+ * for a CDDL (RFC 8610) schema.
+ *
+ *   cbor_cddlgen schema.cddl output.hpp [namespace]
+ *
+ * Every rule becomes a type in `namespace`, and cbor::serialize() and
+ * cbor::deserialize() from serialize.hpp read and write it through a
+ * generated cbor::detail::codec specialization:
+ *
+ *   maps with literal keys   struct, optional keys get a has_<key> flag
+ *   arrays of fixed members  struct encoded as an array
+ *   [* type], [+ type]       std::vector, occurrence bounds are not checked
+ *   choices of literals      enum class
+ *   other choices            cbor::DataItem, checked for the major types
+ *   literal members          checked on decode, no member in the struct
+ *   uint, int, nint          uint64_t, int64_t
+ *   float, float16..64       double, or float for float16 and float32
+ *   tstr, bstr, bool, any    std::string, std::vector<uint8_t>, bool,
+ *                            cbor::DataItem
+ *
+ * Keys are matched with a switch on their length and a distinguishing
+ * byte instead of a lookup, and the heads and keys of a struct are written
+ * from bytes computed here. Decoders skip unknown keys and reject repeated
+ * ones. Group references, sockets, generics, tags, ranges and control
+ * operators are not supported and are reported as errors.
+ */
+#include "detail.hpp"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace major = cbor::major;
+
+struct diagnostic {
+  int line;
+  std::string message;
+};
+
+bool fail(diagnostic &d, int line, const std::string &message) {
+  d.line = line;
+  d.message = message;
+  return false;
+}
+
+/* ----------------------- lexer ----------------------- */
+struct token {
+  enum kind_t { End, Name, Number, Text, Punct };
+  kind_t kind;
+  std::string text;
+  int64_t number;
+  int line;
+};
+
+bool is_name_start(char c) {
+  return isalpha((unsigned char)c) || c == '@' || c == '_' || c == '$';
+}
+
+bool is_name_char(char c) {
+  return is_name_start(c) || isdigit((unsigned char)c);
+}
+
+bool lex(const std::string &s, std::vector<token> &tokens, diagnostic &d) {
+  // longer punctuators first;
+  static const char *const puncts[] = {"//=", "/=", "//", "=>", "=", "{",
+                                       "}",   "[",  "]",  "(",  ")", ",",
+                                       ":",   "/",  "?",  "*",  "+"};
+  int line = 1;
+  size_t i = 0;
+  while (i < s.size()) {
+    char c = s[i];
+    if (c == '\n') {
+      ++line;
+      ++i;
+      continue;
+    }
+    if (isspace((unsigned char)c)) {
+      ++i;
+      continue;
+    }
+    if (c == ';') {
+      while (i < s.size() && s[i] != '\n') {
+        ++i;
+      }
+      continue;
+    }
+    token t = {token::End, std::string(), 0, line};
+    if (is_name_start(c)) {
+      size_t start = i++;
+      // '-' and '.' may only join two name characters;
+      while (i < s.size() &&
+             (is_name_char(s[i]) || ((s[i] == '-' || s[i] == '.') &&
+                                     i + 1 < s.size() &&
+                                     is_name_char(s[i + 1])))) {
+        ++i;
+      }
+      t.kind = token::Name;
+      t.text = s.substr(start, i - start);
+    } else if (isdigit((unsigned char)c) ||
+               (c == '-' && i + 1 < s.size() &&
+                isdigit((unsigned char)s[i + 1]))) {
+      size_t start = i;
+      bool negative = c == '-';
+      i += negative;
+      int base = s.compare(i, 2, "0x") == 0 ? 16 : 10;
+      i += base == 16 ? 2 : 0;
+      size_t digits = i;
+      while (i < s.size() && (base == 16 ? isxdigit((unsigned char)s[i])
+                                         : isdigit((unsigned char)s[i]))) {
+        ++i;
+      }
+      if (i == digits ||
+          (i < s.size() && (s[i] == '.' || is_name_char(s[i])))) {
+        return fail(d, line, "floating-point literals and ranges are not "
+                             "supported");
+      }
+      errno = 0;
+      unsigned long long value =
+          strtoull(s.substr(digits, i - digits).c_str(), nullptr, base);
+      uint64_t limit = uint64_t(INT64_MAX) + negative;
+      if (errno != 0 || value > limit) {
+        return fail(d, line, "integer literal out of range");
+      }
+      t.kind = token::Number;
+      t.number = negative ? int64_t(0 - uint64_t(value)) : int64_t(value);
+      t.text = s.substr(start, i - start);
+    } else if (c == '"') {
+      for (++i; i < s.size() && s[i] != '"' && s[i] != '\n'; ++i) {
+        if (s[i] == '\\' && i + 1 < s.size()) {
+          ++i;
+        }
+        t.text += s[i];
+      }
+      if (i == s.size() || s[i] != '"') {
+        return fail(d, line, "unterminated string");
+      }
+      ++i;
+      t.kind = token::Text;
+    } else {
+      for (size_t p = 0; p < sizeof(puncts) / sizeof(puncts[0]); ++p) {
+        size_t length = strlen(puncts[p]);
+        if (s.compare(i, length, puncts[p]) == 0) {
+          t.kind = token::Punct;
+          t.text = puncts[p];
+          i += length;
+          break;
+        }
+      }
+      if (t.kind == token::End) {
+        return fail(d, line, std::string("unexpected character '") + c + "'");
+      }
+    }
+    tokens.push_back(t);
+  }
+  token end = {token::End, std::string(), 0, line};
+  tokens.push_back(end);
+  return true;
+}
+
+/* ----------------------- schema ----------------------- */
+struct field {
+  std::string name;
+  bool has_key;
+  bool text_key;
+  std::string key;
+  int64_t int_key;
+  // the key given as a type before "=>", resolved once all rules are known;
+  int key_type;
+  bool optional;
+  bool repeated;
+  int type;
+  int line;
+};
+
+struct node {
+  enum kind_t {
+    Primitive,
+    Reference,
+    Literal,
+    Map,
+    Array,
+    Vector,
+    Table,
+    Choice
+  };
+  kind_t kind;
+  int line;
+  // Primitive and Reference;
+  std::string name;
+  // Literal;
+  bool text;
+  std::string value;
+  int64_t number;
+  // Map and Array;
+  std::vector<field> fields;
+  // Choice;
+  std::vector<int> alternatives;
+  // Vector and Table, whose keys are of type `key`;
+  int element;
+  int key;
+};
+
+enum rule_kind { MapStruct, ArrayStruct, TextEnum, IntEnum, Constant, Alias };
+
+struct rule {
+  std::string name;
+  int type;
+  int line;
+  rule_kind kind;
+};
+
+struct schema {
+  std::vector<node> nodes;
+  std::vector<rule> rules;
+  std::map<std::string, size_t> names;
+
+  int add(const node &n) {
+    nodes.push_back(n);
+    return int(nodes.size() - 1);
+  }
+
+  const rule *find(const std::string &name) const {
+    std::map<std::string, size_t>::const_iterator it = names.find(name);
+    return it == names.end() ? nullptr : &rules[it->second];
+  }
+};
+
+node make_node(node::kind_t kind, int line) {
+  node n;
+  n.kind = kind;
+  n.line = line;
+  n.text = false;
+  n.number = 0;
+  n.element = -1;
+  n.key = -1;
+  return n;
+}
+
+bool is_prelude(const std::string &name) {
+  static const char *const prelude[] = {
+      "any",   "uint",    "nint",    "int",     "bstr", "bytes", "tstr",
+      "text",  "float",   "float16", "float32", "float64", "bool", "nil",
+      "null"};
+  for (size_t i = 0; i < sizeof(prelude) / sizeof(prelude[0]); ++i) {
+    if (name == prelude[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ----------------------- parser ----------------------- */
+class parser {
+public:
+  parser(const std::vector<token> &tokens, schema &out, diagnostic &d)
+      : tokens_(tokens), out_(out), d_(d), pos_(0) {}
+
+  bool parse() {
+    while (peek().kind != token::End) {
+      const token &name = peek();
+      if (name.kind != token::Name) {
+        return fail(d_, name.line, "expected a rule name");
+      }
+      ++pos_;
+      if (is("/=") || is("//=")) {
+        return fail(d_, name.line, "choice extensions are not supported");
+      }
+      if (!is("=")) {
+        return fail(d_, name.line, "expected '=' after " + name.text);
+      }
+      ++pos_;
+      rule r = {name.text, -1, name.line, Alias};
+      if (!parse_type(r.type)) {
+        return false;
+      }
+      if (is_prelude(r.name) || out_.find(r.name) != nullptr) {
+        return fail(d_, r.line, r.name + " is already defined");
+      }
+      out_.names[r.name] = out_.rules.size();
+      out_.rules.push_back(r);
+    }
+    return true;
+  }
+
+private:
+  const std::vector<token> &tokens_;
+  schema &out_;
+  diagnostic &d_;
+  size_t pos_;
+
+  const token &peek(size_t ahead = 0) const {
+    size_t i = pos_ + ahead;
+    return tokens_[i < tokens_.size() ? i : tokens_.size() - 1];
+  }
+
+  bool is(const char *punct, size_t ahead = 0) const {
+    const token &t = peek(ahead);
+    return t.kind == token::Punct && t.text == punct;
+  }
+
+  bool parse_type(int &type) {
+    int first = -1;
+    if (!parse_type1(first)) {
+      return false;
+    }
+    if (!is("/")) {
+      type = first;
+      return true;
+    }
+    node choice = make_node(node::Choice, out_.nodes[first].line);
+    choice.alternatives.push_back(first);
+    while (is("/")) {
+      ++pos_;
+      int next = -1;
+      if (!parse_type1(next)) {
+        return false;
+      }
+      choice.alternatives.push_back(next);
+    }
+    type = out_.add(choice);
+    return true;
+  }
+
+  bool parse_type1(int &type) {
+    const token &t = peek();
+    if (t.kind == token::Name) {
+      ++pos_;
+      node n = make_node(is_prelude(t.text) ? node::Primitive : node::Reference,
+                         t.line);
+      n.name = t.text;
+      type = out_.add(n);
+      return true;
+    }
+    if (t.kind == token::Number || t.kind == token::Text) {
+      ++pos_;
+      node n = make_node(node::Literal, t.line);
+      n.text = t.kind == token::Text;
+      n.value = t.text;
+      n.number = t.number;
+      type = out_.add(n);
+      return true;
+    }
+    if (is("(")) {
+      ++pos_;
+      if (!parse_type(type)) {
+        return false;
+      }
+      if (!is(")")) {
+        return fail(d_, peek().line, "expected ')'");
+      }
+      ++pos_;
+      return true;
+    }
+    if (is("{") || is("[")) {
+      bool map = is("{");
+      ++pos_;
+      node n = make_node(map ? node::Map : node::Array, t.line);
+      if (!parse_group(n, map ? "}" : "]")) {
+        return false;
+      }
+      // [* type] is a list, { * key => type } a table, any other array
+      // or map a fixed sequence of members;
+      if (n.fields.size() == 1 && n.fields[0].repeated &&
+          (!map || n.fields[0].key_type >= 0)) {
+        node list = make_node(map ? node::Table : node::Vector, t.line);
+        list.element = n.fields[0].type;
+        list.key = n.fields[0].key_type;
+        type = out_.add(list);
+        return true;
+      }
+      type = out_.add(n);
+      return true;
+    }
+    return fail(d_, t.line, "expected a type");
+  }
+
+  bool parse_group(node &n, const char *close) {
+    while (!is(close)) {
+      if (peek().kind == token::End) {
+        return fail(d_, n.line, std::string("missing '") + close + "'");
+      }
+      field f = {std::string(), false, true, std::string(), 0, -1,
+                 false, false, -1, peek().line};
+      if (is("?")) {
+        f.optional = true;
+        ++pos_;
+      } else if (is("*") || is("+") ||
+                 (peek().kind == token::Number && is("*", 1))) {
+        f.repeated = true;
+        pos_ += peek().kind == token::Number ? 2 : 1;
+        if (peek().kind == token::Number && !is(":", 1) && !is("=>", 1)) {
+          ++pos_;
+        }
+      }
+      const token &k = peek();
+      if ((k.kind == token::Name || k.kind == token::Text ||
+           k.kind == token::Number) &&
+          is(":", 1)) {
+        f.has_key = true;
+        f.text_key = k.kind != token::Number;
+        f.key = k.text;
+        f.int_key = k.number;
+        pos_ += 2;
+        if (!parse_type(f.type)) {
+          return false;
+        }
+      } else {
+        if (!parse_type(f.type)) {
+          return false;
+        }
+        if (is("=>")) {
+          ++pos_;
+          f.key_type = f.type;
+          if (!parse_type(f.type)) {
+            return false;
+          }
+        }
+      }
+      n.fields.push_back(f);
+      if (is(",")) {
+        ++pos_;
+      }
+    }
+    ++pos_;
+    return true;
+  }
+};
+
+/* ----------------------- checks ----------------------- */
+const char *const keywords[] = {
+    "alignas",   "alignof",  "and",      "asm",       "auto",     "bool",
+    "break",     "case",     "catch",    "char",      "class",    "const",
+    "continue",  "default",  "delete",   "do",        "double",   "else",
+    "enum",      "explicit", "export",   "extern",    "false",    "float",
+    "for",       "friend",   "goto",     "if",        "inline",   "int",
+    "long",      "mutable",  "namespace", "new",      "noexcept", "not",
+    "nullptr",   "operator", "or",       "private",   "protected", "public",
+    "register",  "return",   "short",    "signed",    "sizeof",   "static",
+    "struct",    "switch",   "template", "this",      "throw",    "true",
+    "try",       "typedef",  "typename", "union",     "unsigned", "using",
+    "virtual",   "void",     "volatile", "while",     "xor"};
+
+// A C++ identifier for a CDDL name, clear of keywords;
+std::string identifier(const std::string &name) {
+  std::string id;
+  for (size_t i = 0; i < name.size(); ++i) {
+    id += isalnum((unsigned char)name[i]) ? name[i] : '_';
+  }
+  if (id.empty() || isdigit((unsigned char)id[0])) {
+    id = "_" + id;
+  }
+  for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i) {
+    if (id == keywords[i]) {
+      return id + "_";
+    }
+  }
+  return id;
+}
+
+std::string number_name(const char *prefix, int64_t number) {
+  std::ostringstream name;
+  name << prefix;
+  if (number < 0) {
+    name << 'n' << (0 - uint64_t(number));
+  } else {
+    name << number;
+  }
+  return name.str();
+}
+
+bool is_literal_choice(const schema &s, int type) {
+  const node &n = s.nodes[type];
+  if (n.kind != node::Choice) {
+    return false;
+  }
+  for (size_t i = 0; i < n.alternatives.size(); ++i) {
+    const node &a = s.nodes[n.alternatives[i]];
+    if (a.kind != node::Literal || a.text != s.nodes[n.alternatives[0]].text) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Names the members of a map or array and settles their keys;
+bool check_members(schema &s, int type, diagnostic &d) {
+  node &n = s.nodes[type];
+  std::vector<field> fields;
+  for (size_t i = 0; i < n.fields.size(); ++i) {
+    field f = n.fields[i];
+    if (f.key_type >= 0) {
+      const node &k = s.nodes[f.key_type];
+      const rule *named = k.kind == node::Reference ? s.find(k.name) : nullptr;
+      const node *literal = &k;
+      if (named != nullptr) {
+        literal = &s.nodes[named->type];
+        f.name = identifier(named->name);
+      }
+      if (literal->kind == node::Literal) {
+        f.has_key = true;
+        f.text_key = literal->text;
+        f.key = literal->value;
+        f.int_key = literal->number;
+      }
+    }
+    if (n.kind == node::Map) {
+      // "* tstr => any" and the like only allow further keys, which the
+      // decoders skip anyway;
+      if (f.repeated) {
+        continue;
+      }
+      if (!f.has_key) {
+        return fail(d, f.line, "map members need a literal key");
+      }
+      if (f.name.empty()) {
+        f.name = f.text_key ? identifier(f.key)
+                            : number_name("key_", f.int_key);
+      }
+    } else {
+      if (f.repeated || f.optional) {
+        return fail(d, f.line, "optional and repeated array members are "
+                               "only supported as [* type]");
+      }
+      if (f.key_type >= 0) {
+        return fail(d, f.line, "array members cannot have keys");
+      }
+      std::ostringstream position;
+      position << "_" << fields.size();
+      f.name = f.has_key && f.text_key ? identifier(f.key) : position.str();
+    }
+    for (size_t j = 0; j < fields.size(); ++j) {
+      bool same_key = f.text_key == fields[j].text_key &&
+                      (f.text_key ? f.key == fields[j].key
+                                  : f.int_key == fields[j].int_key);
+      if (fields[j].name == f.name || (n.kind == node::Map && same_key)) {
+        return fail(d, f.line, "member " + f.name + " is repeated");
+      }
+    }
+    fields.push_back(f);
+  }
+  if (fields.size() > 64) {
+    return fail(d, n.line, "more than 64 members");
+  }
+  if (n.kind == node::Map) {
+    for (size_t i = 1; i < fields.size(); ++i) {
+      if (fields[i].text_key != fields[0].text_key) {
+        return fail(d, n.line, "maps mixing text and integer keys are not "
+                               "supported");
+      }
+    }
+  }
+  s.nodes[type].fields = fields;
+  return true;
+}
+
+// Structs and enums nested in a rule become rules of their own, named
+// after the rule and the member;
+int hoist(schema &s, int type, const std::string &name, diagnostic &d) {
+  const node &n = s.nodes[type];
+  if (n.kind == node::Vector || n.kind == node::Table) {
+    int element = hoist(s, n.element, name, d);
+    s.nodes[type].element = element;
+    return element < 0 ? -1 : type;
+  }
+  if (n.kind != node::Map && n.kind != node::Array &&
+      !is_literal_choice(s, type)) {
+    return type;
+  }
+  if (s.find(name) != nullptr) {
+    fail(d, n.line, name + " is already defined");
+    return -1;
+  }
+  rule r = {name, type, n.line, Alias};
+  s.names[name] = s.rules.size();
+  s.rules.push_back(r);
+  node reference = make_node(node::Reference, n.line);
+  reference.name = name;
+  return s.add(reference);
+}
+
+bool check_references(const schema &s, diagnostic &d) {
+  for (size_t i = 0; i < s.nodes.size(); ++i) {
+    const node &n = s.nodes[i];
+    if (n.kind == node::Reference && s.find(n.name) == nullptr) {
+      return fail(d, n.line, "unknown rule " + n.name);
+    }
+    if (n.kind == node::Primitive && (n.name == "nil" || n.name == "null")) {
+      bool in_choice = false;
+      for (size_t j = 0; j < s.nodes.size(); ++j) {
+        const std::vector<int> &a = s.nodes[j].alternatives;
+        for (size_t k = 0; k < a.size(); ++k) {
+          in_choice = in_choice || a[k] == int(i);
+        }
+      }
+      if (!in_choice) {
+        return fail(d, n.line, n.name + " is only supported in a choice");
+      }
+    }
+  }
+  return true;
+}
+
+bool check(schema &s, diagnostic &d) {
+  if (!check_references(s, d)) {
+    return false;
+  }
+  for (size_t i = 0; i < s.nodes.size(); ++i) {
+    if ((s.nodes[i].kind == node::Map || s.nodes[i].kind == node::Array) &&
+        !check_members(s, int(i), d)) {
+      return false;
+    }
+  }
+  std::map<std::string, std::string> identifiers;
+  for (size_t i = 0; i < s.rules.size(); ++i) {
+    int type = s.rules[i].type;
+    node::kind_t kind = s.nodes[type].kind;
+    if (kind == node::Map || kind == node::Array) {
+      // hoisting adds nodes, so members are looked up by index;
+      for (size_t j = 0; j < s.nodes[type].fields.size(); ++j) {
+        field f = s.nodes[type].fields[j];
+        int hoisted = hoist(s, f.type, s.rules[i].name + "-" + f.name, d);
+        if (hoisted < 0) {
+          return false;
+        }
+        s.nodes[type].fields[j].type = hoisted;
+      }
+    } else if ((kind == node::Vector || kind == node::Table) &&
+               hoist(s, type, s.rules[i].name + "-item", d) < 0) {
+      return false;
+    }
+    rule &r = s.rules[i];
+    const node &top = s.nodes[r.type];
+    if (top.kind == node::Map) {
+      r.kind = MapStruct;
+    } else if (top.kind == node::Array) {
+      r.kind = ArrayStruct;
+    } else if (is_literal_choice(s, r.type)) {
+      r.kind = s.nodes[top.alternatives[0]].text ? TextEnum : IntEnum;
+    } else if (top.kind == node::Literal) {
+      r.kind = Constant;
+    }
+    std::string id = identifier(r.name);
+    if (identifiers.count(id) != 0) {
+      return fail(d, r.line, r.name + " and " + identifiers[id] +
+                                 " map to the same C++ name");
+    }
+    identifiers[id] = r.name;
+  }
+  return true;
+}
+
+/* ----------------------- generator ----------------------- */
+class generator {
+public:
+  generator(const schema &s, const std::string &space, diagnostic &d)
+      : s_(s), d_(d), prefix_("::" + (space.empty() ? "" : space + "::")),
+        space_(space), arrays_(0) {}
+
+  bool generate(const std::string &source, std::string &result) {
+    std::vector<int> state(s_.rules.size(), 0);
+    for (size_t i = 0; i < s_.rules.size(); ++i) {
+      if (!visit(i, state)) {
+        return false;
+      }
+    }
+    std::ostringstream o;
+    o << "// Generated by cbor_cddlgen from " << source
+      << ", do not edit.\n"
+         "#pragma once\n\n"
+         "#include \"serialize.hpp\"\n\n"
+         "#include <map>\n"
+         "#include <stdint.h>\n"
+         "#include <string.h>\n"
+         "#include <string>\n"
+         "#include <vector>\n\n";
+    if (!space_.empty()) {
+      o << "namespace " << space_ << " {\n\n";
+    }
+    for (size_t i = 0; i < order_.size(); ++i) {
+      declare(o, s_.rules[order_[i]]);
+    }
+    if (!space_.empty()) {
+      o << "} // namespace " << space_ << "\n\n";
+    }
+    o << "namespace cbor {\n\nnamespace detail {\n";
+    for (size_t i = 0; i < order_.size(); ++i) {
+      const rule &r = s_.rules[order_[i]];
+      switch (r.kind) {
+      case MapStruct:
+        map_codec(o, r);
+        break;
+      case ArrayStruct:
+        array_codec(o, r);
+        break;
+      case TextEnum:
+      case IntEnum:
+        enum_codec(o, r);
+        break;
+      default:
+        break;
+      }
+    }
+    o << "\n} // namespace detail\n\n} // namespace cbor\n";
+    result = o.str();
+    return true;
+  }
+
+private:
+  const schema &s_;
+  diagnostic &d_;
+  std::string prefix_;
+  std::string space_;
+  std::vector<size_t> order_;
+  int arrays_;
+
+  /* ---- types ---- */
+  const rule &rule_of(int type) const { return *s_.find(s_.nodes[type].name); }
+
+  // The node a type stands for once aliases are followed;
+  int resolve(int type) const {
+    while (s_.nodes[type].kind == node::Reference) {
+      const rule &r = rule_of(type);
+      if (r.kind != Alias && r.kind != Constant) {
+        break;
+      }
+      type = r.type;
+    }
+    return type;
+  }
+
+  bool is_literal(int type) const {
+    return s_.nodes[resolve(type)].kind == node::Literal;
+  }
+
+  bool is_choice(int type) const {
+    int resolved = resolve(type);
+    return s_.nodes[resolved].kind == node::Choice &&
+           !is_literal_choice(s_, resolved);
+  }
+
+  std::string cpp_type(int type) const {
+    const node &n = s_.nodes[type];
+    switch (n.kind) {
+    case node::Primitive:
+      if (n.name == "uint") {
+        return "uint64_t";
+      } else if (n.name == "int" || n.name == "nint") {
+        return "int64_t";
+      } else if (n.name == "float16" || n.name == "float32") {
+        return "float";
+      } else if (n.name == "float" || n.name == "float64") {
+        return "double";
+      } else if (n.name == "bool") {
+        return "bool";
+      } else if (n.name == "tstr" || n.name == "text") {
+        return "std::string";
+      } else if (n.name == "bstr" || n.name == "bytes") {
+        return "std::vector<uint8_t>";
+      }
+      return "cbor::DataItem";
+    case node::Reference:
+      return prefix_ + identifier(n.name);
+    case node::Vector:
+      return "std::vector<" + cpp_type(n.element) + ">";
+    case node::Table:
+      return "std::map<" + cpp_type(n.key) + ", " + cpp_type(n.element) + ">";
+    default:
+      return "cbor::DataItem";
+    }
+  }
+
+  std::string initializer(int type) const {
+    const node &n = s_.nodes[resolve(type)];
+    if (n.kind == node::Primitive) {
+      if (n.name == "bool") {
+        return " = false";
+      }
+      if (n.name.compare(0, 4, "uint") == 0 || n.name == "int" ||
+          n.name == "nint" || n.name.compare(0, 5, "float") == 0) {
+        return " = 0";
+      }
+    }
+    if (n.kind == node::Reference) {
+      const rule &r = rule_of(resolve(type));
+      if (r.kind == TextEnum || r.kind == IntEnum) {
+        return " = " + prefix_ + identifier(r.name) +
+               "::" + enumerator(r, 0);
+      }
+    }
+    return "";
+  }
+
+  std::string enumerator(const rule &r, size_t i) const {
+    const node &a = s_.nodes[s_.nodes[r.type].alternatives[i]];
+    return a.text ? identifier(a.value) : number_name("v", a.number);
+  }
+
+  // Bit m is set when an item of major type m may match;
+  unsigned majors(int type) const {
+    const node &n = s_.nodes[resolve(type)];
+    switch (n.kind) {
+    case node::Primitive:
+      if (n.name == "uint") {
+        return 1u << major::Unsigned;
+      } else if (n.name == "nint") {
+        return 1u << major::Negative;
+      } else if (n.name == "int") {
+        return 1u << major::Unsigned | 1u << major::Negative;
+      } else if (n.name == "tstr" || n.name == "text") {
+        return 1u << major::TextString;
+      } else if (n.name == "bstr" || n.name == "bytes") {
+        return 1u << major::ByteString;
+      } else if (n.name == "any") {
+        return 0xff;
+      }
+      return 1u << major::Simple;
+    case node::Literal:
+      return n.text ? 1u << major::TextString
+                    : 1u << (n.number < 0 ? major::Negative : major::Unsigned);
+    case node::Vector:
+    case node::Array:
+      return 1u << major::Array;
+    case node::Map:
+    case node::Table:
+      return 1u << major::Map;
+    case node::Choice: {
+      unsigned mask = 0;
+      for (size_t i = 0; i < n.alternatives.size(); ++i) {
+        mask |= majors(n.alternatives[i]);
+      }
+      return mask;
+    }
+    case node::Reference:
+      switch (rule_of(resolve(type)).kind) {
+      case MapStruct:
+        return 1u << major::Map;
+      case ArrayStruct:
+        return 1u << major::Array;
+      case TextEnum:
+        return 1u << major::TextString;
+      default:
+        return 1u << major::Unsigned | 1u << major::Negative;
+      }
+    }
+    return 0xff;
+  }
+
+  // Bit m is set when an item of major type 7 with additional information
+  // m may match, which tells nil, booleans and floats apart;
+  uint32_t simples(int type) const {
+    const node &n = s_.nodes[resolve(type)];
+    if (n.kind == node::Choice) {
+      uint32_t mask = 0;
+      for (size_t i = 0; i < n.alternatives.size(); ++i) {
+        mask |= simples(n.alternatives[i]);
+      }
+      return mask;
+    }
+    if (n.kind != node::Primitive) {
+      return 0;
+    }
+    const uint32_t half = 1u << 25, single = 1u << 26, double_ = 1u << 27;
+    if (n.name == "nil" || n.name == "null") {
+      return 1u << 22;
+    } else if (n.name == "bool") {
+      return 1u << 20 | 1u << 21;
+    } else if (n.name == "false") {
+      return 1u << 20;
+    } else if (n.name == "true") {
+      return 1u << 21;
+    } else if (n.name == "undefined") {
+      return 1u << 23;
+    } else if (n.name == "float16") {
+      return half;
+    } else if (n.name == "float32") {
+      return single;
+    } else if (n.name == "float64") {
+      return double_;
+    } else if (n.name == "float16-32") {
+      return half | single;
+    } else if (n.name == "float32-64") {
+      return single | double_;
+    } else if (n.name == "float") {
+      return half | single | double_;
+    }
+    return majors(type) >> major::Simple & 1 ? 0xffffffffu : 0;
+  }
+
+  /* ---- order ---- */
+  // Rules whose complete types `type` needs;
+  void dependencies(int type, std::vector<size_t> &out) const {
+    const node &n = s_.nodes[type];
+    if (n.kind == node::Reference) {
+      out.push_back(s_.names.find(n.name)->second);
+    } else if (n.kind == node::Vector || n.kind == node::Table) {
+      dependencies(n.element, out);
+    } else if (n.kind == node::Map || n.kind == node::Array) {
+      for (size_t i = 0; i < n.fields.size(); ++i) {
+        dependencies(n.fields[i].type, out);
+      }
+    }
+  }
+
+  bool visit(size_t index, std::vector<int> &state) {
+    if (state[index] == 2) {
+      return true;
+    }
+    const rule &r = s_.rules[index];
+    if (state[index] == 1) {
+      return fail(d_, r.line, "recursive rule " + r.name +
+                                  " is not supported");
+    }
+    state[index] = 1;
+    std::vector<size_t> needed;
+    dependencies(r.type, needed);
+    for (size_t i = 0; i < needed.size(); ++i) {
+      if (!visit(needed[i], state)) {
+        return false;
+      }
+    }
+    state[index] = 2;
+    order_.push_back(index);
+    return true;
+  }
+
+  /* ---- declarations ---- */
+  void declare(std::ostream &o, const rule &r) const {
+    std::string name = identifier(r.name);
+    const node &n = s_.nodes[r.type];
+    switch (r.kind) {
+    case MapStruct:
+    case ArrayStruct:
+      o << "struct " << name << " {\n";
+      for (size_t i = 0; i < n.fields.size(); ++i) {
+        const field &f = n.fields[i];
+        if (is_literal(f.type)) {
+          continue;
+        }
+        if (f.optional) {
+          o << "  bool has_" << f.name << " = false;\n";
+        }
+        o << "  " << cpp_type(f.type) << " " << f.name
+          << initializer(f.type) << ";\n";
+      }
+      o << "};\n\n";
+      break;
+    case TextEnum:
+    case IntEnum:
+      o << "enum class " << name << (r.kind == IntEnum ? " : int64_t" : "")
+        << " {\n";
+      for (size_t i = 0; i < n.alternatives.size(); ++i) {
+        o << "  " << enumerator(r, i);
+        if (r.kind == IntEnum) {
+          o << " = " << integer(s_.nodes[n.alternatives[i]].number);
+        }
+        o << ",\n";
+      }
+      o << "};\n\n";
+      break;
+    case Constant:
+      break;
+    case Alias:
+      o << "using " << name << " = " << cpp_type(r.type) << ";\n\n";
+      break;
+    }
+  }
+
+  /* ---- literals ---- */
+  static std::string integer(int64_t number) {
+    if (number == INT64_MIN) {
+      return "-9223372036854775807 - 1";
+    }
+    std::ostringstream text;
+    text << number;
+    return text.str();
+  }
+
+  static std::string quoted(const std::string &text) {
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+      unsigned char c = text[i];
+      if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') {
+        out += char(c);
+      } else {
+        char escape[8];
+        snprintf(escape, sizeof(escape), "\\%03o", c);
+        out += escape;
+      }
+    }
+    return out + "\"";
+  }
+
+  static std::string character(unsigned char c) {
+    if (isalnum(c) || c == '_' || c == '-' || c == ' ') {
+      return std::string("'") + char(c) + "'";
+    }
+    std::ostringstream text;
+    text << unsigned(c);
+    return text.str();
+  }
+
+  static void append_head(std::vector<uint8_t> &bytes, int major,
+                          uint64_t value) {
+    uint8_t head[9];
+    bytes.insert(bytes.end(), head, cbor::detail::write_head(head, major,
+                                                             value));
+  }
+
+  static void append_text(std::vector<uint8_t> &bytes, const std::string &s) {
+    append_head(bytes, major::TextString, s.size());
+    bytes.insert(bytes.end(), s.begin(), s.end());
+  }
+
+  void append_literal(std::vector<uint8_t> &bytes, int type) const {
+    const node &n = s_.nodes[resolve(type)];
+    if (n.text) {
+      append_text(bytes, n.value);
+    } else if (n.number < 0) {
+      append_head(bytes, major::Negative, ~uint64_t(n.number));
+    } else {
+      append_head(bytes, major::Unsigned, uint64_t(n.number));
+    }
+  }
+
+  void append_key(std::vector<uint8_t> &bytes, const field &f) const {
+    if (f.text_key) {
+      append_text(bytes, f.key);
+    } else if (f.int_key < 0) {
+      append_head(bytes, major::Negative, ~uint64_t(f.int_key));
+    } else {
+      append_head(bytes, major::Unsigned, uint64_t(f.int_key));
+    }
+  }
+
+  // Declares a static array holding `bytes`;
+  std::string table(std::ostream &o, const std::vector<uint8_t> &bytes,
+                    const std::string &indent) {
+    std::ostringstream name;
+    name << "bytes" << arrays_++;
+    o << indent << "static const uint8_t " << name.str() << "[] = {";
+    size_t column = 80;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      char hex[8];
+      snprintf(hex, sizeof(hex), "0x%02x", bytes[i]);
+      if (column + 6 > 78) {
+        o << (i == 0 ? "" : ",") << "\n" << indent << "    ";
+        column = indent.size() + 4;
+      } else {
+        o << ", ";
+      }
+      o << hex;
+      column += 6;
+    }
+    o << "};\n";
+    return name.str();
+  }
+
+  // Writes out bytes computed here as one insert, and empties `bytes`;
+  void put(std::ostream &o, std::vector<uint8_t> &bytes,
+           const std::string &indent) {
+    if (bytes.empty()) {
+      return;
+    }
+    std::string name = table(o, bytes, indent);
+    o << indent << "out.insert(out.end(), " << name << ", " << name
+      << " + sizeof(" << name << "));\n";
+    bytes.clear();
+  }
+
+  /* ---- key dispatch ---- */
+  // Index of the text key [key, key + size) in `keys`, or -1: a switch on
+  // the length, then on a byte where keys of that length differ;
+  static void text_index(std::ostream &o,
+                         const std::vector<std::string> &keys) {
+    o << "  static int index(const char *key, size_t size) {\n";
+    if (keys.empty()) {
+      o << "    (void)key;\n    (void)size;\n    return -1;\n  }\n";
+      return;
+    }
+    o << "    switch (size) {\n";
+    std::map<size_t, std::vector<size_t>> lengths;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      lengths[keys[i].size()].push_back(i);
+    }
+    for (std::map<size_t, std::vector<size_t>>::const_iterator it =
+             lengths.begin();
+         it != lengths.end(); ++it) {
+      const std::vector<size_t> &group = it->second;
+      size_t length = it->first;
+      o << "    case " << length << ":\n";
+      size_t position = length;
+      for (size_t p = 0; p < length && group.size() > 1; ++p) {
+        bool distinct = true;
+        for (size_t a = 0; a < group.size() && distinct; ++a) {
+          for (size_t b = a + 1; b < group.size() && distinct; ++b) {
+            distinct = keys[group[a]][p] != keys[group[b]][p];
+          }
+        }
+        if (distinct) {
+          position = p;
+          break;
+        }
+      }
+      if (group.size() == 1) {
+        o << "      return " << compare(keys[group[0]], group[0]) << ";\n";
+      } else if (position < length) {
+        o << "      switch (uint8_t(key[" << position << "])) {\n";
+        for (size_t i = 0; i < group.size(); ++i) {
+          o << "      case "
+            << character(keys[group[i]][position]) << ":\n"
+            << "        return " << compare(keys[group[i]], group[i])
+            << ";\n";
+        }
+        o << "      }\n      return -1;\n";
+      } else {
+        for (size_t i = 0; i < group.size(); ++i) {
+          o << "      if (memcmp(key, " << quoted(keys[group[i]]) << ", "
+            << length << ") == 0) {\n        return " << group[i]
+            << ";\n      }\n";
+        }
+        o << "      return -1;\n";
+      }
+    }
+    o << "    }\n    return -1;\n  }\n";
+  }
+
+  static std::string compare(const std::string &key, size_t index) {
+    std::ostringstream text;
+    if (key.empty()) {
+      text << index;
+    } else {
+      text << "memcmp(key, " << quoted(key) << ", " << key.size()
+           << ") == 0 ? " << index << " : -1";
+    }
+    return text.str();
+  }
+
+  static void int_index(std::ostream &o, const std::vector<int64_t> &keys) {
+    o << "  static int index(int64_t key) {\n    switch (key) {\n";
+    for (size_t i = 0; i < keys.size(); ++i) {
+      o << "    case " << integer(keys[i]) << ":\n      return " << i
+        << ";\n";
+    }
+    o << "    }\n    return -1;\n  }\n";
+  }
+
+  /* ---- codecs ---- */
+  void open_codec(std::ostream &o, const rule &r, const char *by) const {
+    std::string type = prefix_ + identifier(r.name);
+    o << "\ntemplate <> struct codec<" << type << "> {\n"
+      << "  static void encode(std::vector<uint8_t> &out,\n"
+      << "                     " << by << type
+      << (by[0] != '\0' ? " &" : " ") << "value) {\n";
+  }
+
+  // Decodes into member `f`, or checks a literal;
+  void decode_field(std::ostream &o, const field &f,
+                    const std::string &indent) const {
+    int type = resolve(f.type);
+    const node &n = s_.nodes[type];
+    if (n.kind == node::Literal && n.text) {
+      o << indent << "const char *text = nullptr;\n"
+        << indent << "size_t length = 0;\n"
+        << indent << "return read_string(r, major::TextString, text, "
+                     "length, scratch) &&\n"
+        << indent << "       length == " << n.value.size()
+        << " && memcmp(text, " << quoted(n.value) << ", "
+        << n.value.size() << ") == 0;\n";
+    } else if (n.kind == node::Literal) {
+      o << indent << "int64_t number = 0;\n"
+        << indent << "return codec<int64_t>::decode(r, number) && number == "
+        << integer(n.number) << ";\n";
+    } else if (is_choice(f.type)) {
+      uint32_t simple = simples(f.type);
+      char mask[16], minors[16];
+      snprintf(mask, sizeof(mask), "0x%02xu", majors(f.type));
+      snprintf(minors, sizeof(minors), "0x%08xu", unsigned(simple));
+      o << indent << "return r.p != r.end && (" << mask
+        << " >> (*r.p >> 5) & 1) != 0 &&\n";
+      if (simple != 0 && simple != 0xffffffffu) {
+        // major type 7 is checked down to the initial byte;
+        o << indent << "       (*r.p < 0xe0 || (" << minors
+          << " >> (*r.p & 31) & 1) != 0) &&\n";
+      }
+      o << indent << "       codec<cbor::DataItem>::decode(r, value."
+        << f.name << ");\n";
+    } else {
+      o << indent << "return codec<" << cpp_type(f.type)
+        << ">::decode(r, value." << f.name << ");\n";
+    }
+  }
+
+  bool needs_scratch(const node &n) const {
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      const node &value = s_.nodes[resolve(n.fields[i].type)];
+      if (value.kind == node::Literal && value.text) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void encode_field(std::ostream &o, const field &f,
+                    std::vector<uint8_t> &bytes, const std::string &indent) {
+    if (is_literal(f.type)) {
+      append_literal(bytes, f.type);
+      return;
+    }
+    put(o, bytes, indent);
+    o << indent << "codec<" << cpp_type(f.type) << ">::encode(out, value."
+      << f.name << ");\n";
+  }
+
+  void map_codec(std::ostream &o, const rule &r) {
+    const node &n = s_.nodes[r.type];
+    open_codec(o, r, "const ");
+    if (n.fields.empty()) {
+      o << "    (void)value;\n";
+    }
+    std::vector<uint8_t> bytes;
+    size_t required = 0;
+    std::string optional;
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      if (n.fields[i].optional) {
+        optional += " + value.has_" + n.fields[i].name;
+      } else {
+        ++required;
+      }
+    }
+    if (optional.empty()) {
+      append_head(bytes, major::Map, required);
+    } else {
+      o << "    put_head(out, major::Map, " << required << optional << ");\n";
+    }
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      const field &f = n.fields[i];
+      if (f.optional) {
+        put(o, bytes, "    ");
+        o << "    if (value.has_" << f.name << ") {\n";
+        append_key(bytes, f);
+        encode_field(o, f, bytes, "      ");
+        put(o, bytes, "      ");
+        o << "    }\n";
+        continue;
+      }
+      append_key(bytes, f);
+      encode_field(o, f, bytes, "    ");
+    }
+    put(o, bytes, "    ");
+    bool text = n.fields.empty() || n.fields[0].text_key;
+    o << "  }\n\n"
+         "  static bool decode(reader &r, "
+      << prefix_ << identifier(r.name)
+      << " &value) {\n"
+         "    int major = 0;\n"
+         "    int minor = 0;\n"
+         "    uint64_t count = 0;\n"
+         "    if (!next_head(r, major, minor, count) || major != major::Map) "
+         "{\n"
+         "      return false;\n"
+         "    }\n";
+    if (n.fields.empty()) {
+      o << "    (void)value;\n";
+    }
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      if (n.fields[i].optional) {
+        o << "    value.has_" << n.fields[i].name << " = false;\n";
+      } else {
+        mask |= uint64_t(1) << i;
+      }
+    }
+    o << "    uint64_t seen = 0;\n";
+    if (text || needs_scratch(n)) {
+      o << "    std::string scratch;\n";
+    }
+    o << "    bool ok = for_each_element(r, minor, count, [&]() -> bool {\n"
+         "      int field = -1;\n";
+    if (text) {
+      o << "      if (r.p != r.end && *r.p >> 5 == major::TextString) {\n"
+           "        const char *key = nullptr;\n"
+           "        size_t size = 0;\n"
+           "        if (!read_string(r, major::TextString, key, size, "
+           "scratch)) {\n"
+           "          return false;\n"
+           "        }\n"
+           "        field = index(key, size);\n";
+    } else {
+      o << "      if (r.p != r.end && *r.p >> 5 <= major::Negative) {\n"
+           "        int key_major = 0;\n"
+           "        int key_minor = 0;\n"
+           "        uint64_t key = 0;\n"
+           "        if (!next_head(r, key_major, key_minor, key) ||\n"
+           "            key_minor == 31) {\n"
+           "          return false;\n"
+           "        }\n"
+           "        if (key <= uint64_t(INT64_MAX)) {\n"
+           "          field = index(key_major == major::Unsigned ? "
+           "int64_t(key)\n"
+           "                                                     : "
+           "-1 - int64_t(key));\n"
+           "        }\n";
+    }
+    o << "      } else {\n"
+         "        r.p = skip_item(r.p, r.end);\n"
+         "        if (r.p == nullptr) {\n"
+         "          return false;\n"
+         "        }\n"
+         "      }\n"
+         "      if (field < 0) {\n"
+         "        r.p = skip_item(r.p, r.end);\n"
+         "        return r.p != nullptr;\n"
+         "      }\n"
+         "      if ((seen >> field & 1) != 0) {\n"
+         "        return false;\n"
+         "      }\n"
+         "      seen |= uint64_t(1) << field;\n"
+         "      switch (field) {\n";
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      const field &f = n.fields[i];
+      o << "      case " << i << ": {\n";
+      if (f.optional) {
+        o << "        value.has_" << f.name << " = true;\n";
+      }
+      decode_field(o, f, "        ");
+      o << "      }\n";
+    }
+    char required_mask[32];
+    snprintf(required_mask, sizeof(required_mask), "0x%llxu",
+             (unsigned long long)mask);
+    o << "      }\n"
+         "      return false;\n"
+         "    });\n"
+         "    return ok && (seen & "
+      << required_mask << ") == " << required_mask << ";\n  }\n\n";
+    if (text) {
+      std::vector<std::string> keys;
+      for (size_t i = 0; i < n.fields.size(); ++i) {
+        keys.push_back(n.fields[i].key);
+      }
+      text_index(o, keys);
+    } else {
+      std::vector<int64_t> keys;
+      for (size_t i = 0; i < n.fields.size(); ++i) {
+        keys.push_back(n.fields[i].int_key);
+      }
+      int_index(o, keys);
+    }
+    o << "};\n";
+  }
+
+  void array_codec(std::ostream &o, const rule &r) {
+    const node &n = s_.nodes[r.type];
+    open_codec(o, r, "const ");
+    std::vector<uint8_t> bytes;
+    append_head(bytes, major::Array, n.fields.size());
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      encode_field(o, n.fields[i], bytes, "    ");
+    }
+    put(o, bytes, "    ");
+    o << "  }\n\n"
+         "  static bool decode(reader &r, "
+      << prefix_ << identifier(r.name)
+      << " &value) {\n"
+         "    int major = 0;\n"
+         "    int minor = 0;\n"
+         "    uint64_t count = 0;\n"
+         "    if (!next_head(r, major, minor, count) || major != "
+         "major::Array ||\n"
+         "        (minor != 31 && count != "
+      << n.fields.size()
+      << ")) {\n"
+         "      return false;\n"
+         "    }\n";
+    if (needs_scratch(n)) {
+      o << "    std::string scratch;\n";
+    }
+    o << "    size_t i = 0;\n"
+         "    bool ok = for_each_element(r, minor, count, [&]() -> bool {\n"
+         "      switch (i++) {\n";
+    for (size_t i = 0; i < n.fields.size(); ++i) {
+      o << "      case " << i << ": {\n";
+      decode_field(o, n.fields[i], "        ");
+      o << "      }\n";
+    }
+    o << "      }\n"
+         "      return false;\n"
+         "    });\n"
+         "    return ok && i == "
+      << n.fields.size() << ";\n  }\n};\n";
+  }
+
+  void enum_codec(std::ostream &o, const rule &r) {
+    const node &n = s_.nodes[r.type];
+    std::string type = prefix_ + identifier(r.name);
+    if (r.kind == IntEnum) {
+      open_codec(o, r, "");
+      o << "    codec<int64_t>::encode(out, int64_t(value));\n"
+           "  }\n\n"
+           "  static bool decode(reader &r, "
+        << type
+        << " &value) {\n"
+           "    int64_t number = 0;\n"
+           "    if (!codec<int64_t>::decode(r, number) || index(number) < 0) "
+           "{\n"
+           "      return false;\n"
+           "    }\n"
+           "    value = "
+        << type << "(number);\n    return true;\n  }\n\n";
+      std::vector<int64_t> keys;
+      for (size_t i = 0; i < n.alternatives.size(); ++i) {
+        keys.push_back(s_.nodes[n.alternatives[i]].number);
+      }
+      int_index(o, keys);
+      o << "};\n";
+      return;
+    }
+    // the encodings of all enumerators back to back;
+    std::vector<uint8_t> bytes;
+    std::vector<std::string> keys;
+    std::ostringstream offsets;
+    offsets << "0";
+    for (size_t i = 0; i < n.alternatives.size(); ++i) {
+      keys.push_back(s_.nodes[n.alternatives[i]].value);
+      append_text(bytes, keys.back());
+      offsets << ", " << bytes.size();
+    }
+    open_codec(o, r, "");
+    std::string name = table(o, bytes, "    ");
+    o << "    static const size_t offsets[] = {" << offsets.str() << "};\n"
+      << "    size_t i = size_t(value);\n"
+      << "    out.insert(out.end(), " << name << " + offsets[i], " << name
+      << " + offsets[i + 1]);\n"
+         "  }\n\n"
+         "  static bool decode(reader &r, "
+      << type
+      << " &value) {\n"
+         "    const char *key = nullptr;\n"
+         "    size_t size = 0;\n"
+         "    std::string scratch;\n"
+         "    if (!read_string(r, major::TextString, key, size, scratch)) {\n"
+         "      return false;\n"
+         "    }\n"
+         "    int i = index(key, size);\n"
+         "    if (i < 0) {\n"
+         "      return false;\n"
+         "    }\n"
+         "    value = "
+      << type << "(i);\n    return true;\n  }\n\n";
+    text_index(o, keys);
+    o << "};\n";
+  }
+};
+
+bool read_file(const char *path, std::string &content) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::ostringstream buffer;
+  buffer << in.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3 || argc > 4) {
+    fprintf(stderr, "usage: %s schema.cddl output.hpp [namespace]\n",
+            argv[0]);
+    return 2;
+  }
+  std::string source;
+  if (!read_file(argv[1], source)) {
+    fprintf(stderr, "%s: cannot read\n", argv[1]);
+    return 1;
+  }
+  const char *base = strrchr(argv[1], '/');
+  base = base == nullptr ? argv[1] : base + 1;
+  std::vector<token> tokens;
+  schema s;
+  diagnostic d = {0, std::string()};
+  std::string output;
+  if (!lex(source, tokens, d) || !parser(tokens, s, d).parse() ||
+      !check(s, d) ||
+      !generator(s, argc == 4 ? argv[3] : "", d).generate(base, output)) {
+    fprintf(stderr, "%s:%d: error: %s\n", argv[1], d.line, d.message.c_str());
+    return 1;
+  }
+  std::ofstream out(argv[2], std::ios::out | std::ios::binary);
+  out << output;
+  if (!out.flush()) {
+    fprintf(stderr, "%s: cannot write\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}